@@ -0,0 +1,255 @@
+/**
+ * kalu - Copyright (C) 2012-2018 Olivier Brunel
+ *
+ * news-read.c
+ * Copyright (C) 2018 Olivier Brunel <jjk@jjacky.com>
+ *
+ * This file is part of kalu.
+ *
+ * kalu is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * kalu is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * kalu. If not, see http://www.gnu.org/licenses/
+ */
+
+/* Benchmark for the set of read news (config->news_read), using conf.c: a
+ * news.conf with NB historical Read= entries is loaded via parse_config_file(),
+ * the feed checked against config->news_read (as news_has_updates/add_item
+ * do), then marked read via save_news_conf() (as btn_mark_cb does, pruning all
+ * entries no longer in the feed), an item marked read again (appended to the
+ * journal) and the file loaded once more.
+ * Everything happens in a temporary XDG_CONFIG_HOME.
+ * Usage: news-read-bench [NB...] */
+
+#include <config.h>
+
+/* C */
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+/* glib */
+#include <glib.h>
+
+/* kalu */
+#include "../kalu/kalu.h"
+#include "../kalu/conf.h"
+#include "../kalu/util.h"
+
+#define FEED_ITEMS      10
+#define CHECK_ROUNDS    1000
+
+/* from main.c, which isn't linked in */
+config_t *config = NULL;
+
+void
+free_watched_package (watched_package_t *w_pkg)
+{
+    free (w_pkg->name);
+    free (w_pkg->version);
+    free (w_pkg);
+}
+
+void
+debug (const char *fmt _UNUSED_, ...)
+{
+}
+
+static gchar *
+get_title (guint n)
+{
+    return g_strdup_printf ("News item #%u: %s", n,
+            "some update requires manual intervention");
+}
+
+/* the feed holds the last FEED_ITEMS news, the oldest half of them already
+ * read, after nb ones that went away */
+static gchar *
+make_conf (guint nb)
+{
+    GString *str;
+    gchar *title;
+    guint i;
+
+    str = g_string_sized_new (nb * 64);
+    title = get_title (0);
+    g_string_append_printf (str, "Last=%s\n", title);
+    g_free (title);
+    for (i = nb + FEED_ITEMS - 1; i >= FEED_ITEMS / 2; --i)
+    {
+        title = get_title (i);
+        g_string_append_printf (str, "Read=%s\n", title);
+        g_free (title);
+    }
+    return g_string_free (str, FALSE);
+}
+
+static gboolean
+load (const gchar *file)
+{
+    GError *error = NULL;
+
+    g_hash_table_remove_all (config->news_read);
+    free (config->news_last);
+    config->news_last = NULL;
+    if (!parse_config_file (file, CONF_FILE_NEWS, &error))
+    {
+        fprintf (stderr, "failed to parse %s: %s\n", file, error->message);
+        g_clear_error (&error);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* saves news_read, then makes it the current set, as btn_mark_cb does */
+static gboolean
+save (GHashTable *news_read)
+{
+    GError *error = NULL;
+
+    if (!save_news_conf (config->news_last, news_read, &error))
+    {
+        fprintf (stderr, "failed to save news.conf: %s\n", error->message);
+        g_clear_error (&error);
+        g_hash_table_destroy (news_read);
+        return FALSE;
+    }
+    g_hash_table_destroy (config->news_read);
+    config->news_read = news_read;
+    return TRUE;
+}
+
+static gboolean
+run (const gchar *file, guint nb)
+{
+    GHashTable  *news_read;
+    gchar      **feed;
+    gchar       *conf;
+    gint64       t_load, t_check, t_prune, t_append, t_reload, start;
+    guint        r, f, found = 0;
+
+    conf = make_conf (nb);
+    if (!g_file_set_contents (file, conf, -1, NULL))
+    {
+        fprintf (stderr, "failed to write %s\n", file);
+        g_free (conf);
+        return FALSE;
+    }
+    g_free (conf);
+
+    feed = g_new0 (gchar *, FEED_ITEMS + 1);
+    for (f = 0; f < FEED_ITEMS; ++f)
+        feed[f] = get_title (f);
+
+    start = g_get_monotonic_time ();
+    if (!load (file))
+        goto err;
+    t_load = g_get_monotonic_time () - start;
+
+    start = g_get_monotonic_time ();
+    for (r = 0; r < CHECK_ROUNDS; ++r)
+        for (f = 0; f < FEED_ITEMS; ++f)
+            if (g_hash_table_contains (config->news_read, feed[f]))
+                ++found;
+    t_check = g_get_monotonic_time () - start;
+
+    /* only news still in the feed are kept; all others get pruned */
+    start = g_get_monotonic_time ();
+    news_read = g_hash_table_new_full (g_str_hash, g_str_equal, free, NULL);
+    for (f = 0; f < FEED_ITEMS; ++f)
+        if (g_hash_table_contains (config->news_read, feed[f]))
+            g_hash_table_add (news_read, strdup (feed[f]));
+    if (!save (news_read))
+        goto err;
+    t_prune = g_get_monotonic_time () - start;
+
+    /* one more news read: a single Read= record goes to the journal */
+    start = g_get_monotonic_time ();
+    news_read = g_hash_table_new_full (g_str_hash, g_str_equal, free, NULL);
+    for (f = 0; f < FEED_ITEMS; ++f)
+        if (f == FEED_ITEMS / 2 - 1
+                || g_hash_table_contains (config->news_read, feed[f]))
+            g_hash_table_add (news_read, strdup (feed[f]));
+    if (!save (news_read))
+        goto err;
+    t_append = g_get_monotonic_time () - start;
+
+    start = g_get_monotonic_time ();
+    if (!load (file))
+        goto err;
+    t_reload = g_get_monotonic_time () - start;
+
+    if (found != CHECK_ROUNDS * (FEED_ITEMS - FEED_ITEMS / 2)
+            || g_hash_table_size (config->news_read)
+                != FEED_ITEMS - FEED_ITEMS / 2 + 1)
+    {
+        fprintf (stderr, "mismatch: found %u, %u read after reload\n",
+                found, g_hash_table_size (config->news_read));
+        goto err;
+    }
+
+    printf ("%8u %10" G_GINT64_FORMAT " %12.3f %11" G_GINT64_FORMAT
+            " %11" G_GINT64_FORMAT " %11" G_GINT64_FORMAT "\n",
+            nb, t_load, (double) t_check / (CHECK_ROUNDS * FEED_ITEMS),
+            t_prune, t_append, t_reload);
+    g_strfreev (feed);
+    return TRUE;
+
+err:
+    g_strfreev (feed);
+    return FALSE;
+}
+
+int
+main (int argc, char *argv[])
+{
+    static const guint def[] = { 100, 1000, 10000, 50000 };
+    gchar *dir, *file;
+    gboolean ok = TRUE;
+    int i;
+
+    dir = g_dir_make_tmp ("kalu-bench-XXXXXX", NULL);
+    if (!dir)
+    {
+        fprintf (stderr, "failed to create temporary folder\n");
+        return 1;
+    }
+    /* so save_news_conf() writes in there */
+    g_setenv ("XDG_CONFIG_HOME", dir, TRUE);
+    file = g_strdup_printf ("%s/kalu/news.conf", dir);
+    if (!ensure_path (file))
+    {
+        fprintf (stderr, "failed to create folder for %s\n", file);
+        rmrf (dir);
+        return 1;
+    }
+
+    config = new0 (config_t, 1);
+    config->news_read = g_hash_table_new_full (g_str_hash, g_str_equal,
+            free, NULL);
+
+    printf ("%8s %10s %12s %11s %11s %11s\n", "entries", "load (us)",
+            "lookup (us)", "prune (us)", "append (us)", "reload (us)");
+    if (argc > 1)
+        for (i = 1; ok && i < argc; ++i)
+            ok = run (file, (guint) strtoul (argv[i], NULL, 10));
+    else
+        for (i = 0; ok && i < (int) G_N_ELEMENTS (def); ++i)
+            ok = run (file, def[i]);
+
+    g_hash_table_destroy (config->news_read);
+    free (config->news_last);
+    free (config);
+    rmrf (dir);
+    g_free (file);
+    g_free (dir);
+    return (ok) ? 0 : 1;
+}
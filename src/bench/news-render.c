@@ -0,0 +1,134 @@
+/**
+ * kalu - Copyright (C) 2012-2018 Olivier Brunel
+ *
+ * news-render.c
+ * Copyright (C) 2018 Olivier Brunel <jjk@jjacky.com>
+ *
+ * This file is part of kalu.
+ *
+ * kalu is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * kalu is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * kalu. If not, see http://www.gnu.org/licenses/
+ */
+
+/* Benchmark for news_render_html(): renders a synthetic feed of NB items (as
+ * the news window does), then single items of growing size, to show the cost
+ * per KB stays flat.
+ * Usage: news-render-bench [NB] */
+
+#include <config.h>
+
+/* C */
+#include <stdlib.h>
+#include <stdio.h>
+
+/* gtk */
+#include <gtk/gtk.h>
+
+/* kalu */
+#include "../kalu/news-render.h"
+
+#define ROUNDS          5
+
+/* one paragraph of the kind of markup found in the feed */
+static void
+add_paragraph (GString *str, guint n)
+{
+    g_string_append_printf (str,
+            "<p>Paragraph %u: the <strong>foo</strong> package &amp; its "
+            "dependencies moved to <a href=\"https://example.org/news/%u?a=1"
+            "&amp;b=2\">the <i>new</i> layout</a>, see &quot;pacman -Syu&quot;"
+            "<br />before you &lt;update&gt;:</p>\n"
+            "<pre><code>pacman -Syu --overwrite '/usr/lib/foo/*'\n"
+            "pacman -S bar\n</code></pre>\n"
+            "<ul>\n<li>first &rsquo;item&rsquo;</li>\n<li>second</li>\n</ul>\n",
+            n, n);
+}
+
+static gchar *
+make_item (gsize size)
+{
+    GString *str = g_string_sized_new (size + 512);
+    guint n = 0;
+
+    while (str->len < size)
+        add_paragraph (str, n++);
+    return g_string_free (str, FALSE);
+}
+
+/* returns the time (usec) to render text into a new buffer, best of ROUNDS */
+static gint64
+render (gchar **texts)
+{
+    gint64 best = G_MAXINT64;
+    guint r;
+
+    for (r = 0; r < ROUNDS; ++r)
+    {
+        GtkTextBuffer *buffer;
+        gint64 start, elapsed;
+        gchar **t;
+
+        buffer = gtk_text_buffer_new (NULL);
+        start = g_get_monotonic_time ();
+        news_render_create_tags (buffer);
+        for (t = texts; *t; ++t)
+            news_render_html (buffer, *t, strlen (*t));
+        elapsed = g_get_monotonic_time () - start;
+        g_object_unref (buffer);
+
+        if (elapsed < best)
+            best = elapsed;
+    }
+    return best;
+}
+
+int
+main (int argc, char *argv[])
+{
+    static const gsize sizes[] = { 16, 64, 256, 1024 };
+    gchar **texts;
+    gsize total = 0;
+    gint64 elapsed;
+    guint nb = 50;
+    guint i;
+
+    if (argc > 1)
+        nb = (guint) strtoul (argv[1], NULL, 10);
+
+    /* feed: items of 2 to ~20KB */
+    texts = g_new0 (gchar *, nb + 1);
+    for (i = 0; i < nb; ++i)
+    {
+        texts[i] = make_item (2048 + (gsize) (i % 10) * 2048);
+        total += strlen (texts[i]);
+    }
+    elapsed = render (texts);
+    printf ("feed: %u items, %" G_GSIZE_FORMAT " KB: %" G_GINT64_FORMAT
+            " usec (%.2f usec/KB)\n",
+            nb, total / 1024, elapsed, (double) elapsed / (double) (total / 1024));
+    g_strfreev (texts);
+
+    texts = g_new0 (gchar *, 2);
+    for (i = 0; i < G_N_ELEMENTS (sizes); ++i)
+    {
+        texts[0] = make_item (sizes[i] * 1024);
+        elapsed = render (texts);
+        printf ("item: %5" G_GSIZE_FORMAT " KB: %8" G_GINT64_FORMAT
+                " usec (%.2f usec/KB)\n",
+                sizes[i], elapsed, (double) elapsed / (double) sizes[i]);
+        g_free (texts[0]);
+    }
+    g_free (texts);
+
+    return 0;
+}
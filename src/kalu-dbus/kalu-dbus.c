@@ -20,6 +20,9 @@
  * kalu. If not, see http://www.gnu.org/licenses/
  */
 
+/* memfd_create, F_ADD_SEALS */
+#define _GNU_SOURCE
+
 #include <config.h>
 
 /* C */
@@ -28,6 +31,10 @@
 #include <stdio.h>
 #include <time.h>
 #include <sys/types.h> /* off_t */
+#include <sys/mman.h>  /* memfd_create */
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <errno.h>
 #include <signal.h>
 #include <unistd.h>
 #include <pthread.h>
@@ -37,6 +44,7 @@
 
 /* gio - for dbus */
 #include <gio/gio.h>
+#include <gio/gunixfdlist.h>
 
 /* alpm */
 #include <alpm.h>
@@ -44,6 +52,7 @@
 
 /* kalu */
 #include "../kalu/shared.h"
+#include "../kalu/cache-index.h"
 #include "updater-dbus.h"
 
 #define CHOICE_FREE             -1
@@ -83,18 +92,25 @@ static alpm_handle_t *handle  = NULL;
 
 static gchar buffer[1024];
 
+/* sealed memfd holding the packages table, until the client takes it (see
+ * TakePackagesTable) */
+static gint pkg_table_fd = -1;
+static void drop_packages_table (void);
+
+/* own buffer, since this can be used from the worker thread */
 #define debug(...)     do {                                             \
-    snprintf (buffer, 1024, __VA_ARGS__);                               \
+    gchar _buf[1024];                                                   \
+    snprintf (_buf, 1024, __VA_ARGS__);                                 \
     g_dbus_connection_emit_signal (connection,                          \
                                    client,                              \
                                    OBJECT_PATH,                         \
                                    INTERFACE_NAME,                      \
                                    "Debug",                             \
-                                   g_variant_new ("(s)", buffer),       \
+                                   g_variant_new ("(s)", _buf),         \
                                    NULL);                               \
     } while (0)
 
-#define emit_signal(name, fmt, ...)                                            \
+#define _emit_signal(name, fmt, ...)                                           \
     g_dbus_connection_emit_signal (connection,                                 \
                                    client,                                     \
                                    OBJECT_PATH,                                \
@@ -103,6 +119,13 @@ static gchar buffer[1024];
                                    g_variant_new ("(" fmt ")", __VA_ARGS__),   \
                                    NULL);
 
+/* any other signal first sends coalesced progress (see below), so the client
+ * gets things in order */
+#define emit_signal(name, fmt, ...)     do {                                   \
+    flush_progress ();                                                         \
+    _emit_signal (name, fmt, __VA_ARGS__);                                     \
+    } while (0)
+
 #define emit_signal_no_params(name)                                            \
     g_dbus_connection_emit_signal (connection,                                 \
                                    client,                                     \
@@ -179,11 +202,216 @@ static char
     return newstr;
 }
 
+/************
+ * PROGRESS *
+ ************/
+
+/* Downloading & Progress signals are coalesced per file/package, and emitted
+ * no more than the rate requested on Init. The first & last values (start/end
+ * of a file/package) are always sent, and whatever is pending gets sent before
+ * any other signal. Callbacks can come from the sysupgrade thread, hence the
+ * lock. */
+
+/* last values for a file (Downloading) or an event on a package (Progress) */
+typedef struct _throttled_t {
+    gboolean  is_dl;
+    gchar    *name;     /* filename/pkgname */
+    event_t   event;
+    guint     xfered;
+    guint     total;
+    int       percent;
+    guint     howmany;
+    guint     current;
+    gboolean  is_pending;
+    gint64    last;
+} throttled_t;
+
+static struct
+{
+    gint64      min_interval; /* 0: no limit */
+    guint       nb_emitted;
+    guint       nb_suppressed;
+    GMutex      mutex;
+    GHashTable *entries; /* key from get_throttle_key() */
+} throttle;
+
+static void
+free_throttled (throttled_t *t)
+{
+    free (t->name);
+    free (t);
+}
+
+static gchar *
+get_throttle_key (gboolean is_dl, event_t event, const char *name)
+{
+    return (is_dl) ? g_strconcat ("dl:", name, NULL)
+        : g_strdup_printf ("%d:%s", (int) event, name);
+}
+
+/* must be called w/ the lock held; returns the entry for the file/package,
+ * setting is_new if there was none */
+static throttled_t *
+get_throttled (gboolean is_dl, event_t event, const char *name,
+               gboolean *is_new)
+{
+    throttled_t *t;
+    gchar *key;
+
+    if (!throttle.entries)
+        throttle.entries = g_hash_table_new_full (g_str_hash, g_str_equal,
+                g_free, (GDestroyNotify) free_throttled);
+
+    key = get_throttle_key (is_dl, event, name);
+    t = g_hash_table_lookup (throttle.entries, key);
+    *is_new = t == NULL;
+    if (t)
+    {
+        g_free (key);
+        if (t->is_pending)
+            ++throttle.nb_suppressed;
+        return t;
+    }
+
+    t = new0 (throttled_t, 1);
+    t->is_dl = is_dl;
+    t->event = event;
+    t->name = strdup (name);
+    g_hash_table_insert (throttle.entries, key, t);
+    return t;
+}
+
+static void
+emit_throttled (throttled_t *t, gint64 now)
+{
+    if (t->is_dl)
+        _emit_signal ("Downloading", "suu", t->name, t->xfered, t->total);
+    else
+        _emit_signal ("Progress", "isiuu", t->event, t->name, t->percent,
+                t->howmany, t->current);
+    t->is_pending = FALSE;
+    t->last = now;
+    ++throttle.nb_emitted;
+}
+
+/* must be called w/ the lock held. Emits t if due (is_edge: first/last value),
+ * and drops it once done */
+static void
+update_throttled (throttled_t *t, gboolean is_new, gboolean is_edge,
+                  gboolean is_done)
+{
+    gint64 now = g_get_monotonic_time ();
+    gchar *key;
+
+    if (!is_new && !is_edge && now - t->last < throttle.min_interval)
+    {
+        t->is_pending = TRUE;
+        return;
+    }
+
+    emit_throttled (t, now);
+    if (is_done)
+    {
+        key = get_throttle_key (t->is_dl, t->event, t->name);
+        g_hash_table_remove (throttle.entries, key);
+        g_free (key);
+    }
+}
+
+/* must be called w/ the lock held */
+static void
+flush_pending (void)
+{
+    GHashTableIter iter;
+    throttled_t *t;
+    gint64 now;
+
+    if (!throttle.entries)
+        return;
+
+    now = g_get_monotonic_time ();
+    g_hash_table_iter_init (&iter, throttle.entries);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &t))
+        if (t->is_pending)
+            emit_throttled (t, now);
+}
+
+static void
+flush_progress (void)
+{
+    if (throttle.min_interval == 0)
+        return;
+
+    g_mutex_lock (&throttle.mutex);
+    flush_pending ();
+    g_mutex_unlock (&throttle.mutex);
+}
+
+/* forgets about all files/packages, e.g. for ones whose end never came */
+static void
+reset_throttle (void)
+{
+    g_mutex_lock (&throttle.mutex);
+    if (throttle.entries)
+        g_hash_table_remove_all (throttle.entries);
+    g_mutex_unlock (&throttle.mutex);
+}
+
+static void
+throttle_download (const char *filename, guint xfered, guint total)
+{
+    throttled_t *t;
+    gboolean is_new;
+
+    if (throttle.min_interval == 0)
+    {
+        _emit_signal ("Downloading", "suu", filename, xfered, total);
+        ++throttle.nb_emitted;
+        return;
+    }
+
+    g_mutex_lock (&throttle.mutex);
+    t = get_throttled (TRUE, 0, filename, &is_new);
+    t->xfered = xfered;
+    t->total  = total;
+    update_throttled (t, is_new, xfered == 0 || xfered == total,
+            total > 0 && xfered == total);
+    g_mutex_unlock (&throttle.mutex);
+}
+
+static void
+throttle_progress (event_t event, const char *pkgname, int percent,
+                   guint howmany, guint current)
+{
+    throttled_t *t;
+    gboolean is_new;
+
+    if (throttle.min_interval == 0)
+    {
+        _emit_signal ("Progress", "isiuu", event, pkgname, percent, howmany, current);
+        ++throttle.nb_emitted;
+        return;
+    }
+
+    g_mutex_lock (&throttle.mutex);
+    t = get_throttled (FALSE, event, pkgname, &is_new);
+    t->percent = percent;
+    t->howmany = howmany;
+    t->current = current;
+    update_throttled (t, is_new, percent == 0 || percent == 100,
+            percent == 100);
+    g_mutex_unlock (&throttle.mutex);
+}
+
 /******************
  * ALPM CALLBACKS *
  ******************/
 
+/* questions are asked from the worker thread, which then waits for method
+ * Answer to be processed by the main loop */
 static int choice = CHOICE_FREE;
+static GMutex choice_mutex;
+static GCond choice_cond;
 
 /* the following 2 functions were largelly inspired from pacman's */
 
@@ -219,8 +447,10 @@ depend_cmp (const alpm_depend_t *dep1, const alpm_depend_t *dep2)
     return ret;
 }
 
+/* pending is the set of names of packages in the transaction, or NULL to look
+ * them up from it */
 static gchar *
-make_optstring (alpm_depend_t *optdep)
+make_optstring (alpm_depend_t *optdep, GHashTable *pending)
 {
     char *optstring;
     char *status;
@@ -228,7 +458,8 @@ make_optstring (alpm_depend_t *optdep)
     optstring = alpm_dep_compute_string (optdep);
     if (alpm_db_get_pkg (alpm_get_localdb (handle), optdep->name))
         status = _(" [installed]");
-    else if (alpm_pkg_find (alpm_trans_get_add (handle), optdep->name))
+    else if ((pending) ? g_hash_table_contains (pending, optdep->name)
+            : alpm_pkg_find (alpm_trans_get_add (handle), optdep->name) != NULL)
         status = _(" [pending]");
     else
         status = NULL;
@@ -244,6 +475,99 @@ make_optstring (alpm_depend_t *optdep)
     return optstring;
 }
 
+/* returns (floating) the optional dependencies of newpkg that oldpkg didn't
+ * have, or all of them if oldpkg is NULL */
+static GVariant *
+compute_optdeps (alpm_pkg_t *oldpkg, alpm_pkg_t *newpkg, GHashTable *pending)
+{
+    GVariantBuilder builder;
+    alpm_list_t *i, *optdeps;
+
+    if (oldpkg)
+        optdeps = alpm_list_diff (alpm_pkg_get_optdepends (newpkg),
+                alpm_pkg_get_optdepends (oldpkg),
+                (alpm_list_fn_cmp) depend_cmp);
+    else
+        optdeps = alpm_pkg_get_optdepends (newpkg);
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("as"));
+    FOR_LIST (i, optdeps)
+    {
+        gchar *optstring = make_optstring (i->data, pending);
+
+        g_variant_builder_add (&builder, "s", optstring);
+        free (optstring);
+    }
+
+    if (oldpkg)
+        alpm_list_free (optdeps);
+    return g_variant_builder_end (&builder);
+}
+
+/* files in cachedirs, to get download sizes without stat-ing them all; kept
+ * (and current) while resident */
+static cache_index_t *cache_index = NULL;
+
+/* new optional dependencies of the packages in the transaction (name -> as),
+ * computed once the transaction is prepared so the commit doesn't have to */
+static GHashTable *optdeps_cache = NULL;
+
+static void
+drop_optdeps (void)
+{
+    if (optdeps_cache)
+    {
+        g_hash_table_unref (optdeps_cache);
+        optdeps_cache = NULL;
+    }
+}
+
+static void
+precompute_optdeps (void)
+{
+    alpm_db_t *localdb = alpm_get_localdb (handle);
+    alpm_list_t *pkgs = alpm_trans_get_add (handle);
+    GHashTable *pending;
+    alpm_list_t *i;
+
+    drop_optdeps ();
+    optdeps_cache = g_hash_table_new_full (g_str_hash, g_str_equal,
+            (GDestroyNotify) free, (GDestroyNotify) g_variant_unref);
+
+    /* names are owned by alpm, valid for as long as the transaction */
+    pending = g_hash_table_new (g_str_hash, g_str_equal);
+    FOR_LIST (i, pkgs)
+    {
+        g_hash_table_add (pending, (gpointer) alpm_pkg_get_name (i->data));
+    }
+
+    FOR_LIST (i, pkgs)
+    {
+        alpm_pkg_t *pkg = i->data;
+        const char *name = alpm_pkg_get_name (pkg);
+
+        g_hash_table_insert (optdeps_cache, strdup (name),
+                g_variant_ref_sink (compute_optdeps (
+                        alpm_db_get_pkg (localdb, name), pkg, pending)));
+    }
+
+    g_hash_table_unref (pending);
+}
+
+/* returns (a ref to) the new optional dependencies of newpkg, from the cache
+ * if possible */
+static GVariant *
+get_optdeps (alpm_pkg_t *oldpkg, alpm_pkg_t *newpkg)
+{
+    GVariant *optdeps = NULL;
+
+    if (optdeps_cache)
+        optdeps = g_hash_table_lookup (optdeps_cache, alpm_pkg_get_name (newpkg));
+    if (optdeps)
+        return g_variant_ref (optdeps);
+    return g_variant_ref_sink (compute_optdeps (oldpkg, newpkg, NULL));
+}
+
 /* callback to handle messages/notifications from libalpm transactions */
 static void
 event_cb (alpm_event_t *event)
@@ -255,46 +579,28 @@ event_cb (alpm_event_t *event)
         {
             case ALPM_PACKAGE_UPGRADE:
                 {
-                    /* computing new optional dependencies */
-                    GVariantBuilder *builder;
-                    alpm_list_t *old = alpm_pkg_get_optdepends (e->oldpkg);
-                    alpm_list_t *new = alpm_pkg_get_optdepends (e->newpkg);
-                    alpm_list_t *i, *optdeps;
-                    optdeps = alpm_list_diff (new, old, (alpm_list_fn_cmp) depend_cmp);
-
-                    builder = g_variant_builder_new (G_VARIANT_TYPE ("as"));
-                    FOR_LIST (i, optdeps)
-                    {
-                        g_variant_builder_add (builder, "s", make_optstring (i->data));
-                    }
-
-                    emit_signal ("EventUpgraded", "sssas",
+                    /* new optional dependencies */
+                    GVariant *optdeps = get_optdeps (e->oldpkg, e->newpkg);
+
+                    emit_signal ("EventUpgraded", "sss@as",
                             alpm_pkg_get_name (e->newpkg),
                             alpm_pkg_get_version (e->oldpkg),
                             alpm_pkg_get_version (e->newpkg),
-                            builder);
-                    g_variant_builder_unref (builder);
-                    alpm_list_free (optdeps);
+                            optdeps);
+                    g_variant_unref (optdeps);
                 }
                 break;
 
             case ALPM_PACKAGE_INSTALL:
                 {
-                    /* computing optional dependencies */
-                    GVariantBuilder *builder;
-                    alpm_list_t *i, *optdeps = alpm_pkg_get_optdepends (e->newpkg);
+                    /* optional dependencies */
+                    GVariant *optdeps = get_optdeps (NULL, e->newpkg);
 
-                    builder = g_variant_builder_new (G_VARIANT_TYPE ("as"));
-                    FOR_LIST (i, optdeps)
-                    {
-                        g_variant_builder_add (builder, "s", make_optstring (i->data));
-                    }
-
-                    emit_signal ("EventInstalled", "ssas",
+                    emit_signal ("EventInstalled", "ss@as",
                             alpm_pkg_get_name (e->newpkg),
                             alpm_pkg_get_version (e->newpkg),
-                            builder);
-                    g_variant_builder_unref (builder);
+                            optdeps);
+                    g_variant_unref (optdeps);
                 }
                 break;
 
@@ -312,26 +618,15 @@ event_cb (alpm_event_t *event)
 
             case ALPM_PACKAGE_DOWNGRADE:
                 {
-                    /* computing new optional dependencies */
-                    GVariantBuilder *builder;
-                    alpm_list_t *old = alpm_pkg_get_optdepends (e->oldpkg);
-                    alpm_list_t *new = alpm_pkg_get_optdepends (e->newpkg);
-                    alpm_list_t *i, *optdeps;
-                    optdeps = alpm_list_diff (new, old, (alpm_list_fn_cmp) depend_cmp);
-
-                    builder = g_variant_builder_new (G_VARIANT_TYPE ("as"));
-                    FOR_LIST (i, optdeps)
-                    {
-                        g_variant_builder_add (builder, "s", make_optstring (i->data));
-                    }
-
-                    emit_signal ("EventDowngraded", "sssas",
+                    /* new optional dependencies */
+                    GVariant *optdeps = get_optdeps (e->oldpkg, e->newpkg);
+
+                    emit_signal ("EventDowngraded", "sss@as",
                             alpm_pkg_get_name (e->newpkg),
                             alpm_pkg_get_version (e->oldpkg),
                             alpm_pkg_get_version (e->newpkg),
-                            builder);
-                    g_variant_builder_unref (builder);
-                    alpm_list_free (optdeps);
+                            optdeps);
+                    g_variant_unref (optdeps);
                 }
                 break;
         }
@@ -508,7 +803,7 @@ progress_cb (alpm_progress_t _event, const char *_pkgname, int percent,
             return;
     }
     const gchar *pkgname = (_pkgname) ? _pkgname : "";
-    emit_signal ("Progress", "isiuu", event, pkgname, percent, howmany, current);
+    throttle_progress (event, pkgname, percent, howmany, current);
 }
 
 /* callback to handle receipt of total download value */
@@ -534,7 +829,7 @@ dl_progress_cb (const char *filename, off_t _xfered, off_t _total)
         else if (_total < 0)
             _total = 0;
     }
-    emit_signal ("Downloading", "suu", filename, xfered, total);
+    throttle_download (filename, xfered, total);
 }
 
 /* callback to handle notifications from the library */
@@ -565,12 +860,15 @@ question_cb (alpm_question_t *question)
 
     debug ("question %d\n", question->type);
 
+    g_mutex_lock (&choice_mutex);
     if (choice != CHOICE_FREE)
     {
+        g_mutex_unlock (&choice_mutex);
         debug ("Received question (%d) while already busy", question->type);
         return;
     }
     choice = CHOICE_WAITING;
+    g_mutex_unlock (&choice_mutex);
 
     switch (question->type)
     {
@@ -684,17 +982,21 @@ question_cb (alpm_question_t *question)
             }
 
         default:
+            g_mutex_lock (&choice_mutex);
             choice = CHOICE_FREE;
+            g_mutex_unlock (&choice_mutex);
             debug ("Received unknown question: %d", question->type);
             return;
     }
     /* wait for a choice -- happens when method Answer is called */
+    g_mutex_lock (&choice_mutex);
     while (choice == CHOICE_WAITING)
     {
-        g_main_context_iteration (NULL, TRUE);
+        g_cond_wait (&choice_cond, &choice_mutex);
     }
     question->any.answer = choice;
     choice = CHOICE_FREE;
+    g_mutex_unlock (&choice_mutex);
 }
 
 /***********
@@ -705,7 +1007,8 @@ static void
 method_failed (const gchar *name, const gchar *fmt, ...)
 {
     va_list args;
-    gchar *b = buffer;
+    gchar buf[1024];
+    gchar *b = buf;
     int len;
 
     va_start (args, fmt);
@@ -720,7 +1023,7 @@ method_failed (const gchar *name, const gchar *fmt, ...)
         va_end (args);
     }
     emit_signal ("MethodFailed", "ss", name, b);
-    if (b != buffer)
+    if (b != buf)
     {
         free (b);
     }
@@ -728,19 +1031,231 @@ method_failed (const gchar *name, const gchar *fmt, ...)
 
 #define method_finished(name)   emit_signal ("MethodFinished", "s", name)
 
+/* anything that can take a while (syncing dbs, preparing or committing the
+ * transaction) is done in a worker thread, so the main loop is always free to
+ * process methods Abort & Answer. There's only ever one worker at a time; Abort
+ * raises SIGINT in it.
+ * pt is set from the main loop (by start_worker) before any method can be
+ * processed, and only cleared by worker_done, under worker_lock, which do_abort
+ * also holds while signaling. So Abort can neither miss a worker that hasn't
+ * started yet, nor signal one that's already gone. */
+static GMutex worker_lock;
+static pthread_t pt = 0;
+static gint worker_running = 0;
+static volatile sig_atomic_t interrupted = 0;
+
+static gboolean
+start_worker (const gchar *method, GThreadFunc func, gpointer data)
+{
+    gint r;
+
+    if (!g_atomic_int_compare_and_exchange (&worker_running, 0, 1))
+    {
+        method_failed (method, _("Invalid state"));
+        return FALSE;
+    }
+    interrupted = 0;
+    g_mutex_lock (&worker_lock);
+    r = pthread_create (&pt, NULL, func, data);
+    if (r == 0)
+        pthread_detach (pt);
+    else
+        pt = 0;
+    g_mutex_unlock (&worker_lock);
+    if (r != 0)
+    {
+        g_atomic_int_set (&worker_running, 0);
+        method_failed (method, strerror (r));
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static void
+worker_done (void)
+{
+    g_mutex_lock (&worker_lock);
+    pt = 0;
+    g_atomic_int_set (&worker_running, 0);
+    g_mutex_unlock (&worker_lock);
+}
+
+/* for methods processed from the main loop, since state is owned by the
+ * worker while it runs */
+static gboolean
+is_busy (const gchar *method)
+{
+    if (g_atomic_int_get (&worker_running))
+    {
+        method_failed (method, _("Invalid state"));
+        return TRUE;
+    }
+    return FALSE;
+}
+
 /* methods must ALWAYS do the following :
  * - g_variant_unref (parameters) to free them
  * - either call method_failed() or emit_signal w/ their XxxxFinished signal
  * - return G_SOURCE_REMOVE (FALSE) to remove the source
  */
 
+/* resident mode: at the end of a session, the alpm handle (and the dbs it has
+ * loaded) is kept for the next one, until we've been idle for too long */
+static struct {
+    guint     idle;         /* seconds to stay around; 0: exit right away */
+    guint     timeout_id;
+    GVariant *setup;        /* what Setup was called with, minus the flags */
+    gchar    *stamp;        /* see get_stamp() */
+} resident = { 0, 0, NULL, NULL };
+
+static void
+stamp_add (GString *stamp, const gchar *file)
+{
+    struct stat st;
+
+    if (stat (file, &st) < 0)
+        g_string_append_printf (stamp, "%s:-;", file);
+    else
+        g_string_append_printf (stamp, "%s:%ld.%09ld:%ld;", file,
+                (long) st.st_mtim.tv_sec, (long) st.st_mtim.tv_nsec,
+                (long) st.st_size);
+}
+
+/* describes the state of what the handle has loaded, i.e. local & sync dbs
+ * (installing/removing a package changes the local folder) and the keyring
+ * they were validated against */
+static gchar *
+get_stamp (void)
+{
+    const gchar *dbpath = alpm_option_get_dbpath (handle);
+    const gchar *gpgdir = alpm_option_get_gpgdir (handle);
+    GString *stamp;
+    gchar *path;
+    alpm_list_t *i;
+
+    stamp = g_string_sized_new (1024);
+
+    path = g_build_filename (dbpath, "local", NULL);
+    stamp_add (stamp, path);
+    g_free (path);
+
+    FOR_LIST (i, alpm_get_syncdbs (handle))
+    {
+        gchar *file;
+
+        file = g_strconcat (alpm_db_get_name (i->data), ".db", NULL);
+        path = g_build_filename (dbpath, "sync", file, NULL);
+        stamp_add (stamp, path);
+        g_free (path);
+        g_free (file);
+    }
+
+    path = g_build_filename (gpgdir, "pubring.gpg", NULL);
+    stamp_add (stamp, path);
+    g_free (path);
+    path = g_build_filename (gpgdir, "trustdb.gpg", NULL);
+    stamp_add (stamp, path);
+    g_free (path);
+
+    return g_string_free (stamp, FALSE);
+}
+
+static void
+drop_resident (void)
+{
+    if (resident.setup)
+    {
+        g_variant_unref (resident.setup);
+        resident.setup = NULL;
+    }
+    g_free (resident.stamp);
+    resident.stamp = NULL;
+    if (handle)
+    {
+        alpm_release (handle);
+        handle = NULL;
+    }
+}
+
+static gboolean
+resident_timeout_cb (gpointer data _UNUSED_)
+{
+    resident.timeout_id = 0;
+    g_main_loop_quit (loop);
+    return G_SOURCE_REMOVE;
+}
+
+/* at the end of a session, keeps the handle for the next one if possible.
+ * Returns TRUE if so, i.e. we should keep running */
+static gboolean
+keep_resident (void)
+{
+    if (resident.idle == 0 || !handle || !resident.setup)
+        return FALSE;
+
+    switch (state)
+    {
+        case STATE_GOT_PKGS_DONE:
+            alpm_trans_release (handle);
+            drop_optdeps ();
+            /* fall through */
+        case STATE_ADD_DB_DONE:
+        case STATE_SYNC_DONE:
+        case STATE_SYSUPG_DONE:
+            break;
+        default:
+            return FALSE;
+    }
+
+    g_free (resident.stamp);
+    resident.stamp = get_stamp ();
+    state = STATE_NONE;
+    is_init = INIT_NOT;
+    resident.timeout_id = g_timeout_add_seconds (resident.idle,
+            resident_timeout_cb, NULL);
+    return TRUE;
+}
+
+/* whether the resident handle, if any, can be used for a Setup with the given
+ * parameters (nothing changed since), in which case we're good to go. Else,
+ * it is released */
+static gboolean
+resume_resident (GVariant *setup)
+{
+    gboolean ok;
+
+    if (!handle || !resident.setup)
+        return FALSE;
+
+    ok = g_variant_equal (setup, resident.setup);
+    if (ok)
+    {
+        gchar *stamp;
+
+        stamp = get_stamp ();
+        ok = streq (stamp, resident.stamp);
+        g_free (stamp);
+    }
+    if (!ok)
+    {
+        debug ("resident alpm handle out of date");
+        drop_resident ();
+        return FALSE;
+    }
+
+    state = STATE_ADD_DB_DONE;
+    return TRUE;
+}
+
 static gboolean
 init (GVariant *parameters)
 {
     gboolean downloadonly;
     gchar *sender;
+    guint rate;
+    guint idle;
 
-    g_variant_get (parameters, "(bs)", &downloadonly, &sender);
+    g_variant_get (parameters, "(bsuu)", &downloadonly, &sender, &rate, &idle);
     g_variant_unref (parameters);
 
     /* already init */
@@ -750,6 +1265,11 @@ init (GVariant *parameters)
         method_failed ("Init", _("Session already initialized\n"));
         return G_SOURCE_REMOVE;
     }
+    if (resident.timeout_id > 0)
+    {
+        g_source_remove (resident.timeout_id);
+        resident.timeout_id = 0;
+    }
     /* checking auth */
     GError *error = NULL;
     PolkitAuthority *authority;
@@ -789,13 +1309,16 @@ init (GVariant *parameters)
     /* ok, we're good */
     is_init = (downloadonly) ? INIT_DOWNLOADONLY : INIT_SYSUPGRADE;
     client = sender; /* therefore, we shoudln't free sender */
-    debug ("%s; client is %s", (downloadonly) ? "DownloadOnly": "SysUpgrade", client);
+    throttle.min_interval = (rate > 0) ? G_USEC_PER_SEC / rate : 0;
+    resident.idle = idle;
+    debug ("%s; client is %s; progress rate: %u/s; resident: %us",
+            (downloadonly) ? "DownloadOnly": "SysUpgrade", client, rate, idle);
     method_finished ("Init");
     return G_SOURCE_REMOVE;
 }
 
 static gboolean
-init_alpm (GVariant *parameters)
+do_init_alpm (const gchar *method, GVariant *parameters)
 {
     const gchar  *rootdir;
     const gchar  *dbpath;
@@ -824,10 +1347,12 @@ init_alpm (GVariant *parameters)
     if (state != STATE_NONE)
     {
         g_variant_unref (parameters);
-        method_failed ("InitAlpm", _("Invalid state"));
-        return G_SOURCE_REMOVE;
+        method_failed (method, _("Invalid state"));
+        return FALSE;
     }
     state = STATE_INIT;
+    /* in case we were resident, start anew */
+    drop_resident ();
 
     debug ("getting alpm params");
     g_variant_get (parameters, "(ssssasasisbbdasasasas)",
@@ -856,17 +1381,17 @@ init_alpm (GVariant *parameters)
     handle = alpm_initialize (rootdir, dbpath, &err);
     if (!handle)
     {
-        method_failed ("InitAlpm", _("Failed to initialize alpm library: %s\n"),
+        method_failed (method, _("Failed to initialize alpm library: %s\n"),
                 alpm_strerror (err));
         state = STATE_NONE;
-        return G_SOURCE_REMOVE;
+        return FALSE;
     }
 
     if (!(alpm_capabilities () & ALPM_CAPABILITY_DOWNLOADER))
     {
-        method_failed ("InitAlpm", _("ALPM has no downloader capability\n"));
+        method_failed (method, _("ALPM has no downloader capability\n"));
         state = STATE_INVALID;
-        return G_SOURCE_REMOVE;
+        return FALSE;
     }
 
     /* set callbacks, that we'll turn into signals */
@@ -880,10 +1405,10 @@ init_alpm (GVariant *parameters)
     ret = alpm_option_set_logfile (handle, logfile);
     if (ret != 0)
     {
-        method_failed ("InitAlpm", _("Unable to set log file: %s\n"),
+        method_failed (method, _("Unable to set log file: %s\n"),
                 alpm_strerror (alpm_errno (handle)));
         state = STATE_INVALID;
-        return G_SOURCE_REMOVE;
+        return FALSE;
     }
 
     /* Set GnuPG's home directory.  This is not relative to rootdir, even if
@@ -891,10 +1416,10 @@ init_alpm (GVariant *parameters)
     ret = alpm_option_set_gpgdir (handle, gpgdir);
     if (ret != 0)
     {
-        method_failed ("InitAlpm", _("Unable to set gpgdir: %s\n"),
+        method_failed (method, _("Unable to set gpgdir: %s\n"),
                 alpm_strerror (alpm_errno (handle)));
         state = STATE_INVALID;
-        return G_SOURCE_REMOVE;
+        return FALSE;
     }
 
     /* hookdirs */
@@ -902,11 +1427,11 @@ init_alpm (GVariant *parameters)
     {
         if (alpm_option_add_hookdir (handle, s) != 0)
         {
-            method_failed ("InitAlpm", _("Unable to add hook dir '%s': %s\n"),
+            method_failed (method, _("Unable to add hook dir '%s': %s\n"),
                     s,
                     alpm_strerror (alpm_errno (handle)));
             state = STATE_INVALID;
-            return G_SOURCE_REMOVE;
+            return FALSE;
         }
     }
     g_variant_iter_free (hookdirs_iter);
@@ -921,19 +1446,19 @@ init_alpm (GVariant *parameters)
     if (0 != alpm_option_set_cachedirs (handle, cachedirs))
     {
         FREELIST (cachedirs);
-        method_failed ("InitAlpm", _("Unable to set cache dirs: %s\n"),
+        method_failed (method, _("Unable to set cache dirs: %s\n"),
                 alpm_strerror (alpm_errno (handle)));
         state = STATE_INVALID;
-        return G_SOURCE_REMOVE;
+        return FALSE;
     }
     FREELIST (cachedirs);
 
     if (0 != alpm_option_set_default_siglevel (handle, siglevel))
     {
-        method_failed (_("Unable to set default siglevel: %s\n"),
+        method_failed (method, _("Unable to set default siglevel: %s\n"),
                 alpm_strerror (alpm_errno (handle)));
         state = STATE_INVALID;
-        return G_SOURCE_REMOVE;
+        return FALSE;
     }
 
     /* following options can't really fail, unless handle is wrong but
@@ -943,6 +1468,13 @@ init_alpm (GVariant *parameters)
     alpm_option_set_usesyslog (handle, usesyslog);
     alpm_option_set_deltaratio (handle, usedelta);
 
+    if (!cache_index)
+    {
+        cache_index = cache_index_new ();
+    }
+    cache_index_set_dirs (cache_index, alpm_option_get_cachedirs (handle),
+            usedelta > 0.0);
+
     while (g_variant_iter_loop (ignorepkgs_iter, "s", &s))
     {
         ignorepkgs = alpm_list_add (ignorepkgs, strdup (s));
@@ -978,8 +1510,20 @@ init_alpm (GVariant *parameters)
     FREELIST (noextracts);
 
     /* done */
-    method_finished ("InitAlpm");
     state = STATE_INIT_DONE;
+    return TRUE;
+}
+
+static gboolean
+init_alpm (GVariant *parameters)
+{
+    if (is_busy ("InitAlpm"))
+    {
+        g_variant_unref (parameters);
+        return G_SOURCE_REMOVE;
+    }
+    if (do_init_alpm ("InitAlpm", parameters))
+        method_finished ("InitAlpm");
     return G_SOURCE_REMOVE;
 }
 
@@ -988,18 +1532,38 @@ free_alpm (GVariant *parameters)
 {
     g_variant_unref (parameters);
 
-    /* this is in case there's a sysupgrade being performed in another thread,
-     * and we're asked to free alpm -- obviously, we shouldn't */
-    if (state == STATE_SYSUPG)
+    /* this is in case there's a worker running in another thread, and we're
+     * asked to free alpm -- obviously, we shouldn't */
+    if (g_atomic_int_get (&worker_running))
     {
         method_failed ("FreeAlpm", _("Invalid state"));
         return G_SOURCE_REMOVE;
     }
 
+    debug ("progress signals: %u emitted, %u suppressed",
+            throttle.nb_emitted, throttle.nb_suppressed);
+    reset_throttle ();
+    drop_packages_table ();
+    drop_optdeps ();
+
+    if (keep_resident ())
+    {
+        debug ("staying resident for %us", resident.idle);
+        free (client);
+        client = NULL;
+        method_finished ("FreeAlpm");
+        return G_SOURCE_REMOVE;
+    }
+
     free (client);
     client = NULL;
 
     /* free alpm */
+    if (resident.setup)
+    {
+        g_variant_unref (resident.setup);
+        resident.setup = NULL;
+    }
     if (handle && alpm_release (handle) == -1)
     {
         method_failed ("FreeAlpm", _("Failed to release alpm library\n"));
@@ -1016,7 +1580,7 @@ free_alpm (GVariant *parameters)
 }
 
 static gboolean
-add_db (GVariant *parameters)
+do_add_db (const gchar *method, GVariant *parameters)
 {
     const gchar  *name;
     int           siglevel;
@@ -1030,8 +1594,8 @@ add_db (GVariant *parameters)
     if (state != STATE_INIT_DONE && state != STATE_ADD_DB_DONE)
     {
         g_variant_unref (parameters);
-        method_failed ("AddDb", _("Invalid state"));
-        return G_SOURCE_REMOVE;
+        method_failed (method, _("Invalid state"));
+        return FALSE;
     }
     state = STATE_ADD_DB;
 
@@ -1045,10 +1609,10 @@ add_db (GVariant *parameters)
     db = alpm_register_syncdb (handle, name, (alpm_siglevel_t) siglevel);
     if (db == NULL)
     {
-        method_failed ("AddDb", _("Could not register database %s: %s\n"),
+        method_failed (method, _("Could not register database %s: %s\n"),
                 name, alpm_strerror (alpm_errno (handle)));
         state = old_state;
-        return G_SOURCE_REMOVE;
+        return FALSE;
     }
 
     while (g_variant_iter_loop (servers_iter, "s", &s))
@@ -1076,11 +1640,11 @@ add_db (GVariant *parameters)
             {
                 free (temp);
                 FREELIST (servers);
-                method_failed ("AddDb",
+                method_failed (method,
                         _("Server %s contains the $arch variable, but no Architecture was defined.\n"),
                         value);
                 state = STATE_INVALID;
-                return G_SOURCE_REMOVE;
+                return FALSE;
             }
             server = temp;
         }
@@ -1091,13 +1655,13 @@ add_db (GVariant *parameters)
             FREELIST (servers);
             free (server);
             /* pm_errno is set by alpm_db_setserver */
-            method_failed ("AddDb",
+            method_failed (method,
                     _("Could not add server %s to database %s: %s\n"),
                     server,
                     name,
                     alpm_strerror (alpm_errno (handle)));
             state = old_state;
-            return G_SOURCE_REMOVE;
+            return FALSE;
         }
         free (server);
     }
@@ -1106,33 +1670,43 @@ add_db (GVariant *parameters)
     /* ensure db is valid */
     if (alpm_db_get_valid (db))
     {
-        method_failed ("AddDb", _("Database %s is not valid: %s\n"),
+        method_failed (method, _("Database %s is not valid: %s\n"),
                 name,
                 alpm_strerror (alpm_errno (handle)));
         state = STATE_INVALID;
-        return G_SOURCE_REMOVE;
+        return FALSE;
     }
 
     /* done */
-    method_finished ("AddDb");
     state = STATE_ADD_DB_DONE;
+    return TRUE;
+}
+
+static gboolean
+add_db (GVariant *parameters)
+{
+    if (is_busy ("AddDb"))
+    {
+        g_variant_unref (parameters);
+        return G_SOURCE_REMOVE;
+    }
+    if (do_add_db ("AddDb", parameters))
+        method_finished ("AddDb");
     return G_SOURCE_REMOVE;
 }
 
 static gboolean
-sync_dbs (GVariant *parameters)
+do_sync_dbs (const gchar *method)
 {
     alpm_list_t        *syncdbs   = NULL;
     alpm_list_t        *i;
     int                 ret;
     sync_db_results_t   result;
 
-    g_variant_unref (parameters);
-
     if (state != STATE_ADD_DB_DONE && state != STATE_SYNC_DONE)
     {
-        method_failed ("SyncDbs", _("Invalid state"));
-        return G_SOURCE_REMOVE;
+        method_failed (method, _("Invalid state"));
+        return FALSE;
     }
     state = STATE_SYNC;
 
@@ -1162,10 +1736,42 @@ sync_dbs (GVariant *parameters)
                     alpm_db_get_name (db));
         }
         emit_signal ("SyncDbEnd", "i", result);
+
+        if (interrupted)
+        {
+            method_failed (method, _("Operation aborted\n"));
+            state = STATE_ADD_DB_DONE;
+            return FALSE;
+        }
     }
 
-    method_finished ("SyncDbs");
     state = STATE_SYNC_DONE;
+    return TRUE;
+}
+
+static gpointer
+thread_sync_dbs (gpointer data _UNUSED_)
+{
+    if (do_sync_dbs ("SyncDbs"))
+        method_finished ("SyncDbs");
+    worker_done ();
+    return NULL;
+}
+
+static gboolean
+sync_dbs (GVariant *parameters)
+{
+    g_variant_unref (parameters);
+
+    if (is_busy ("SyncDbs"))
+        return G_SOURCE_REMOVE;
+    if (state != STATE_ADD_DB_DONE && state != STATE_SYNC_DONE)
+    {
+        method_failed ("SyncDbs", _("Invalid state"));
+        return G_SOURCE_REMOVE;
+    }
+
+    start_worker ("SyncDbs", thread_sync_dbs, NULL);
     return G_SOURCE_REMOVE;
 }
 
@@ -1177,8 +1783,10 @@ answer (GVariant *parameters)
     g_variant_get (parameters, "(i)", &response);
     g_variant_unref (parameters);
 
+    g_mutex_lock (&choice_mutex);
     if (choice != CHOICE_WAITING)
     {
+        g_mutex_unlock (&choice_mutex);
         method_failed ("Answer",
                 _("Invalid call to Answer, no Question pending.\n"));
         return G_SOURCE_REMOVE;
@@ -1193,39 +1801,174 @@ answer (GVariant *parameters)
         debug ("Invalid answer, defaulting to no (0)");
         choice = 0;
     }
+    g_cond_signal (&choice_cond);
+    g_mutex_unlock (&choice_mutex);
     method_finished ("Answer");
     return G_SOURCE_REMOVE;
 }
 
+/* adds s to the strings of the packages table, once: returns its offset */
+static guint32
+table_add_str (GString *strings, GHashTable *offsets, const gchar *s)
+{
+    gpointer offset;
+
+    if (!s)
+        s = "";
+    if (g_hash_table_lookup_extended (offsets, s, NULL, &offset))
+        return GPOINTER_TO_UINT (offset);
+
+    offset = GUINT_TO_POINTER (strings->len);
+    g_string_append_len (strings, s, (gssize) strlen (s) + 1);
+    g_hash_table_insert (offsets, (gpointer) s, offset);
+    return GPOINTER_TO_UINT (offset);
+}
+
+static void
+table_add_pkg (GArray       *records,
+               GString      *strings,
+               GHashTable   *offsets,
+               const gchar  *repo,
+               const gchar  *name,
+               const gchar  *desc,
+               const gchar  *old_version,
+               const gchar  *new_version,
+               guint         dl_size,
+               guint         old_size,
+               guint         new_size)
+{
+    kupdater_pkg_record_t rec;
+
+    rec.repo        = table_add_str (strings, offsets, repo);
+    rec.name        = table_add_str (strings, offsets, name);
+    rec.desc        = table_add_str (strings, offsets, desc);
+    rec.old_version = table_add_str (strings, offsets, old_version);
+    rec.new_version = table_add_str (strings, offsets, new_version);
+    rec.dl_size     = dl_size;
+    rec.old_size    = old_size;
+    rec.new_size    = new_size;
+    g_array_append_val (records, rec);
+}
+
+static void
+drop_packages_table (void)
+{
+    gint fd;
+
+    fd = g_atomic_int_get (&pkg_table_fd);
+    g_atomic_int_set (&pkg_table_fd, -1);
+    if (fd >= 0)
+        close (fd);
+}
+
+#ifdef HAVE_MEMFD_CREATE
 static gboolean
-get_packages (GVariant *parameters)
+write_all (gint fd, gconstpointer data, gsize len)
 {
-    g_variant_unref (parameters);
+    const gchar *d = data;
+
+    while (len > 0)
+    {
+        gssize w;
+
+        w = write (fd, d, len);
+        if (w < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return FALSE;
+        }
+        d += w;
+        len -= (gsize) w;
+    }
+    return TRUE;
+}
+#endif
+
+/* writes the packages table into a sealed memfd, kept until the client takes
+ * it. Returns the size of the table, or 0 if it should be sent as a GVariant
+ * instead (small table, no fd passing, or error) */
+static gsize
+make_packages_table (GArray *records, GString *strings)
+{
+    kupdater_pkg_table_t hdr;
+    gsize len;
+#ifdef HAVE_MEMFD_CREATE
+    gint fd;
+#endif
+
+    len = sizeof (hdr) + records->len * sizeof (kupdater_pkg_record_t)
+        + strings->len;
+    if (len < KUPDATER_PKG_TABLE_MIN)
+        return 0;
+    if (!(g_dbus_connection_get_capabilities (connection)
+                & G_DBUS_CAPABILITY_FLAGS_UNIX_FD_PASSING))
+        return 0;
+
+#ifdef HAVE_MEMFD_CREATE
+    memcpy (hdr.magic, KUPDATER_PKG_TABLE_MAGIC, sizeof (hdr.magic));
+    hdr.version = KUPDATER_PKG_TABLE_VERSION;
+    hdr.nb_pkgs = records->len;
+    hdr.strings_len = (guint32) strings->len;
+
+    fd = memfd_create ("kalu-packages", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0)
+    {
+        debug ("packages table: memfd_create failed: %s", strerror (errno));
+        return 0;
+    }
+    if (!write_all (fd, &hdr, sizeof (hdr))
+            || !write_all (fd, records->data,
+                records->len * sizeof (kupdater_pkg_record_t))
+            || !write_all (fd, strings->str, strings->len)
+            || fcntl (fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW
+                | F_SEAL_WRITE | F_SEAL_SEAL) < 0)
+    {
+        debug ("packages table: unable to write memfd: %s", strerror (errno));
+        close (fd);
+        return 0;
+    }
+
+    drop_packages_table ();
+    g_atomic_int_set (&pkg_table_fd, fd);
+    return len;
+#else
+    (void) hdr;
+    return 0;
+#endif
+}
+
+/* on success, GetPackagesFinished (or GetPackagesTable) is emitted in lieu of
+ * MethodFinished */
+static void
+do_get_packages (const gchar *method)
+{
+    enum state old_state = state;
 
     if (state != STATE_SYNC_DONE && state != STATE_ADD_DB_DONE)
     {
-        method_failed ("GetPackages", _("Invalid state"));
-        return G_SOURCE_REMOVE;
+        method_failed (method, _("Invalid state"));
+        return;
     }
     state = STATE_GOT_PKGS;
 
     if (alpm_trans_init (handle,
                 (is_init == INIT_DOWNLOADONLY) ? ALPM_TRANS_FLAG_DOWNLOADONLY : 0) == -1)
     {
-        method_failed ("GetPackages",
+        method_failed (method,
                 _("Failed to initiate transaction: %s\n"),
                 alpm_strerror (alpm_errno (handle)));
         state = STATE_INVALID;
-        return G_SOURCE_REMOVE;
+        return;
     }
 
     if (alpm_sync_sysupgrade (handle, 0) == -1)
     {
-        method_failed ("GetPackages", "%s",
+        method_failed (method, "%s",
                 alpm_strerror (alpm_errno (handle)));
         alpm_trans_release (handle);
         state = STATE_INVALID;
-        return G_SOURCE_REMOVE;
+        return;
     }
 
     alpm_list_t *alpm_data = NULL;
@@ -1301,7 +2044,7 @@ get_packages (GVariant *parameters)
             }
             alpm_list_free (details);
             details = NULL;
-            method_failed ("GetPackages",
+            method_failed (method,
                     _("Failed to prepare transaction: %s :\n%s\n"),
                     alpm_strerror (err),
                     errmsg);
@@ -1309,7 +2052,7 @@ get_packages (GVariant *parameters)
         }
         else
         {
-            method_failed ("GetPackages",
+            method_failed (method,
                     _("Failed to prepare transaction: %s\n"),
                     alpm_strerror (err));
         }
@@ -1317,17 +2060,32 @@ get_packages (GVariant *parameters)
         alpm_list_free (alpm_data);
         alpm_trans_release (handle);
         state = STATE_INVALID;
-        return G_SOURCE_REMOVE;
+        return;
     }
     alpm_list_free (alpm_data);
 
+    if (interrupted)
+    {
+        method_failed (method, _("Operation aborted\n"));
+        alpm_trans_release (handle);
+        state = old_state;
+        return;
+    }
+
     alpm_list_t *pkgs;
-    GVariantBuilder *builder;
     alpm_db_t *localdb = alpm_get_localdb (handle);
     alpm_list_t *i;
+    GArray *records;
+    GString *strings;
+    GHashTable *offsets;
+    gsize len;
 
-    builder = g_variant_builder_new (G_VARIANT_TYPE ("a(sssssuuu)"));
+    records = g_array_new (FALSE, FALSE, sizeof (kupdater_pkg_record_t));
+    strings = g_string_sized_new (4096);
+    /* keys are owned by the alpm packages, valid until trans_release */
+    offsets = g_hash_table_new (g_str_hash, g_str_equal);
 
+    cache_index_refresh (cache_index);
     pkgs = alpm_trans_get_add (handle);
     FOR_LIST (i, pkgs)
     {
@@ -1335,13 +2093,13 @@ get_packages (GVariant *parameters)
         const char *name     = alpm_pkg_get_name (pkg);
         alpm_pkg_t *localpkg = alpm_db_get_pkg (localdb, name);
 
-        g_variant_builder_add (builder, "(sssssuuu)",
+        table_add_pkg (records, strings, offsets,
                 alpm_db_get_name (alpm_pkg_get_db (pkg)),
                 name,
                 alpm_pkg_get_desc (pkg),
                 (localpkg) ? alpm_pkg_get_version (localpkg) : "-",
                 alpm_pkg_get_version (pkg),
-                (guint) alpm_pkg_download_size (pkg),
+                (guint) cache_index_download_size (cache_index, pkg),
                 (guint) alpm_pkg_get_isize (localpkg),
                 (guint) alpm_pkg_get_isize (pkg));
     }
@@ -1351,7 +2109,7 @@ get_packages (GVariant *parameters)
     {
         alpm_pkg_t *pkg      = i->data;
 
-        g_variant_builder_add (builder, "(sssssuuu)",
+        table_add_pkg (records, strings, offsets,
                 alpm_db_get_name (alpm_pkg_get_db (pkg)),
                 alpm_pkg_get_name (pkg),
                 alpm_pkg_get_desc (pkg),
@@ -1362,20 +2120,201 @@ get_packages (GVariant *parameters)
                 (guint) 0);
     }
 
-    emit_signal ("GetPackagesFinished", "a(sssssuuu)", builder);
-    g_variant_builder_unref (builder);
+    g_hash_table_unref (offsets);
+
+    /* done here, as the commit shouldn't be slowed down by it */
+    precompute_optdeps ();
+
+    /* big tables are sent through a memfd, to spare the bus */
+    len = make_packages_table (records, strings);
+    if (len > 0)
+    {
+        debug ("packages table: %u packages, %" G_GSIZE_FORMAT " bytes",
+                records->len, len);
+        emit_signal ("GetPackagesTable", "u", (guint) len);
+    }
+    else
+    {
+        GVariantBuilder *builder;
+        guint n;
+
+        builder = g_variant_builder_new (G_VARIANT_TYPE ("a(sssssuuu)"));
+        for (n = 0; n < records->len; ++n)
+        {
+            kupdater_pkg_record_t *rec;
+
+            rec = &g_array_index (records, kupdater_pkg_record_t, n);
+            g_variant_builder_add (builder, "(sssssuuu)",
+                    strings->str + rec->repo,
+                    strings->str + rec->name,
+                    strings->str + rec->desc,
+                    strings->str + rec->old_version,
+                    strings->str + rec->new_version,
+                    rec->dl_size,
+                    rec->old_size,
+                    rec->new_size);
+        }
+        emit_signal ("GetPackagesFinished", "a(sssssuuu)", builder);
+        g_variant_builder_unref (builder);
+    }
+    g_array_free (records, TRUE);
+    g_string_free (strings, TRUE);
     /* we don't alpm_trans_release (handle) since that will be done only if
      * user cancel (NoSysUpgrade) or after the update is done (SysUpgrade) */
     state = STATE_GOT_PKGS_DONE;
+}
+
+static gpointer
+thread_get_packages (gpointer data _UNUSED_)
+{
+    do_get_packages ("GetPackages");
+    worker_done ();
+    return NULL;
+}
+
+static gboolean
+get_packages (GVariant *parameters)
+{
+    g_variant_unref (parameters);
+
+    if (is_busy ("GetPackages"))
+        return G_SOURCE_REMOVE;
+    if (state != STATE_SYNC_DONE && state != STATE_ADD_DB_DONE)
+    {
+        method_failed ("GetPackages", _("Invalid state"));
+        return G_SOURCE_REMOVE;
+    }
+
+    start_worker ("GetPackages", thread_get_packages, NULL);
     return G_SOURCE_REMOVE;
 }
 
-static pthread_t pt = 0;
+/* does InitAlpm & AddDb for each db, from the (ssssasasisbbdasasasasa(sias)u)
+ * given to Setup (minus the flags) */
+static gboolean
+setup_alpm (GVariant *setup)
+{
+    GVariant     *alpm_params[15];
+    GVariant     *parameters;
+    GVariant     *dbs;
+    GVariant     *db;
+    GVariantIter  iter;
+    guint         parallel_downloads;
+    gsize         n;
+
+    for (n = 0; n < 15; ++n)
+        alpm_params[n] = g_variant_get_child_value (setup, n);
+    parameters = g_variant_ref_sink (g_variant_new_tuple (alpm_params, 15));
+    for (n = 0; n < 15; ++n)
+        g_variant_unref (alpm_params[n]);
+    if (!do_init_alpm ("Setup", parameters))
+        return FALSE;
+
+    g_variant_get_child (setup, 16, "u", &parallel_downloads);
+#ifdef HAVE_ALPM_PARALLEL_DOWNLOADS
+    if (0 != alpm_option_set_parallel_downloads (handle, parallel_downloads))
+    {
+        method_failed ("Setup", _("Unable to set parallel downloads: %s\n"),
+                alpm_strerror (alpm_errno (handle)));
+        state = STATE_INVALID;
+        return FALSE;
+    }
+    debug ("parallel downloads: %u", parallel_downloads);
+#else
+    if (parallel_downloads > 1)
+        debug ("parallel downloads (%u) not supported by libalpm, ignored",
+                parallel_downloads);
+#endif
+
+    dbs = g_variant_get_child_value (setup, 15);
+    g_variant_iter_init (&iter, dbs);
+    while ((db = g_variant_iter_next_value (&iter)))
+    {
+        if (!do_add_db ("Setup", db))
+        {
+            g_variant_unref (dbs);
+            return FALSE;
+        }
+    }
+    g_variant_unref (dbs);
+    return TRUE;
+}
+
+/* does InitAlpm, AddDb for each db, and optionally SyncDbs & GetPackages, all
+ * in one go. The first two are skipped when a resident handle can be used */
+static void
+do_setup (GVariant *parameters)
+{
+    GVariant     *children[17];
+    GVariant     *setup;
+    guint         flags;
+    gsize         n;
+
+    /* everything but the flags, to compare w/ what a resident handle was set
+     * up with */
+    for (n = 0; n < 17; ++n)
+        children[n] = g_variant_get_child_value (parameters, n);
+    g_variant_get_child (parameters, 17, "u", &flags);
+    g_variant_unref (parameters);
+    setup = g_variant_ref_sink (g_variant_new_tuple (children, 17));
+    for (n = 0; n < 17; ++n)
+        g_variant_unref (children[n]);
+
+    if (resume_resident (setup))
+    {
+        debug ("re-using resident alpm handle");
+        g_variant_unref (setup);
+    }
+    else if (setup_alpm (setup))
+    {
+        resident.setup = setup;
+    }
+    else
+    {
+        g_variant_unref (setup);
+        return;
+    }
+
+    if ((flags & SETUP_SYNC_DBS) && !do_sync_dbs ("Setup"))
+        return;
+
+    if (flags & SETUP_GET_PACKAGES)
+        do_get_packages ("Setup");
+    else
+        method_finished ("Setup");
+}
+
 static gpointer
-thread_sysupgrade (gpointer data _UNUSED_)
+thread_setup (gpointer parameters)
+{
+    do_setup (parameters);
+    worker_done ();
+    return NULL;
+}
+
+static gboolean
+setup (GVariant *parameters)
 {
-    pt = pthread_self ();
+    if (is_busy ("Setup"))
+    {
+        g_variant_unref (parameters);
+        return G_SOURCE_REMOVE;
+    }
+    if (state != STATE_NONE)
+    {
+        g_variant_unref (parameters);
+        method_failed ("Setup", _("Invalid state"));
+        return G_SOURCE_REMOVE;
+    }
 
+    if (!start_worker ("Setup", thread_setup, parameters))
+        g_variant_unref (parameters);
+    return G_SOURCE_REMOVE;
+}
+
+static gpointer
+thread_sysupgrade (gpointer data _UNUSED_)
+{
     if (is_init == INIT_SYSUPGRADE)
         alpm_logaction (handle, PREFIX, "starting sysupgrade...\n");
 
@@ -1463,18 +2402,20 @@ thread_sysupgrade (gpointer data _UNUSED_)
                     "Failed to commit sysupgrade transaction: %s\n",
                     alpm_strerror (err));
         alpm_trans_release (handle);
+        drop_optdeps ();
         state = STATE_INVALID;
-        pt = 0;
+        worker_done ();
         return NULL;
     }
 
     alpm_list_free (alpm_data);
     alpm_trans_release (handle);
+    drop_optdeps ();
     if (is_init == INIT_SYSUPGRADE)
         alpm_logaction (handle, PREFIX, "sysupgrade completed\n");
     method_finished ("SysUpgrade");
     state = STATE_SYSUPG_DONE;
-    pt = 0;
+    worker_done ();
     return NULL;
 }
 
@@ -1490,9 +2431,9 @@ sysupgrade (GVariant *parameters)
     }
     state = STATE_SYSUPG;
 
-    /* do the work in another thread, so we can still process method Abort if
-     * needed, to raise SIGINT and abort the alpm transaction */
-    g_thread_unref (g_thread_new ("sysupgrade", thread_sysupgrade, NULL));
+    /* raising SIGINT will abort the alpm transaction */
+    if (!start_worker ("SysUpgrade", thread_sysupgrade, NULL))
+        state = STATE_GOT_PKGS_DONE;
 
     return G_SOURCE_REMOVE;
 }
@@ -1501,17 +2442,21 @@ static gboolean
 do_abort (GVariant *parameters)
 {
     g_variant_unref (parameters);
-    if (state != STATE_SYSUPG)
+    g_mutex_lock (&worker_lock);
+    if (!g_atomic_int_get (&worker_running))
     {
+        g_mutex_unlock (&worker_lock);
         method_failed ("Abort", _("Invalid state"));
         return G_SOURCE_REMOVE;
     }
 
     /* this will cause us to abort (interrupt) the transaction (if any) and end
      * properly. Also it will be caught by libalpm if during a download, so it
-     * can be aborted properly, then raised again so we handle it as well */
-    if (pt > 0)
-        pthread_kill (pt, SIGINT);
+     * can be aborted properly, then raised again so we handle it as well.
+     * The worker can't get past worker_done's lock before handling it, so our
+     * handler always sees worker_running set */
+    pthread_kill (pt, SIGINT);
+    g_mutex_unlock (&worker_lock);
 
     method_finished ("Abort");
     return G_SOURCE_REMOVE;
@@ -1521,6 +2466,8 @@ static gboolean
 no_sysupgrade (GVariant *parameters)
 {
     g_variant_unref (parameters);
+    if (is_busy ("NoSysUpgrade"))
+        return G_SOURCE_REMOVE;
     if (state != STATE_GOT_PKGS_DONE)
     {
         method_failed ("NoSysUpgrade", _("Invalid state"));
@@ -1528,6 +2475,7 @@ no_sysupgrade (GVariant *parameters)
     }
 
     alpm_trans_release (handle);
+    drop_optdeps ();
     method_finished ("NoSysUpgrade");
     state = STATE_SYSUPG_DONE;
     return G_SOURCE_REMOVE;
@@ -1556,6 +2504,29 @@ no_sysupgrade (GVariant *parameters)
             return;                                                     \
         }                                                               \
     } while (0)
+/* hands the sealed memfd of the packages table over to the client */
+static void
+take_packages_table (GDBusMethodInvocation *invocation)
+{
+    GUnixFDList *fd_list;
+    gint fd;
+
+    fd = g_atomic_int_get (&pkg_table_fd);
+    if (fd < 0)
+    {
+        send_error ("NoPackagesTable", _("No packages table available\n"));
+        return;
+    }
+    g_atomic_int_set (&pkg_table_fd, -1);
+
+    /* fd_list takes ownership of fd */
+    fd_list = g_unix_fd_list_new_from_array (&fd, 1);
+    g_dbus_method_invocation_return_value_with_unix_fd_list (invocation,
+            g_variant_new ("(h)", 0),
+            fd_list);
+    g_object_unref (fd_list);
+}
+
 static void
 handle_method_call (GDBusConnection       *conn _UNUSED_,
                     const gchar           *sender,
@@ -1571,11 +2542,14 @@ handle_method_call (GDBusConnection       *conn _UNUSED_,
     if (g_strcmp0 (method_name, "Init") == 0)
     {
         gboolean downloadonly;
+        guint rate;
+        guint idle;
 
         /* we need to send the sender to init, hence the following */
-        g_variant_get (parameters, "(b)", &downloadonly);
+        g_variant_get (parameters, "(buu)", &downloadonly, &rate, &idle);
         g_idle_add ((GSourceFunc) init,
-                g_variant_ref_sink (g_variant_new ("(bs)", downloadonly, sender)));
+                g_variant_ref_sink (g_variant_new ("(bsuu)", downloadonly, sender,
+                        rate, idle)));
         g_dbus_method_invocation_return_value (invocation, NULL);
         return;
     }
@@ -1595,6 +2569,13 @@ handle_method_call (GDBusConnection       *conn _UNUSED_,
 
     /* client/sender has been auth (PK) */
 
+    if (g_strcmp0 (method_name, "TakePackagesTable") == 0)
+    {
+        take_packages_table (invocation);
+        return;
+    }
+
+    if_method ("Setup",         setup);
     if_method ("InitAlpm",      init_alpm);
     if_method ("FreeAlpm",      free_alpm);
     if_method ("AddDb",         add_db);
@@ -1654,10 +2635,8 @@ static int rc = 0;
 static void
 sig_handler (gint signum)
 {
-    if (signum == SIGINT && state == STATE_SYSUPG)
+    if (signum == SIGINT && g_atomic_int_get (&worker_running))
     {
-        static gboolean interrupted = FALSE;
-
         /* our handler might be called multiple times because if a download was
          * aborted via SIGINT, all pending downloads will still "go through"
          * only to be aborted instantly, but that does raise a SIGINT each time.
@@ -1665,11 +2644,11 @@ sig_handler (gint signum)
          * "weird" error message (instead of the precise "unexpected error" :p)
          * so let's don't.
          */
-        if (!interrupted)
-        {
+        if (!interrupted && state == STATE_SYSUPG)
             alpm_trans_interrupt (handle);
-            interrupted = TRUE;
-        }
+        /* otherwise the worker will check for it once libalpm returns (it
+         * aborts downloads on SIGINT) */
+        interrupted = 1;
         return;
     }
 
@@ -1716,10 +2695,13 @@ main (int argc _UNUSED_, char *argv[] _UNUSED_)
 
     g_bus_unown_name (owner_id);
 
-    if (handle)
-        alpm_release (handle);
+    drop_resident ();
     if (client)
         free (client);
+    drop_packages_table ();
+    drop_optdeps ();
+    if (cache_index)
+        cache_index_free (cache_index);
 
     return rc;
 }
@@ -23,6 +23,8 @@
 #ifndef _KALU_KUPDATER_H
 #define _KALU_KUPDATER_H
 
+#include <stdint.h>
+
 /* keep in sync w/ kalu_alpm_syncdbs in kalu-alpm.c */
 typedef enum _sync_db_results_t {
     SYNC_SUCCESS,
@@ -68,6 +70,45 @@ typedef enum _event_t {
     EVENT_KEYRING,
 } event_t;
 
+/* how many Downloading/Progress signals per second we ask kalu-dbus (on Init)
+ * to emit at most. Progress in between is coalesced. 0 means no limit */
+#define KUPDATER_PROGRESS_RATE      30
+
+/* flags for method Setup */
+typedef enum _setup_flags_t {
+    SETUP_SYNC_DBS      = (1 << 0),
+    SETUP_GET_PACKAGES  = (1 << 1)
+} setup_flags_t;
+
+/* GetPackages: when the packages table is at least that big (in bytes), it
+ * isn't sent in signal GetPackagesFinished, but written into a sealed memfd;
+ * signal GetPackagesTable is emitted, and the client gets the fd via method
+ * TakePackagesTable */
+#define KUPDATER_PKG_TABLE_MIN      (16 * 1024)
+
+#define KUPDATER_PKG_TABLE_MAGIC    "KPKG"
+#define KUPDATER_PKG_TABLE_VERSION  1
+
+/* the table is made of this header, nb_pkgs records, and strings_len bytes of
+ * NUL-terminated strings, which records refer to by their offset */
+typedef struct _kupdater_pkg_table_t {
+    char        magic[4];
+    uint32_t    version;
+    uint32_t    nb_pkgs;
+    uint32_t    strings_len;
+} kupdater_pkg_table_t;
+
+typedef struct _kupdater_pkg_record_t {
+    uint32_t    repo;
+    uint32_t    name;
+    uint32_t    desc;
+    uint32_t    old_version;
+    uint32_t    new_version;
+    uint32_t    dl_size;
+    uint32_t    old_size;
+    uint32_t    new_size;
+} kupdater_pkg_record_t;
+
 typedef enum _event_type_t {
     EVENT_TYPE_START,
     EVENT_TYPE_DONE
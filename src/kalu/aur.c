@@ -90,8 +90,8 @@ find_nf (gpointer data, gpointer _find_data)
     s += len;                                       \
 } while (0)
 gboolean
-aur_has_updates (alpm_list_t **packages,
-                 alpm_list_t **not_found,
+aur_has_updates (packages_t **packages,
+                 packages_t **not_found,
                  alpm_list_t *aur_pkgs,
                  gboolean is_watched,
                  GError **error)
@@ -212,7 +212,7 @@ aur_has_updates (alpm_list_t **packages,
         {
             g_propagate_error (error, local_err);
             FREELIST (urls);
-            FREE_PACKAGE_LIST (*packages);
+            FREE_PACKAGES (*packages);
             alpm_list_free (list_nf);
             return FALSE;
         }
@@ -226,7 +226,7 @@ aur_has_updates (alpm_list_t **packages,
             g_set_error (error, KALU_ERROR, 8,
                     _("Invalid JSON response from the AUR"));
             FREELIST (urls);
-            FREE_PACKAGE_LIST (*packages);
+            FREE_PACKAGES (*packages);
             alpm_list_free (list_nf);
             free (data);
             return FALSE;
@@ -255,7 +255,7 @@ aur_has_updates (alpm_list_t **packages,
                             _("Unexpected results from the AUR [%s]"),
                             pkgname);
                     FREELIST (urls);
-                    FREE_PACKAGE_LIST (*packages);
+                    FREE_PACKAGES (*packages);
                     alpm_list_free (list_nf);
                     free (data);
                     cJSON_Delete (json);
@@ -283,12 +283,11 @@ aur_has_updates (alpm_list_t **packages,
                 if (alpm_pkg_vercmp (pkgver, oldver) == 1)
                 {
                     debug ("%s %s -> %s", pkgname, oldver, pkgver);
-                    kpkg = new0 (kalu_package_t, 1);
-                    kpkg->name = strdup (pkgname);
-                    kpkg->desc = strdup (pkgdesc);
-                    kpkg->old_version = strdup (oldver);
-                    kpkg->new_version = strdup (pkgver);
-                    *packages = alpm_list_add (*packages, kpkg);
+                    kpkg = add_package (packages);
+                    kpkg->name = intern_str (*packages, pkgname);
+                    kpkg->desc = intern_str (*packages, pkgdesc);
+                    kpkg->old_version = intern_str (*packages, oldver);
+                    kpkg->new_version = intern_str (*packages, pkgver);
                 }
             }
         }
@@ -297,42 +296,36 @@ aur_has_updates (alpm_list_t **packages,
     }
     FREELIST (urls);
 
-    /* turn not_found into a list of kalu_package_t as it should be, or add them
-     * to packages (if not_found is NULL, i.e. is_watched is TRUE) */
+    /* turn not_found into packages as it should be, or add them to packages
+     * (if not_found is NULL, i.e. is_watched is TRUE) */
     if (list_nf)
     {
+        packages_t **nf = (not_found) ? not_found : packages;
+
         FOR_LIST (i, list_nf)
         {
-            kpkg = new0 (kalu_package_t, 1);
+            kpkg = add_package (nf);
 
             if (is_watched)
             {
                 watched_package_t *wp = i->data;
 
-                kpkg->name = strdup (wp->name);
-                kpkg->desc = strdup (_("<package not found>"));
-                kpkg->old_version = strdup (wp->version);
-                kpkg->new_version = strdup ("-");
+                kpkg->name = intern_str (*nf, wp->name);
+                kpkg->desc = intern_str (*nf, _("<package not found>"));
+                kpkg->old_version = intern_str (*nf, wp->version);
+                kpkg->new_version = intern_str (*nf, "-");
             }
             else
             {
                 alpm_pkg_t *p = i->data;
 
-                kpkg->name = strdup (alpm_pkg_get_name (p));
-                kpkg->desc = strdup (alpm_pkg_get_desc (p));
-                kpkg->old_version = strdup (alpm_pkg_get_version (p));
+                kpkg->name = intern_str (*nf, alpm_pkg_get_name (p));
+                kpkg->desc = intern_str (*nf, alpm_pkg_get_desc (p));
+                kpkg->old_version = intern_str (*nf, alpm_pkg_get_version (p));
             }
 
-            if (not_found)
-            {
-                debug ("adding to not found: package %s", kpkg->name);
-                *not_found = alpm_list_add (*not_found, kpkg);
-            }
-            else
-            {
-                debug ("not found: %s", kpkg->name);
-                *packages = alpm_list_add (*packages, kpkg);
-            }
+            debug ((not_found) ? "adding to not found: package %s" : "not found: %s",
+                    kpkg->name);
         }
         alpm_list_free (list_nf);
     }
@@ -24,8 +24,8 @@
 #define _KALU_AUR_H
 
 gboolean
-aur_has_updates (alpm_list_t **packages,
-                 alpm_list_t **not_found,
+aur_has_updates (packages_t **packages,
+                 packages_t **not_found,
                  alpm_list_t *aur_pkgs,
                  gboolean is_watched,
                  GError **error);
@@ -0,0 +1,275 @@
+/**
+ * kalu - Copyright (C) 2012-2018 Olivier Brunel
+ *
+ * cache-index.c
+ * Copyright (C) 2012-2018 Olivier Brunel <jjk@jjacky.com>
+ *
+ * This file is part of kalu.
+ *
+ * kalu is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * kalu is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * kalu. If not, see http://www.gnu.org/licenses/
+ */
+
+#include <config.h>
+
+/* C */
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+
+/* kalu */
+#include "shared.h"
+#include "cache-index.h"
+
+#define PART_EXT        ".part"
+#define INOTIFY_MASK    (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO \
+        | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR)
+
+typedef struct _cache_dir_t {
+    gchar       *path;
+    gint         wd;        /* -1 when not watched */
+    gboolean     indexed;
+    GHashTable  *files;     /* set of file names */
+} cache_dir_t;
+
+struct _cache_index_t
+{
+    gint         fd;        /* inotify, -1 when not available */
+    GPtrArray   *dirs;
+    gboolean     usedelta;
+};
+
+static void
+free_dir (cache_dir_t *dir)
+{
+    g_hash_table_unref (dir->files);
+    g_free (dir->path);
+    free (dir);
+}
+
+/* only names are indexed, so it doesn't stat anything */
+static void
+scan_dir (cache_index_t *ci, cache_dir_t *dir)
+{
+    GDir *gdir;
+    const gchar *name;
+
+    g_hash_table_remove_all (dir->files);
+    dir->indexed = FALSE;
+
+    /* watch first, so nothing happening while we read the dir is missed */
+    if (ci->fd >= 0 && dir->wd < 0)
+        dir->wd = inotify_add_watch (ci->fd, dir->path, INOTIFY_MASK);
+
+    gdir = g_dir_open (dir->path, 0, NULL);
+    if (!gdir)
+        return;
+    while ((name = g_dir_read_name (gdir)))
+        g_hash_table_add (dir->files, g_strdup (name));
+    g_dir_close (gdir);
+    dir->indexed = TRUE;
+}
+
+cache_index_t *
+cache_index_new (void)
+{
+    cache_index_t *ci;
+
+    ci = new0 (cache_index_t, 1);
+    /* without inotify, dirs simply get scanned on each refresh */
+    ci->fd = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC);
+    ci->dirs = g_ptr_array_new_with_free_func ((GDestroyNotify) free_dir);
+    return ci;
+}
+
+void
+cache_index_set_dirs (cache_index_t *ci, alpm_list_t *cachedirs,
+                      gboolean usedelta)
+{
+    alpm_list_t *i;
+    guint n;
+
+    ci->usedelta = usedelta;
+
+    for (i = cachedirs, n = 0; i && n < ci->dirs->len; i = i->next, ++n)
+        if (!streq (i->data, ((cache_dir_t *) ci->dirs->pdata[n])->path))
+            break;
+    if (!i && n == ci->dirs->len)
+        return;
+
+    /* closing the inotify instance is the simplest way to drop all watches */
+    if (ci->fd >= 0)
+    {
+        close (ci->fd);
+        ci->fd = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC);
+    }
+    g_ptr_array_set_size (ci->dirs, 0);
+
+    FOR_LIST (i, cachedirs)
+    {
+        cache_dir_t *dir;
+
+        dir = new0 (cache_dir_t, 1);
+        dir->path = g_strdup (i->data);
+        dir->wd = -1;
+        dir->files = g_hash_table_new_full (g_str_hash, g_str_equal,
+                g_free, NULL);
+        g_ptr_array_add (ci->dirs, dir);
+        scan_dir (ci, dir);
+    }
+}
+
+static cache_dir_t *
+get_dir (cache_index_t *ci, gint wd)
+{
+    guint n;
+
+    for (n = 0; n < ci->dirs->len; ++n)
+        if (((cache_dir_t *) ci->dirs->pdata[n])->wd == wd)
+            return ci->dirs->pdata[n];
+    return NULL;
+}
+
+static void
+handle_event (cache_index_t *ci, struct inotify_event *event)
+{
+    cache_dir_t *dir;
+    guint n;
+
+    if (event->mask & IN_Q_OVERFLOW)
+    {
+        for (n = 0; n < ci->dirs->len; ++n)
+            ((cache_dir_t *) ci->dirs->pdata[n])->indexed = FALSE;
+        return;
+    }
+
+    dir = get_dir (ci, event->wd);
+    if (!dir)
+        return;
+
+    if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED))
+    {
+        if (!(event->mask & IN_IGNORED))
+            inotify_rm_watch (ci->fd, dir->wd);
+        dir->wd = -1;
+        dir->indexed = FALSE;
+    }
+    else if (event->len > 0)
+    {
+        if (event->mask & (IN_CREATE | IN_MOVED_TO))
+            g_hash_table_add (dir->files, g_strdup (event->name));
+        else if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+            g_hash_table_remove (dir->files, event->name);
+    }
+}
+
+void
+cache_index_refresh (cache_index_t *ci)
+{
+    gchar buf[4096]
+        __attribute__ ((aligned (__alignof__ (struct inotify_event))));
+    struct inotify_event *event;
+    ssize_t len;
+    gchar *p;
+    guint n;
+
+    if (ci->fd >= 0)
+    {
+        for (;;)
+        {
+            len = read (ci->fd, buf, sizeof (buf));
+            if (len < 0 && errno == EINTR)
+                continue;
+            if (len <= 0)
+                break;
+            for (p = buf; p < buf + len;
+                    p += sizeof (struct inotify_event) + event->len)
+            {
+                event = (struct inotify_event *) p;
+                handle_event (ci, event);
+            }
+        }
+    }
+
+    /* dirs not watched (or whose watch was lost) need a new scan */
+    for (n = 0; n < ci->dirs->len; ++n)
+    {
+        cache_dir_t *dir = ci->dirs->pdata[n];
+
+        if (dir->wd < 0 || !dir->indexed)
+            scan_dir (ci, dir);
+    }
+}
+
+/* like alpm_pkg_download_size(), a package found in a cachedir has nothing to
+ * download; but a partial download only needs what's left */
+off_t
+cache_index_download_size (cache_index_t *ci, alpm_pkg_t *pkg)
+{
+    const char *filename = alpm_pkg_get_filename (pkg);
+    off_t size = alpm_pkg_get_size (pkg);
+    cache_dir_t *dir;
+    gboolean all_indexed = TRUE;
+    gchar *part;
+    guint n;
+
+    if (!filename)
+        return alpm_pkg_download_size (pkg);
+
+    for (n = 0; n < ci->dirs->len; ++n)
+    {
+        dir = ci->dirs->pdata[n];
+        if (!dir->indexed)
+            all_indexed = FALSE;
+        else if (g_hash_table_contains (dir->files, filename))
+            return 0;
+    }
+
+    part = g_strconcat (filename, PART_EXT, NULL);
+    for (n = 0; n < ci->dirs->len; ++n)
+    {
+        struct stat st;
+        gchar *path;
+        int r;
+
+        dir = ci->dirs->pdata[n];
+        if (!dir->indexed || !g_hash_table_contains (dir->files, part))
+            continue;
+
+        path = g_build_filename (dir->path, part, NULL);
+        r = stat (path, &st);
+        g_free (path);
+        if (r == 0 && S_ISREG (st.st_mode))
+        {
+            g_free (part);
+            return (st.st_size < size) ? size - st.st_size : 0;
+        }
+    }
+    g_free (part);
+
+    /* a dir we couldn't index might still have it, so let ALPM look */
+    if (ci->usedelta || !all_indexed)
+        return alpm_pkg_download_size (pkg);
+    return size;
+}
+
+void
+cache_index_free (cache_index_t *ci)
+{
+    if (ci->fd >= 0)
+        close (ci->fd);
+    g_ptr_array_unref (ci->dirs);
+    free (ci);
+}
@@ -0,0 +1,60 @@
+/**
+ * kalu - Copyright (C) 2012-2018 Olivier Brunel
+ *
+ * cache-index.h
+ * Copyright (C) 2012-2018 Olivier Brunel <jjk@jjacky.com>
+ *
+ * This file is part of kalu.
+ *
+ * kalu is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * kalu is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * kalu. If not, see http://www.gnu.org/licenses/
+ */
+
+#ifndef _KALU_CACHE_INDEX_H
+#define _KALU_CACHE_INDEX_H
+
+/* glib */
+#include <glib-2.0/glib.h>
+
+/* alpm */
+#include <alpm.h>
+#include <alpm_list.h>
+
+/* Index of the files in pacman's cachedirs, kept current using inotify, so the
+ * download size of packages doesn't require stat-ing every cachedir for each
+ * package. Partially downloaded files (.part) are accounted for.
+ * It isn't thread-safe, but only needs to be used from one thread at a time. */
+
+typedef struct _cache_index_t cache_index_t;
+
+cache_index_t *
+cache_index_new (void);
+
+/* (re)indexes cachedirs if different from the ones currently indexed. When
+ * usedelta is set, download sizes of packages not found in cache are left for
+ * ALPM to determine, as a delta might be used */
+void
+cache_index_set_dirs (cache_index_t *ci, alpm_list_t *cachedirs,
+                      gboolean usedelta);
+
+/* applies changes since last time; to be called before a batch of lookups */
+void
+cache_index_refresh (cache_index_t *ci);
+
+off_t
+cache_index_download_size (cache_index_t *ci, alpm_pkg_t *pkg);
+
+void
+cache_index_free (cache_index_t *ci);
+
+#endif /* _KALU_CACHE_INDEX_H */
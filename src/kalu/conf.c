@@ -27,6 +27,9 @@
 #include <string.h>
 #include <glob.h>
 #include <sys/utsname.h> /* uname */
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <errno.h>
 
 #ifndef DISABLE_UPDATER
@@ -56,6 +59,71 @@ typedef struct _siglevel_def_t {
     char *def;
 } siglevel_def_t;
 
+/* snapshot of a parsed pacman.conf, see load_pacman_conf() */
+#define SNAPSHOT_MAGIC      "KALUPCS"
+#define SNAPSHOT_VERSION    2
+
+typedef struct _snap_reader_t {
+    const gchar *data;
+    gsize        len;
+    gsize        pos;
+    gboolean     failed;
+} snap_reader_t;
+
+/* a file/folder that went into parsing pacman.conf, as it was when opened */
+typedef struct _conf_dep_t {
+    char        *path;
+    struct stat  st;
+} conf_dep_t;
+
+/* state of a parse_pacman_conf() run, across included files */
+typedef struct _conf_parse_t {
+    database_t  *cur_db;        /* the db/repo we're currently parsing, if any */
+    alpm_list_t *deps;          /* conf_dep_t of all files/folders used */
+    gboolean     deps_failed;   /* one of them couldn't be stat-ed */
+} conf_parse_t;
+
+/* watched{,-aur}.conf & news.conf get changes appended to them (after a line
+ * JOURNAL_MARKER) and are only rewritten in full once those records outnumber
+ * the actual entries */
+#define JOURNAL_MARKER      "#journal"
+#define JOURNAL_MIN_COMPACT 64
+static guint journal_records[CONF_FILE_NEWS + 1] = { 0 };
+
+/* records path (opened as fd, or -1) as it is now */
+static void
+add_conf_dep (conf_parse_t *parse, const char *path, int fd)
+{
+    conf_dep_t  *dep;
+    alpm_list_t *i;
+
+    FOR_LIST (i, parse->deps)
+    {
+        if (streq (((conf_dep_t *) i->data)->path, path))
+        {
+            return;
+        }
+    }
+
+    dep = new (conf_dep_t, 1);
+    if (((fd >= 0) ? fstat (fd, &dep->st) : stat (path, &dep->st)) < 0)
+    {
+        debug ("config: cannot stat %s", path);
+        parse->deps_failed = TRUE;
+        free (dep);
+        return;
+    }
+    dep->path = strdup (path);
+    parse->deps = alpm_list_add (parse->deps, dep);
+}
+
+static void
+free_conf_dep (conf_dep_t *dep)
+{
+    free (dep->path);
+    free (dep);
+}
+
 /*******************************************************************************
  * The following functions come from pacman's source code. (They might have
  * been modified.)
@@ -221,12 +289,13 @@ process_siglevel (alpm_list_t *values, alpm_siglevel_t *storage,
 #define set_error(fmt, ...)  g_set_error (error, KALU_ERROR, 1, \
     _("Config file %s, line %d: " fmt), file, linenum, __VA_ARGS__);
 /** inspired from pacman's function */
-gboolean
+static gboolean
 parse_pacman_conf (const char       *file,
                    char            **name,
                    int               is_options,
                    int               depth,
                    pacman_config_t **pacconf,
+                   conf_parse_t     *parse,
                    GError          **error)
 {
     FILE       *fp              = NULL;
@@ -242,10 +311,9 @@ parse_pacman_conf (const char       *file,
     {
         *pacconf = new0 (pacman_config_t, 1);
         (*pacconf)->siglevel = ALPM_SIG_USE_DEFAULT;
+        (*pacconf)->parallel_downloads = 1;
     }
     pacman_config_t *pac_conf = *pacconf;
-    /* the db/repo we're currently parsing, if any */
-    static database_t *cur_db = NULL;
 
     debug ("config: attempting to read file %s", file);
     fp = fopen (file, "r");
@@ -257,6 +325,7 @@ parse_pacman_conf (const char       *file,
         success = FALSE;
         goto cleanup;
     }
+    add_conf_dep (parse, file, fileno (fp));
 
     while (fgets (line, PATH_MAX, fp))
     {
@@ -296,10 +365,11 @@ parse_pacman_conf (const char       *file,
             debug ("config: new section '%s'", *name);
             is_options = (strcmp(*name, "options") == 0);
             /* parsed a db/repo? if so we add it */
-            if (cur_db != NULL)
+            if (parse->cur_db != NULL)
             {
-                pac_conf->databases = alpm_list_add (pac_conf->databases, cur_db);
-                cur_db = NULL;
+                pac_conf->databases = alpm_list_add (pac_conf->databases,
+                        parse->cur_db);
+                parse->cur_db = NULL;
             }
             continue;
         }
@@ -331,6 +401,7 @@ parse_pacman_conf (const char       *file,
             glob_t globbuf;
             int globret;
             size_t gindex;
+            gchar *dir;
 
             if (depth >= max_depth - 1)
             {
@@ -347,6 +418,11 @@ parse_pacman_conf (const char       *file,
                 goto cleanup;
             }
 
+            /* folder, so files added/removed are noticed */
+            dir = g_path_get_dirname (value);
+            add_conf_dep (parse, dir, -1);
+            g_free (dir);
+
             /* Ignore include failures... assume non-critical */
             globret = glob (value, GLOB_NOCHECK, NULL, &globbuf);
             switch (globret)
@@ -369,7 +445,7 @@ parse_pacman_conf (const char       *file,
                         debug ("config file %s, line %d: including %s",
                                 file, linenum, globbuf.gl_pathv[gindex]);
                         parse_pacman_conf (globbuf.gl_pathv[gindex], name,
-                                is_options, depth + 1, &pac_conf, error);
+                                is_options, depth + 1, &pac_conf, parse, error);
                     }
                     break;
             }
@@ -508,6 +584,25 @@ parse_pacman_conf (const char       *file,
                     pac_conf->usedelta = ratio;
                     debug ("config: usedelta=%f", ratio);
                 }
+                else if (streq (key, "ParallelDownloads"))
+                {
+                    unsigned long nb;
+                    char *end;
+
+                    errno = 0;
+                    nb = strtoul (value, &end, 10);
+                    if (*value == '\0' || *end != '\0' || errno != 0
+                            || nb < 1 || nb > G_MAXUINT)
+                    {
+                        set_error ("config file %s, line %d: invalid value for ParallelDownloads: %s",
+                                file, linenum, value);
+                        success = FALSE;
+                        goto cleanup;
+                    }
+                    pac_conf->parallel_downloads = (unsigned int) nb;
+                    debug ("config: paralleldownloads=%u",
+                            pac_conf->parallel_downloads);
+                }
                 /* we silently ignore "unrecognized" options, since we don't
                  * parse all of pacman's options anyways... */
             }
@@ -515,10 +610,10 @@ parse_pacman_conf (const char       *file,
         /* ... or in a repo section */
         else
         {
-            if (cur_db == NULL)
+            if (parse->cur_db == NULL)
             {
-                cur_db = new0 (database_t, 1);
-                cur_db->name = strdup (*name);
+                parse->cur_db = new0 (database_t, 1);
+                parse->cur_db->name = strdup (*name);
             }
 
             if (strcmp (key, "Server") == 0)
@@ -529,7 +624,8 @@ parse_pacman_conf (const char       *file,
                     success = FALSE;
                     goto cleanup;
                 }
-                cur_db->servers = alpm_list_add (cur_db->servers,
+                parse->cur_db->servers = alpm_list_add (
+                        parse->cur_db->servers,
                         strdup (value));
             }
             else if (strcmp (key, "SigLevel") == 0)
@@ -539,7 +635,8 @@ parse_pacman_conf (const char       *file,
                 siglevel_def->file = strdup (file);
                 siglevel_def->linenum = linenum;
                 siglevel_def->def = strdup (value);
-                cur_db->siglevel_def = alpm_list_add (cur_db->siglevel_def,
+                parse->cur_db->siglevel_def = alpm_list_add (
+                        parse->cur_db->siglevel_def,
                         siglevel_def);
             }
             else
@@ -555,10 +652,11 @@ parse_pacman_conf (const char       *file,
     if (depth == 0)
     {
         /* parsed a db/repo? if so we add it */
-        if (cur_db != NULL)
+        if (parse->cur_db != NULL)
         {
-            pac_conf->databases = alpm_list_add (pac_conf->databases, cur_db);
-            cur_db = NULL;
+            pac_conf->databases = alpm_list_add (pac_conf->databases,
+                    parse->cur_db);
+            parse->cur_db = NULL;
         }
         /* processing databases siglevel */
         FOR_LIST (i, pac_conf->databases)
@@ -624,6 +722,13 @@ cleanup:
     }
     if (depth == 0)
     {
+        /* on error, so it gets freed along */
+        if (parse->cur_db != NULL)
+        {
+            pac_conf->databases = alpm_list_add (pac_conf->databases,
+                    parse->cur_db);
+            parse->cur_db = NULL;
+        }
         /* section name is for internal processing only */
         if (*name != NULL)
         {
@@ -691,6 +796,410 @@ free_pacman_config (pacman_config_t *pac_conf)
     free (pac_conf);
 }
 
+/******************************************************************************/
+
+static inline void
+snap_put (GString *snap, const void *data, gsize len)
+{
+    g_string_append_len (snap, (const gchar *) data, (gssize) len);
+}
+
+static inline void
+snap_put_u32 (GString *snap, guint32 val)
+{
+    snap_put (snap, &val, sizeof (val));
+}
+
+static inline void
+snap_put_u64 (GString *snap, guint64 val)
+{
+    snap_put (snap, &val, sizeof (val));
+}
+
+static void
+snap_put_str (GString *snap, const char *str)
+{
+    guint32 len;
+
+    if (!str)
+    {
+        snap_put_u32 (snap, G_MAXUINT32);
+        return;
+    }
+    len = (guint32) strlen (str);
+    snap_put_u32 (snap, len);
+    snap_put (snap, str, len);
+}
+
+static void
+snap_put_list (GString *snap, alpm_list_t *list)
+{
+    alpm_list_t *i;
+
+    snap_put_u32 (snap, (guint32) alpm_list_count (list));
+    FOR_LIST (i, list)
+    {
+        snap_put_str (snap, i->data);
+    }
+}
+
+static gboolean
+snap_get (snap_reader_t *r, void *data, gsize len)
+{
+    if (r->failed || r->len - r->pos < len)
+    {
+        r->failed = TRUE;
+        memset (data, 0, len);
+        return FALSE;
+    }
+    memcpy (data, r->data + r->pos, len);
+    r->pos += len;
+    return TRUE;
+}
+
+static guint32
+snap_get_u32 (snap_reader_t *r)
+{
+    guint32 val;
+
+    snap_get (r, &val, sizeof (val));
+    return val;
+}
+
+static guint64
+snap_get_u64 (snap_reader_t *r)
+{
+    guint64 val;
+
+    snap_get (r, &val, sizeof (val));
+    return val;
+}
+
+static char *
+snap_get_str (snap_reader_t *r)
+{
+    char    *str;
+    guint32  len;
+
+    len = snap_get_u32 (r);
+    if (r->failed || len == G_MAXUINT32)
+    {
+        return NULL;
+    }
+    if (r->len - r->pos < len)
+    {
+        r->failed = TRUE;
+        return NULL;
+    }
+    str = strndup (r->data + r->pos, len);
+    r->pos += len;
+    return str;
+}
+
+static alpm_list_t *
+snap_get_list (snap_reader_t *r)
+{
+    alpm_list_t *list = NULL;
+    guint32      nb;
+
+    for (nb = snap_get_u32 (r); nb > 0 && !r->failed; --nb)
+    {
+        list = alpm_list_add (list, snap_get_str (r));
+    }
+    return list;
+}
+
+static void
+snap_put_dep (GString *snap, const char *path, struct stat *st)
+{
+    snap_put_str (snap, path);
+    snap_put_u64 (snap, (guint64) st->st_dev);
+    snap_put_u64 (snap, (guint64) st->st_ino);
+    snap_put_u64 (snap, (guint64) st->st_size);
+    snap_put_u64 (snap, (guint64) st->st_mtim.tv_sec);
+    snap_put_u64 (snap, (guint64) st->st_mtim.tv_nsec);
+}
+
+static gboolean
+snap_check_dep (snap_reader_t *r)
+{
+    struct stat  st;
+    char        *path;
+    gboolean     same;
+
+    path = snap_get_str (r);
+    if (!path)
+    {
+        r->failed = TRUE;
+        return FALSE;
+    }
+    if (stat (path, &st) < 0)
+    {
+        /* still consume the fields, to keep reading the following ones */
+        int n;
+
+        for (n = 0; n < 5; ++n)
+            snap_get_u64 (r);
+        debug ("config: snapshot outdated: cannot stat %s", path);
+        free (path);
+        return FALSE;
+    }
+    same = snap_get_u64 (r) == (guint64) st.st_dev;
+    same = snap_get_u64 (r) == (guint64) st.st_ino && same;
+    same = snap_get_u64 (r) == (guint64) st.st_size && same;
+    same = snap_get_u64 (r) == (guint64) st.st_mtim.tv_sec && same;
+    same = snap_get_u64 (r) == (guint64) st.st_mtim.tv_nsec && same;
+    if (!same)
+    {
+        debug ("config: snapshot outdated: %s changed", path);
+    }
+    free (path);
+    return same && !r->failed;
+}
+
+static gchar *
+get_snapshot_file (const char *file)
+{
+    gchar *sum;
+    gchar *snapshot;
+
+    sum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, file, -1);
+    snapshot = g_strdup_printf ("%s/kalu/pacman-conf-%s", g_get_user_cache_dir (), sum);
+    g_free (sum);
+    return snapshot;
+}
+
+static inline gboolean
+same_stat (struct stat *st1, struct stat *st2)
+{
+    return st1->st_dev == st2->st_dev
+        && st1->st_ino == st2->st_ino
+        && st1->st_size == st2->st_size
+        && st1->st_mtim.tv_sec == st2->st_mtim.tv_sec
+        && st1->st_mtim.tv_nsec == st2->st_mtim.tv_nsec;
+}
+
+static void
+save_snapshot (const char *snapshot, pacman_config_t *pac_conf,
+               conf_parse_t *parse)
+{
+    GString      *snap;
+    struct utsname un;
+    struct stat   st;
+    alpm_list_t  *i;
+    gchar        *path;
+    double        usedelta = pac_conf->usedelta;
+
+    if (parse->deps_failed)
+    {
+        debug ("config: not saving snapshot");
+        return;
+    }
+    /* make sure nothing changed while we were parsing, else what we parsed
+     * might not match what we'd record */
+    FOR_LIST (i, parse->deps)
+    {
+        conf_dep_t *dep = i->data;
+
+        if (stat (dep->path, &st) < 0 || !same_stat (&st, &dep->st))
+        {
+            debug ("config: %s changed while parsing, not saving snapshot",
+                    dep->path);
+            return;
+        }
+    }
+
+    snap = g_string_sized_new (4096);
+    snap_put (snap, SNAPSHOT_MAGIC, sizeof (SNAPSHOT_MAGIC));
+    snap_put_u32 (snap, SNAPSHOT_VERSION);
+    /* Architecture might be "auto" */
+    uname (&un);
+    snap_put_str (snap, un.machine);
+
+    snap_put_u32 (snap, (guint32) alpm_list_count (parse->deps));
+    FOR_LIST (i, parse->deps)
+    {
+        conf_dep_t *dep = i->data;
+
+        snap_put_dep (snap, dep->path, &dep->st);
+    }
+
+    snap_put_str (snap, pac_conf->rootdir);
+    snap_put_str (snap, pac_conf->dbpath);
+    snap_put_str (snap, pac_conf->logfile);
+    snap_put_str (snap, pac_conf->gpgdir);
+    snap_put_list (snap, pac_conf->hookdirs);
+    snap_put_list (snap, pac_conf->cachedirs);
+    snap_put_u32 (snap, (guint32) pac_conf->siglevel);
+    snap_put_str (snap, pac_conf->arch);
+    snap_put_u32 (snap, (guint32) pac_conf->checkspace);
+    snap_put_u32 (snap, (guint32) pac_conf->usesyslog);
+    snap_put (snap, &usedelta, sizeof (usedelta));
+    snap_put_u32 (snap, pac_conf->parallel_downloads);
+    snap_put_list (snap, pac_conf->ignorepkgs);
+    snap_put_list (snap, pac_conf->ignoregroups);
+    snap_put_list (snap, pac_conf->noupgrades);
+    snap_put_list (snap, pac_conf->noextracts);
+    snap_put_list (snap, pac_conf->syncfirst);
+    snap_put_u32 (snap, pac_conf->verbosepkglists);
+
+    snap_put_u32 (snap, (guint32) alpm_list_count (pac_conf->databases));
+    FOR_LIST (i, pac_conf->databases)
+    {
+        database_t *db = i->data;
+
+        snap_put_str (snap, db->name);
+        snap_put_u32 (snap, (guint32) db->siglevel);
+        snap_put_list (snap, db->servers);
+    }
+
+    path = strdup (snapshot);
+    if (!ensure_path (path)
+            || !g_file_set_contents (snapshot, snap->str, (gssize) snap->len, NULL))
+    {
+        debug ("config: unable to save snapshot %s", snapshot);
+    }
+    else
+    {
+        debug ("config: saved snapshot %s", snapshot);
+    }
+    free (path);
+    g_string_free (snap, TRUE);
+}
+
+static gboolean
+load_snapshot (const char *snapshot, pacman_config_t **pacconf)
+{
+    snap_reader_t    r;
+    pacman_config_t *pac_conf;
+    struct utsname   un;
+    gchar           *contents;
+    gchar           *s;
+    guint32          nb;
+
+    if (!g_file_get_contents (snapshot, &contents, &r.len, NULL))
+    {
+        return FALSE;
+    }
+    r.data = contents;
+    r.pos = 0;
+    r.failed = FALSE;
+
+    if (r.len < sizeof (SNAPSHOT_MAGIC)
+            || memcmp (r.data, SNAPSHOT_MAGIC, sizeof (SNAPSHOT_MAGIC)) != 0)
+    {
+        g_free (contents);
+        return FALSE;
+    }
+    r.pos = sizeof (SNAPSHOT_MAGIC);
+    if (snap_get_u32 (&r) != SNAPSHOT_VERSION)
+    {
+        g_free (contents);
+        return FALSE;
+    }
+    uname (&un);
+    s = snap_get_str (&r);
+    if (!streq (s, un.machine))
+    {
+        free (s);
+        g_free (contents);
+        return FALSE;
+    }
+    free (s);
+
+    /* is everything that went into it unchanged? */
+    for (nb = snap_get_u32 (&r); nb > 0; --nb)
+    {
+        if (!snap_check_dep (&r))
+        {
+            g_free (contents);
+            return FALSE;
+        }
+    }
+
+    pac_conf = new0 (pacman_config_t, 1);
+    pac_conf->rootdir = snap_get_str (&r);
+    pac_conf->dbpath = snap_get_str (&r);
+    pac_conf->logfile = snap_get_str (&r);
+    pac_conf->gpgdir = snap_get_str (&r);
+    pac_conf->hookdirs = snap_get_list (&r);
+    pac_conf->cachedirs = snap_get_list (&r);
+    pac_conf->siglevel = (alpm_siglevel_t) snap_get_u32 (&r);
+    pac_conf->arch = snap_get_str (&r);
+    pac_conf->checkspace = (int) snap_get_u32 (&r);
+    pac_conf->usesyslog = (int) snap_get_u32 (&r);
+    snap_get (&r, &pac_conf->usedelta, sizeof (pac_conf->usedelta));
+    pac_conf->parallel_downloads = snap_get_u32 (&r);
+    pac_conf->ignorepkgs = snap_get_list (&r);
+    pac_conf->ignoregroups = snap_get_list (&r);
+    pac_conf->noupgrades = snap_get_list (&r);
+    pac_conf->noextracts = snap_get_list (&r);
+    pac_conf->syncfirst = snap_get_list (&r);
+    pac_conf->verbosepkglists = (unsigned short) snap_get_u32 (&r);
+
+    for (nb = snap_get_u32 (&r); nb > 0 && !r.failed; --nb)
+    {
+        database_t *db = new0 (database_t, 1);
+
+        db->name = snap_get_str (&r);
+        db->siglevel = (alpm_siglevel_t) snap_get_u32 (&r);
+        db->servers = snap_get_list (&r);
+        pac_conf->databases = alpm_list_add (pac_conf->databases, db);
+    }
+
+    g_free (contents);
+    if (r.failed || r.pos != r.len)
+    {
+        debug ("config: invalid snapshot %s", snapshot);
+        free_pacman_config (pac_conf);
+        return FALSE;
+    }
+
+    *pacconf = pac_conf;
+    return TRUE;
+}
+
+/* parse pacman.conf file, unless a snapshot of its parsing is found with none
+ * of the files/folders that went into it having changed (same dev/inode,
+ * size & mtime) since, in which case it is used instead */
+gboolean
+load_pacman_conf (const char       *file,
+                  pacman_config_t **pac_conf,
+                  GError          **error)
+{
+    GError       *local_err = NULL;
+    conf_parse_t  parse;
+    gchar        *snapshot;
+    gchar        *section = NULL;
+    gboolean      success;
+
+    snapshot = get_snapshot_file (file);
+    if (load_snapshot (snapshot, pac_conf))
+    {
+        debug ("config: using snapshot %s for %s", snapshot, file);
+        g_free (snapshot);
+        return TRUE;
+    }
+
+    zero (parse);
+    success = parse_pacman_conf (file, &section, 0, 0, pac_conf, &parse,
+            &local_err);
+
+    if (success && !local_err)
+    {
+        save_snapshot (snapshot, *pac_conf, &parse);
+    }
+    if (local_err)
+    {
+        g_propagate_error (error, local_err);
+    }
+
+    alpm_list_free_inner (parse.deps, (alpm_list_fn_free) free_conf_dep);
+    alpm_list_free (parse.deps);
+    g_free (snapshot);
+    return success;
+}
+
 static void
 setstringoption (char *value, const char *option, char **cfg, gboolean esc)
 {
@@ -742,9 +1251,11 @@ parse_config_file (const char       *file,
 {
     char       *data            = NULL;
     char       *line;
-    gchar     **lines           = NULL;
-    gchar     **l;
+    char       *next;
     int         linenum         = 0;
+    gboolean    in_journal      = FALSE;
+    guint       nb_records      = 0;
+    GHashTable *entries         = NULL;
     char       *section         = NULL;
     int         success         = TRUE;
     GString    *err_msg         = NULL;
@@ -769,14 +1280,29 @@ parse_config_file (const char       *file,
         goto cleanup;
     }
 
-    lines = g_strsplit (data, "\n", 0);
-    g_free (data);
-    for (l = lines; *l; ++l)
+    /* watched packages, to apply journal records */
+    if (conf_file == CONF_FILE_WATCHED || conf_file == CONF_FILE_WATCHED_AUR)
+    {
+        entries = g_hash_table_new (g_str_hash, g_str_equal);
+    }
+
+    for (line = data; line; line = next)
     {
         char *key, *value, *ptr;
         size_t line_len;
+        alpm_list_t *node;
 
-        line = *l;
+        next = strchr (line, '\n');
+        if (next)
+        {
+            *next++ = '\0';
+        }
+        else if (in_journal && *line != '\0')
+        {
+            /* record only partially written, e.g. crash while appending */
+            debug ("config: ignoring incomplete journal record: %s", line);
+            break;
+        }
         ++linenum;
         strtrim (line);
         line_len = strlen (line);
@@ -784,6 +1310,10 @@ parse_config_file (const char       *file,
         /* ignore whole line and end of line comments */
         if (line_len == 0 || line[0] == '#')
         {
+            if (streq (line, JOURNAL_MARKER))
+            {
+                in_journal = TRUE;
+            }
             continue;
         }
         if ((ptr = strchr (line, '#')))
@@ -823,6 +1353,10 @@ parse_config_file (const char       *file,
             add_error ("%s", _("syntax error: missing key"));
             continue;
         }
+        if (in_journal)
+        {
+            ++nb_records;
+        }
 
         /* kalu.conf*/
         if (conf_file == CONF_FILE_KALU)
@@ -1202,6 +1736,27 @@ parse_config_file (const char       *file,
                         continue;
                     }
                 }
+                else if (streq (key, "SharedDbCache"))
+                {
+                    setstringoption (value, "shared-db-cache",
+                            &(config->shared_dbs_dir), TRUE);
+                }
+                else if (streq (key, "SharedDbCacheMaxAge"))
+                {
+                    config->shared_dbs_max_age = atoi (value);
+                    if (config->shared_dbs_max_age > 0)
+                    {
+                        config->shared_dbs_max_age *= 60; /* minutes into seconds */
+                    }
+                    else
+                    {
+                        add_error ("invalid value for %s: %s", key, value);
+                        config->shared_dbs_max_age = 300; /* 5 minutes */
+                        continue;
+                    }
+                    debug ("config: shared db cache max age: %d",
+                            config->shared_dbs_max_age);
+                }
 #ifndef DISABLE_UPDATER
                 else if (streq (key, "ColorUnimportant")
                         || streq (key, "ColorInfo")
@@ -1246,6 +1801,22 @@ parse_config_file (const char       *file,
                         continue;
                     }
                 }
+                else if (streq (key, "UpdaterResident"))
+                {
+                    char *end;
+                    long minutes;
+
+                    minutes = strtol (value, &end, 10);
+                    if (*value == '\0' || *end != '\0' || minutes < 0
+                            || minutes > 24 * 60)
+                    {
+                        add_error ("invalid value for %s: %s", key, value);
+                        continue;
+                    }
+                    config->updater_resident = (int) minutes * 60;
+                    debug ("config: updater resident for %ds",
+                            config->updater_resident);
+                }
 #endif
                 else
                 {
@@ -1335,32 +1906,61 @@ parse_config_file (const char       *file,
         else if (conf_file == CONF_FILE_WATCHED
                 || conf_file == CONF_FILE_WATCHED_AUR)
         {
-            if (value == NULL)
+            alpm_list_t **list;
+            watched_package_t *w_pkg;
+
+            if (conf_file == CONF_FILE_WATCHED)
             {
-                add_error ("watched package %s: version number missing", key);
-                continue;
+                list = &(config->watched);
             }
-            else
+            else /* if (conf_file == CONF_FILE_WATCHED_AUR) */
             {
-                alpm_list_t **list;
-                if (conf_file == CONF_FILE_WATCHED)
-                {
-                    list = &(config->watched);
-                }
-                else /* if (conf_file == CONF_FILE_WATCHED_AUR) */
+                list = &(config->watched_aur);
+            }
+
+            /* journal: package no longer watched */
+            if (key[0] == '-' && value == NULL)
+            {
+                node = g_hash_table_lookup (entries, key + 1);
+                if (node)
                 {
-                    list = &(config->watched_aur);
+                    g_hash_table_remove (entries, key + 1);
+                    *list = alpm_list_remove_item (*list, node);
+                    debug ("config: watched%s packages: removed %s",
+                            (conf_file == CONF_FILE_WATCHED) ? "" : " AUR",
+                            key + 1);
+                    free_watched_package (node->data);
+                    free (node);
                 }
+                continue;
+            }
+            else if (value == NULL)
+            {
+                add_error ("watched package %s: version number missing", key);
+                continue;
+            }
 
-                watched_package_t *w_pkg;
-                w_pkg = new0 (watched_package_t, 1);
-                w_pkg->name = strdup (key);
+            /* journal: version updated */
+            node = g_hash_table_lookup (entries, key);
+            if (node)
+            {
+                w_pkg = node->data;
+                free (w_pkg->version);
                 w_pkg->version = strdup (value);
-                *list = alpm_list_add (*list, w_pkg);
-                debug ("config: watched%s packages: added %s %s",
+                debug ("config: watched%s packages: updated %s %s",
                         (conf_file == CONF_FILE_WATCHED) ? "" : " AUR",
                         w_pkg->name, w_pkg->version);
+                continue;
             }
+
+            w_pkg = new0 (watched_package_t, 1);
+            w_pkg->name = strdup (key);
+            w_pkg->version = strdup (value);
+            *list = alpm_list_add (*list, w_pkg);
+            g_hash_table_insert (entries, w_pkg->name, alpm_list_last (*list));
+            debug ("config: watched%s packages: added %s %s",
+                    (conf_file == CONF_FILE_WATCHED) ? "" : " AUR",
+                    w_pkg->name, w_pkg->version);
         }
         /* news.conf */
         else if (conf_file == CONF_FILE_NEWS)
@@ -1372,17 +1972,29 @@ parse_config_file (const char       *file,
             }
             else if (streq ("Last", key))
             {
+                free (config->news_last);
                 config->news_last = strdup (value);
                 debug ("config: news_last: %s", value);
             }
             else if (streq ("Read", key))
             {
-                config->news_read = alpm_list_add (config->news_read,
-                        strdup (value));
+                g_hash_table_add (config->news_read, strdup (value));
                 debug ("config: news_read: added %s", value);
             }
+            /* journal: news no longer in the feed */
+            else if (streq ("Unread", key))
+            {
+                if (g_hash_table_remove (config->news_read, value))
+                {
+                    debug ("config: news_read: removed %s", value);
+                }
+            }
         }
     }
+    if (conf_file != CONF_FILE_KALU)
+    {
+        journal_records[conf_file] = nb_records;
+    }
 
 cleanup:
     /* ensure templates sources are valid */
@@ -1406,7 +2018,11 @@ cleanup:
                         fld, tpl, sce, f->source);
         }
 
-    g_strfreev (lines);
+    g_free (data);
+    if (entries)
+    {
+        g_hash_table_destroy (entries);
+    }
     free (section);
     if (config->action == UPGRADE_ACTION_CMDLINE && config->cmdline == NULL)
     {
@@ -1429,3 +2045,334 @@ cleanup:
     return success;
 }
 #undef add_error
+
+static gchar *
+get_journaled_file (conf_file_t conf_file)
+{
+    const char *name;
+
+    if (conf_file == CONF_FILE_WATCHED)
+    {
+        name = "watched.conf";
+    }
+    else if (conf_file == CONF_FILE_WATCHED_AUR)
+    {
+        name = "watched-aur.conf";
+    }
+    else /* if (conf_file == CONF_FILE_NEWS) */
+    {
+        name = "news.conf";
+    }
+    return g_strdup_printf ("%s/kalu/%s", g_get_user_config_dir (), name);
+}
+
+static inline gboolean
+needs_compaction (conf_file_t conf_file, guint nb_records, guint nb_entries)
+{
+    return journal_records[conf_file] + nb_records
+        > MAX (JOURNAL_MIN_COMPACT, nb_entries);
+}
+
+/* replaces the file with data (i.e. all entries), atomically */
+static gboolean
+write_journaled (conf_file_t conf_file, GString *data, GError **error)
+{
+    GError *local_err = NULL;
+    gchar  *file;
+
+    file = get_journaled_file (conf_file);
+    if (!ensure_path (file))
+    {
+        g_set_error (error, KALU_ERROR, 1,
+                _("Unable to create folder for %s"), file);
+        g_free (file);
+        return FALSE;
+    }
+    if (!g_file_set_contents (file, data->str, (gssize) data->len, &local_err))
+    {
+        g_propagate_error (error, local_err);
+        g_free (file);
+        return FALSE;
+    }
+
+    debug ("config: compacted %s", file);
+    journal_records[conf_file] = 0;
+    g_free (file);
+    return TRUE;
+}
+
+/* whether the line after last (i.e. the incomplete last line) is part of the
+ * journal, that is the marker line comes before it */
+static gboolean
+in_journal (const gchar *content, const gchar *last)
+{
+    const gchar *s;
+
+    /* last being a newline, there's always one from s up to it */
+    for (s = content; last && s < last; s = strchr (s, '\n') + 1)
+        if (streqn (s, JOURNAL_MARKER "\n", strlen (JOURNAL_MARKER) + 1))
+            return TRUE;
+    return FALSE;
+}
+
+/* appends nb_records (i.e. changes) to the file's journal. If they couldn't
+ * all be written the file is truncated back, so a record is never applied
+ * partially (and if we crash, the incomplete line will be ignored, then
+ * dropped on the next append) */
+static gboolean
+append_journaled (conf_file_t     conf_file,
+                  GString        *records,
+                  guint           nb_records,
+                  GError        **error)
+{
+    GString *data;
+    gchar   *file;
+    gchar    c;
+    off_t    size;
+    gsize    done = 0;
+    int      fd;
+
+    file = get_journaled_file (conf_file);
+    if (!ensure_path (file))
+    {
+        g_set_error (error, KALU_ERROR, 1,
+                _("Unable to create folder for %s"), file);
+        g_free (file);
+        return FALSE;
+    }
+
+    fd = open (file, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0 || (size = lseek (fd, 0, SEEK_END)) < 0)
+    {
+        g_set_error (error, KALU_ERROR, 1, _("Unable to open %s: %s"),
+                file, strerror (errno));
+        if (fd >= 0)
+        {
+            close (fd);
+        }
+        g_free (file);
+        return FALSE;
+    }
+
+    data = g_string_sized_new (records->len + 16);
+    if (size > 0 && (pread (fd, &c, 1, size - 1) != 1 || c != '\n'))
+    {
+        gchar *content = NULL;
+        gchar *last;
+        gsize  len;
+
+        g_file_get_contents (file, &content, &len, NULL);
+        last = (content) ? strrchr (content, '\n') : NULL;
+        if (content && in_journal (content, last))
+        {
+            /* torn record (crash while appending), which parsing ignored: drop
+             * it, as completing the line would make it valid */
+            size = (last) ? (off_t) (last - content + 1) : 0;
+            debug ("config: dropping incomplete journal record in %s", file);
+            if (ftruncate (fd, size) < 0)
+            {
+                g_set_error (error, KALU_ERROR, 1,
+                        _("Unable to truncate %s: %s"), file, strerror (errno));
+                g_free (content);
+                g_string_free (data, TRUE);
+                close (fd);
+                g_free (file);
+                return FALSE;
+            }
+        }
+        else
+        {
+            /* file was edited manually */
+            g_string_append_c (data, '\n');
+        }
+        g_free (content);
+    }
+    if (journal_records[conf_file] == 0)
+    {
+        g_string_append (data, JOURNAL_MARKER "\n");
+    }
+    g_string_append_len (data, records->str, (gssize) records->len);
+
+    while (done < data->len)
+    {
+        ssize_t r = write (fd, data->str + done, data->len - done);
+        if (r < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+        done += (gsize) r;
+    }
+    if (done < data->len || fsync (fd) < 0)
+    {
+        g_set_error (error, KALU_ERROR, 1, _("Unable to write to %s: %s"),
+                file, strerror (errno));
+        if (ftruncate (fd, size) < 0)
+        {
+            debug ("config: failed to truncate %s back: %s",
+                    file, strerror (errno));
+        }
+        close (fd);
+        g_string_free (data, TRUE);
+        g_free (file);
+        return FALSE;
+    }
+
+    debug ("config: appended %u records to %s", nb_records, file);
+    journal_records[conf_file] += nb_records;
+    close (fd);
+    g_string_free (data, TRUE);
+    g_free (file);
+    return TRUE;
+}
+
+/* saves new_watched as the list of watched (AUR) packages, either by appending
+ * what changed from the current list or, when due, rewriting the file */
+gboolean
+save_watched_conf (conf_file_t       conf_file,
+                   alpm_list_t      *new_watched,
+                   GError          **error)
+{
+    alpm_list_t *old_watched;
+    alpm_list_t *i;
+    GHashTable  *old;
+    GHashTable  *new;
+    GString     *data;
+    guint        nb = 0;
+    gboolean     success;
+
+    if (conf_file == CONF_FILE_WATCHED)
+    {
+        old_watched = config->watched;
+    }
+    else /* if (conf_file == CONF_FILE_WATCHED_AUR) */
+    {
+        old_watched = config->watched_aur;
+    }
+
+    old = g_hash_table_new (g_str_hash, g_str_equal);
+    FOR_LIST (i, old_watched)
+    {
+        watched_package_t *w_pkg = i->data;
+        g_hash_table_insert (old, w_pkg->name, w_pkg->version);
+    }
+    new = g_hash_table_new (g_str_hash, g_str_equal);
+    FOR_LIST (i, new_watched)
+    {
+        watched_package_t *w_pkg = i->data;
+        g_hash_table_insert (new, w_pkg->name, w_pkg->version);
+    }
+
+    data = g_string_sized_new (1024);
+    FOR_LIST (i, new_watched)
+    {
+        watched_package_t *w_pkg = i->data;
+        if (!streq (w_pkg->version, g_hash_table_lookup (old, w_pkg->name)))
+        {
+            g_string_append_printf (data, "%s=%s\n", w_pkg->name, w_pkg->version);
+            ++nb;
+        }
+    }
+    FOR_LIST (i, old_watched)
+    {
+        watched_package_t *w_pkg = i->data;
+        if (!g_hash_table_lookup (new, w_pkg->name))
+        {
+            g_string_append_printf (data, "-%s\n", w_pkg->name);
+            ++nb;
+        }
+    }
+
+    if (nb == 0)
+    {
+        success = TRUE;
+    }
+    else if (needs_compaction (conf_file, nb, alpm_list_count (new_watched)))
+    {
+        g_string_truncate (data, 0);
+        FOR_LIST (i, new_watched)
+        {
+            watched_package_t *w_pkg = i->data;
+            g_string_append_printf (data, "%s=%s\n", w_pkg->name, w_pkg->version);
+        }
+        success = write_journaled (conf_file, data, error);
+    }
+    else
+    {
+        success = append_journaled (conf_file, data, nb, error);
+    }
+
+    g_string_free (data, TRUE);
+    g_hash_table_destroy (old);
+    g_hash_table_destroy (new);
+    return success;
+}
+
+/* saves news_last & news_read (set of titles) as read news, either by
+ * appending what changed from the current data or, when due, rewriting the
+ * file */
+gboolean
+save_news_conf (const char       *news_last,
+                GHashTable       *news_read,
+                GError          **error)
+{
+    GHashTableIter  iter;
+    gpointer        title;
+    GString        *data;
+    guint           nb = 0;
+    gboolean        success;
+
+    data = g_string_sized_new (1024);
+    if (news_last && !streq (news_last, config->news_last))
+    {
+        g_string_append_printf (data, "Last=%s\n", news_last);
+        ++nb;
+    }
+    g_hash_table_iter_init (&iter, news_read);
+    while (g_hash_table_iter_next (&iter, &title, NULL))
+    {
+        if (!g_hash_table_contains (config->news_read, title))
+        {
+            g_string_append_printf (data, "Read=%s\n", (const char *) title);
+            ++nb;
+        }
+    }
+    g_hash_table_iter_init (&iter, config->news_read);
+    while (g_hash_table_iter_next (&iter, &title, NULL))
+    {
+        if (!g_hash_table_contains (news_read, title))
+        {
+            g_string_append_printf (data, "Unread=%s\n", (const char *) title);
+            ++nb;
+        }
+    }
+
+    if (nb == 0)
+    {
+        success = TRUE;
+    }
+    else if (needs_compaction (CONF_FILE_NEWS, nb, g_hash_table_size (news_read)))
+    {
+        g_string_truncate (data, 0);
+        if (news_last)
+        {
+            g_string_append_printf (data, "Last=%s\n", news_last);
+        }
+        g_hash_table_iter_init (&iter, news_read);
+        while (g_hash_table_iter_next (&iter, &title, NULL))
+        {
+            g_string_append_printf (data, "Read=%s\n", (const char *) title);
+        }
+        success = write_journaled (CONF_FILE_NEWS, data, error);
+    }
+    else
+    {
+        success = append_journaled (CONF_FILE_NEWS, data, nb, error);
+    }
+
+    g_string_free (data, TRUE);
+    return success;
+}
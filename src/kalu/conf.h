@@ -60,6 +60,7 @@ typedef struct _pacman_config_t {
     int              checkspace;
     int              usesyslog;
     double           usedelta;
+    unsigned int     parallel_downloads;
     alpm_list_t     *ignorepkgs;
     alpm_list_t     *ignoregroups;
     alpm_list_t     *noupgrades;
@@ -74,12 +75,9 @@ typedef struct _pacman_config_t {
 } pacman_config_t;
 
 gboolean
-parse_pacman_conf (const char       *file,
-                   char            **name,
-                   int               is_options,
-                   int               depth,
-                   pacman_config_t **pac_conf,
-                   GError          **error);
+load_pacman_conf (const char       *file,
+                  pacman_config_t **pac_conf,
+                  GError          **error);
 
 void
 free_pacman_config (pacman_config_t *pac_conf);
@@ -89,5 +87,15 @@ parse_config_file (const char       *file,
                    conf_file_t       conf_file,
                    GError          **error);
 
+gboolean
+save_watched_conf (conf_file_t       conf_file,
+                   alpm_list_t      *new_watched,
+                   GError          **error);
+
+gboolean
+save_news_conf (const char       *news_last,
+                GHashTable       *news_read,
+                GError          **error);
+
 
 #endif /* _KALU_CONFIG_H */
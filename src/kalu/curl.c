@@ -34,9 +34,12 @@
 
 /* struct to hold data downloaded via curl */
 typedef struct _string_t {
-    char   *content;
-    size_t  len;
-    size_t  alloc;
+    char            *content;
+    size_t           len;
+    size_t           alloc;
+    curl_stream_fn   stream_fn;
+    gpointer         stream_data;
+    gboolean         stopped;
 } string_t;
 
 static size_t
@@ -44,6 +47,18 @@ curl_write (void *content, size_t size, size_t nmemb, string_t *data)
 {
     size_t total = size * nmemb;
 
+    if (data->stream_fn)
+    {
+        data->len += total;
+        /* abort the transfer if we don't need more */
+        if (!data->stream_fn (content, total, data->stream_data))
+        {
+            data->stopped = TRUE;
+            return 0;
+        }
+        return total;
+    }
+
     /* alloc memory if needed */
     if (data->len + total >= data->alloc)
     {
@@ -60,6 +75,18 @@ curl_write (void *content, size_t size, size_t nmemb, string_t *data)
 
 char *
 curl_download (const char *url, GError **error)
+{
+    return curl_download_stream (url, NULL, NULL, error);
+}
+
+/* stream_fn will be called with every chunk of data as it is downloaded, and
+ * can stop the download by returning FALSE (which isn't an error). Nothing is
+ * kept then, so it returns NULL; on error, error is set */
+char *
+curl_download_stream (const char      *url,
+                      curl_stream_fn   stream_fn,
+                      gpointer         stream_data,
+                      GError         **error)
 {
     CURL *curl;
     string_t data;
@@ -67,6 +94,8 @@ curl_download (const char *url, GError **error)
 
     debug ("downloading %s", url);
     zero (data);
+    data.stream_fn = stream_fn;
+    data.stream_data = stream_data;
 
     curl = curl_easy_init();
     if (!curl)
@@ -93,7 +122,7 @@ curl_download (const char *url, GError **error)
         curl_easy_setopt (curl, CURLOPT_IPRESOLVE, CURL_IPRESOLVE_V6);
     }
 
-    if (curl_easy_perform (curl) != 0)
+    if (curl_easy_perform (curl) != 0 && !data.stopped)
     {
         curl_easy_cleanup (curl);
         if (data.content != NULL)
@@ -104,8 +133,17 @@ curl_download (const char *url, GError **error)
         return NULL;
     }
     curl_easy_cleanup (curl);
-    debug ("downloaded %d bytes", data.len);
+    debug ("downloaded %d bytes%s", data.len,
+            (data.stopped) ? " (stopped early)" : "");
 
+    if (stream_fn)
+    {
+        return NULL;
+    }
+    if (data.content == NULL)
+    {
+        data.content = new (char, 1);
+    }
     /* content is not NULL-terminated yet */
     data.content[data.len] = '\0';
 
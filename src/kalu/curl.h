@@ -26,7 +26,16 @@
 /* glib */
 #include <glib-2.0/glib.h>
 
+/* return FALSE to stop the download */
+typedef gboolean (*curl_stream_fn) (const char *chunk, size_t len, gpointer data);
+
 char *
 curl_download (const char *url, GError **error);
 
+char *
+curl_download_stream (const char      *url,
+                      curl_stream_fn   stream_fn,
+                      gpointer         stream_data,
+                      GError         **error);
+
 #endif /* _KALU_CURL_H */
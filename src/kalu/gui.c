@@ -71,16 +71,9 @@ free_notif (notif_t *notif)
 
     free (notif->summary);
     free (notif->text);
-    if (notif->type == CHECK_NEWS || notif->type == CHECK_AUR)
-    {
-        /* CHECK_NEWS has xml_news; CHECK_AUR has cmdline w/ $PACKAGES replaced */
-        free (notif->data);
-    }
-    else
-    {
-        /* CHECK_UPGRADES, CHECK_WATCHED & CHECK_WATCHED_AUR all use packages */
-        FREE_PACKAGE_LIST (notif->data);
-    }
+    /* CHECK_AUR has cmdline w/ $PACKAGES replaced */
+    free (notif->data);
+    free_packages (notif->packages);
     free (notif);
 }
 
@@ -88,16 +81,26 @@ void
 show_notif (notif_t *notif)
 {
     NotifyNotification *notification;
+    gchar *summary = notif->summary;
+    gchar *text = notif->text;
 
-    debug ("showing notif: %s\n%s\n--- EOF ---", notif->summary, notif->text);
-    notification = new_notification (notif->summary, notif->text);
+    if (!summary)
+        expand_notif (notif->type, notif->packages->pkgs, notif->packages->nb,
+                &summary, &text);
+    debug ("showing notif: %s\n%s\n--- EOF ---", summary, text);
+    notification = new_notification (summary, text);
+    if (summary != notif->summary)
+    {
+        free (summary);
+        free (text);
+    }
     if (config->notif_buttons)
     {
         if (notif->type & CHECK_UPGRADES)
         {
-            if (!notif->data)
+            if (!notif->packages)
             {
-                /* no data in this case means this is an error message about a
+                /* no packages in this case means this is an error message about a
                  * conflict, in which case we still add the "Update system"
                  * button/action */
 #ifndef DISABLE_UPDATER
@@ -109,7 +112,7 @@ show_notif (notif_t *notif)
 #endif
             }
             else if (config->check_pacman_conflict
-                    && is_pacman_conflicting ((alpm_list_t *) notif->data))
+                    && is_pacman_conflicting (notif->packages))
             {
                 notify_notification_add_action (notification, "do_conflict_warn",
                         _c("notif-button", "Possible pacman/kalu conflict..."),
@@ -124,20 +127,22 @@ show_notif (notif_t *notif)
                         NULL, NULL);
             }
         }
-        else if (!notif->data)
+        else if (!notif->packages)
         {
-            /* no data means the notification was modified afterwards, as
+            /* no packages means the notification was modified afterwards, as
              * news/packages have been marked read. No more data/action button,
              * just a simple notification (where text explains to re-do checks
              * to be up to date) */
         }
         else if (notif->type & CHECK_AUR)
         {
-            notify_notification_add_action (notification, "do_updates_aur",
-                    _c("notif-button", "Update AUR packages..."),
-                    (NotifyActionCallback) action_upgrade,
-                    notif->data,
-                    NULL);
+            /* without cmdline_aur there's nothing to run */
+            if (notif->data)
+                notify_notification_add_action (notification, "do_updates_aur",
+                        _c("notif-button", "Update AUR packages..."),
+                        (NotifyActionCallback) action_upgrade,
+                        notif->data,
+                        NULL);
         }
         else if (notif->type & CHECK_WATCHED)
         {
@@ -338,9 +343,9 @@ action_watched (NotifyNotification *notification, char *action _UNUSED_,
     notif_t *notif)
 {
     notify_notification_close (notification, NULL);
-    if (notif->data)
+    if (notif->packages)
     {
-        watched_update ((alpm_list_t *) notif->data, FALSE);
+        watched_update (notif->packages, FALSE);
     }
     else
     {
@@ -356,9 +361,9 @@ action_watched_aur (NotifyNotification *notification, char *action _UNUSED_,
     notif_t *notif)
 {
     notify_notification_close (notification, NULL);
-    if (notif->data)
+    if (notif->packages)
     {
-        watched_update ((alpm_list_t *) notif->data, TRUE);
+        watched_update (notif->packages, TRUE);
     }
     else
     {
@@ -371,26 +376,16 @@ action_watched_aur (NotifyNotification *notification, char *action _UNUSED_,
 
 void
 action_news (NotifyNotification *notification, char *action _UNUSED_,
-    notif_t *notif)
+    notif_t *notif _UNUSED_)
 {
     GError *error = NULL;
 
     notify_notification_close (notification, NULL);
-    if (notif->data)
-    {
-        set_kalpm_busy (TRUE);
-        if (!news_show ((gchar *) notif->data, TRUE, &error))
-        {
-            show_error (_("Unable to show the news"), error->message, NULL);
-            g_clear_error (&error);
-        }
-    }
-    else
+    set_kalpm_busy (TRUE);
+    if (!news_show (TRUE, &error))
     {
-        show_error (_("Unable to show unread news"),
-                _("Read news have changed, "
-                    "you need to run the checks again to be up-to-date."),
-                NULL);
+        show_error (_("Unable to show the news"), error->message, NULL);
+        g_clear_error (&error);
     }
 }
 
@@ -401,16 +396,16 @@ notification_closed_cb (NotifyNotification *notification, gpointer data _UNUSED_
 }
 
 gboolean
-is_pacman_conflicting (alpm_list_t *packages)
+is_pacman_conflicting (const packages_t *packages)
 {
     gboolean ret = FALSE;
-    alpm_list_t *i;
-    kalu_package_t *pkg;
+    guint n;
+    const kalu_package_t *pkg;
     char *s, *ss, *old, *new, *so, *sn;
 
-    FOR_LIST (i, packages)
+    for (n = 0; n < packages->nb; ++n)
     {
-        pkg = i->data;
+        pkg = &packages->pkgs[n];
         if (streq ("pacman", pkg->name))
         {
             /* because we'll mess with it */
@@ -534,6 +529,7 @@ show_last_notifs (void)
         notif.summary = (gchar *) _("No notifications to show.");
         notif.text = NULL;
         notif.data = NULL;
+        notif.packages = NULL;
 
         show_notif (&notif);
         return;
@@ -577,6 +573,7 @@ set_pause (gboolean paused)
     }
 
     kalpm_state.is_paused = paused;
+    invalidate_tooltips ();
     if (paused)
     {
         debug ("pausing: disable next auto-checks; update icon");
@@ -669,7 +666,7 @@ menu_news_cb (GtkMenuItem *item _UNUSED_, gpointer data)
     }
     set_kalpm_busy (TRUE);
 
-    if (!news_show (NULL, unread_only, &error))
+    if (!news_show (unread_only, &error))
     {
         show_error (_("Unable to show the recent Arch Linux news"),
                 error->message, NULL);
@@ -1019,6 +1016,7 @@ toggle_open_windows (void)
             (GFunc) ((has_hidden_windows) ? gtk_widget_show : gtk_widget_hide),
             NULL);
     has_hidden_windows = !has_hidden_windows;
+    invalidate_tooltips ();
 }
 
 static guint icon_press_timeout = 0;
@@ -1149,10 +1147,58 @@ icon_press_cb (GtkStatusIcon *icon _UNUSED_, GdkEventButton *event, gpointer dat
 
 #ifdef ENABLE_STATUS_NOTIFIER
 StatusNotifier *sn = NULL;
-GdkPixbuf *sn_icon[NB_SN_ICONS] = { NULL, };
 #endif
 GtkStatusIcon *icon = NULL;
 
+const gchar *icon_names[NB_TRAY_ICONS] = {
+    "kalu",
+    "kalu-paused",
+    "kalu-gray",
+    "kalu-gray-paused"
+};
+/* icon variants are all rendered once (see load_icons) for each size, larger
+ * ones being for HiDPI. They're used for both GtkStatusIcon & StatusNotifier */
+const gint icon_sizes[NB_ICON_SIZES] = { 16, 22, 24, 32, 48, 64, 96, 128 };
+GdkPixbuf *icon_variants[NB_TRAY_ICONS][NB_ICON_SIZES] = { { NULL, }, };
+/* variant currently shown */
+static guint icon_variant = TRAY_ICON_KALU_GRAY;
+
+/* returns the smallest rendering of variant at least size big (or the largest
+ * one), or NULL if it couldn't be loaded */
+GdkPixbuf *
+get_icon_variant (guint variant, gint size)
+{
+    guint n;
+
+    for (n = 0; n < NB_ICON_SIZES - 1; ++n)
+        if (icon_sizes[n] >= size)
+            break;
+    return icon_variants[variant][n];
+}
+
+static void
+set_status_icon_image (gint size)
+{
+    GdkPixbuf *pixbuf;
+
+    G_GNUC_BEGIN_IGNORE_DEPRECATIONS
+    pixbuf = get_icon_variant (icon_variant, size);
+    if (pixbuf)
+        gtk_status_icon_set_from_pixbuf (icon, pixbuf);
+    else
+        gtk_status_icon_set_from_icon_name (icon, icon_names[icon_variant]);
+    G_GNUC_END_IGNORE_DEPRECATIONS
+}
+
+gboolean
+icon_size_changed_cb (GtkStatusIcon *_icon _UNUSED_, gint size,
+                      gpointer data _UNUSED_)
+{
+    /* only picks another (already rendered) size */
+    set_status_icon_image (size);
+    return TRUE;
+}
+
 
 #define addstr(...)     do {                        \
     len = snprintf (s, (size_t) *max, __VA_ARGS__); \
@@ -1162,7 +1208,8 @@ GtkStatusIcon *icon = NULL;
 enum {
     TT_FULL,
     TT_TITLE,
-    TT_BODY
+    TT_BODY,
+    _NB_TT
 };
 static void make_tooltip (gchar *s, gint *max, guint tt)
 {
@@ -1320,20 +1367,67 @@ static void make_tooltip (gchar *s, gint *max, guint tt)
 }
 #undef addstr
 
+/* rendered tooltips, kept until the state changes (see invalidate_tooltips) or,
+ * for TT_FULL, the time since last check (in minutes) does */
+static struct {
+    gboolean    is_valid;
+    gint64      minutes;
+    gchar       text[512];
+} tooltips[_NB_TT];
+
+static gboolean
+do_invalidate_tooltips (gpointer data _UNUSED_)
+{
+    guint tt;
+
+    for (tt = 0; tt < _NB_TT; ++tt)
+        tooltips[tt].is_valid = FALSE;
+    return G_SOURCE_REMOVE;
+}
+
+/* state changes also come from kalu_check_work's thread, but tooltips are only
+ * ever rendered from the main thread, so that's where they're invalidated */
+void
+invalidate_tooltips (void)
+{
+    g_main_context_invoke (NULL, do_invalidate_tooltips, NULL);
+}
+
+/* returns NULL if the tooltip didn't fit */
+static const gchar *
+get_tooltip (guint tt)
+{
+    gint64 minutes = -1;
+    gint max = 512;
+
+    if (tt == TT_FULL && kalpm_state.last_check && !kalpm_state.is_busy)
+        minutes = (g_get_real_time () / G_USEC_PER_SEC
+                - g_date_time_to_unix (kalpm_state.last_check)) / 60;
+
+    if (tooltips[tt].is_valid && tooltips[tt].minutes == minutes)
+        return tooltips[tt].text;
+
+    /* in case there's nothing (TT_BODY) */
+    tooltips[tt].text[0] = '\0';
+    make_tooltip (tooltips[tt].text, &max, tt);
+    if (max <= 0)
+        return NULL;
+
+    tooltips[tt].is_valid = TRUE;
+    tooltips[tt].minutes = minutes;
+    return tooltips[tt].text;
+}
+
 gboolean
 icon_query_tooltip_cb (GtkWidget *_icon _UNUSED_, gint x _UNUSED_, gint y _UNUSED_,
                        gboolean keyboard_mode _UNUSED_, GtkTooltip *tooltip,
                        gpointer data _UNUSED_)
 {
-    gchar buf[512];
-    gint max = 512;
+    const gchar *text;
 
-    make_tooltip (buf, &max, TT_FULL);
-    if (max <= 0)
-    {
-        sprintf (buf, _("kalu: error setting tooltip"));
-    }
-    gtk_tooltip_set_text (tooltip, buf);
+    text = get_tooltip (TT_FULL);
+    gtk_tooltip_set_text (tooltip,
+            (text) ? text : _("kalu: error setting tooltip"));
     return TRUE;
 }
 
@@ -1341,67 +1435,36 @@ static gboolean
 set_status_icon (gboolean active)
 {
     if (active)
-    {
+        icon_variant = (kalpm_state.is_paused)
+            ? TRAY_ICON_KALU_PAUSED : TRAY_ICON_KALU;
+    else
+        icon_variant = (kalpm_state.is_paused)
+            ? TRAY_ICON_KALU_GRAY_PAUSED : TRAY_ICON_KALU_GRAY;
+
 #ifdef ENABLE_STATUS_NOTIFIER
-        if (sn)
-        {
-            guint i;
-            const gchar *s;
-
-            s = (kalpm_state.is_paused) ? "kalu-paused" : "kalu";
-            i = (kalpm_state.is_paused) ? SN_ICON_KALU_PAUSED : SN_ICON_KALU;
-            if (sn_icon[i])
-                g_object_set (G_OBJECT (sn),
-                        "main-icon-pixbuf",     sn_icon[i],
-                        "tooltip-icon-pixbuf",  sn_icon[i],
-                        NULL);
-            else
-                g_object_set (G_OBJECT (sn),
-                        "main-icon-name",       s,
-                        "tooltip-icon-name",    s,
-                        NULL);
-        }
+    if (sn)
+    {
+        GdkPixbuf *pixbuf = get_icon_variant (icon_variant, 48);
 
-        /* in case both are set (i.e. sn is e.g. waiting for a host, while we
-         * use icon as fallback */
-        if (icon)
-#endif
-        G_GNUC_BEGIN_IGNORE_DEPRECATIONS
-        gtk_status_icon_set_from_icon_name (icon, (kalpm_state.is_paused)
-                ? "kalu-paused"
-                : "kalu");
-        G_GNUC_END_IGNORE_DEPRECATIONS
+        if (pixbuf)
+            g_object_set (G_OBJECT (sn),
+                    "main-icon-pixbuf",     pixbuf,
+                    "tooltip-icon-pixbuf",  pixbuf,
+                    NULL);
+        else
+            g_object_set (G_OBJECT (sn),
+                    "main-icon-name",       icon_names[icon_variant],
+                    "tooltip-icon-name",    icon_names[icon_variant],
+                    NULL);
     }
-    else
-    {
-#ifdef ENABLE_STATUS_NOTIFIER
-        if (sn)
-        {
-            guint i;
-            const gchar *s;
-
-            s = (kalpm_state.is_paused) ? "kalu-gray-paused" : "kalu-gray";
-            i = (kalpm_state.is_paused) ? SN_ICON_KALU_GRAY_PAUSED : SN_ICON_KALU_GRAY;
-            if (sn_icon[i])
-                g_object_set (G_OBJECT (sn),
-                        "main-icon-pixbuf",     sn_icon[i],
-                        "tooltip-icon-pixbuf",  sn_icon[i],
-                        NULL);
-            else
-                g_object_set (G_OBJECT (sn),
-                        "main-icon-name",       s,
-                        "tooltip-icon-name",    s,
-                        NULL);
-        }
 
-        /* in case both are set (i.e. sn is e.g. waiting for a host, while we
-         * use icon as fallback */
-        if (icon)
+    /* in case both are set (i.e. sn is e.g. waiting for a host, while we
+     * use icon as fallback */
+    if (icon)
 #endif
+    {
         G_GNUC_BEGIN_IGNORE_DEPRECATIONS
-        gtk_status_icon_set_from_icon_name (icon, (kalpm_state.is_paused)
-                ? "kalu-gray-paused"
-                : "kalu-gray");
+        set_status_icon_image (gtk_status_icon_get_size (icon));
         G_GNUC_END_IGNORE_DEPRECATIONS
     }
     /* do NOT get called back */
@@ -1450,10 +1513,16 @@ set_kalpm_nb (check_t type, gint nb, gboolean do_update_icon)
         kalpm_state.nb_news = nb;
     }
 
+    invalidate_tooltips ();
     if (do_update_icon)
     {
         update_icon ();
     }
+#ifdef ENABLE_STATUS_NOTIFIER
+    /* when busy, it'll be done once no longer */
+    if (!kalpm_state.is_busy)
+        sn_refresh_tooltip ();
+#endif
 }
 
 inline GString **
@@ -1480,29 +1549,38 @@ switch_status_icon (void)
 }
 
 #ifdef ENABLE_STATUS_NOTIFIER
-static void sn_refresh_tooltip (void)
+static gboolean
+do_sn_refresh_tooltip (gpointer data _UNUSED_)
 {
-    gchar buf[512];
-    gint max = 512;
+    const gchar *title;
+    const gchar *body;
 
     if (!sn)
-        return;
+        return G_SOURCE_REMOVE;
+
+    /* only called on state changes, but there might be nothing new */
+    if (tooltips[TT_TITLE].is_valid && tooltips[TT_BODY].is_valid)
+        return G_SOURCE_REMOVE;
 
     status_notifier_freeze_tooltip (sn);
-    make_tooltip (buf, &max, TT_TITLE);
-    if (max > 0)
+    title = get_tooltip (TT_TITLE);
+    if (title)
     {
-        status_notifier_set_tooltip_title (sn, buf);
+        status_notifier_set_tooltip_title (sn, title);
     }
-    max = 512;
-    /* in case there's nothing, else we would set the title as body */
-    buf[0] = '\0';
-    make_tooltip (buf, &max, TT_BODY);
-    if (max > 0)
+    body = get_tooltip (TT_BODY);
+    if (body)
     {
-        status_notifier_set_tooltip_body (sn, buf);
+        status_notifier_set_tooltip_body (sn, body);
     }
     status_notifier_thaw_tooltip (sn);
+    return G_SOURCE_REMOVE;
+}
+
+/* like invalidate_tooltips, so it comes after it */
+static void sn_refresh_tooltip (void)
+{
+    g_main_context_invoke (NULL, do_sn_refresh_tooltip, NULL);
 }
 #endif
 
@@ -1529,6 +1607,8 @@ set_kalpm_busy (gboolean busy)
     {
         return;
     }
+    /* also covers last_check, only updated while busy */
+    invalidate_tooltips ();
 
     if (busy)
     {
@@ -1696,6 +1776,7 @@ skip_next_timeout (gpointer no_checks)
         /* since we're busy, we can't toggle right now. instead, we'll
          * update the flag, so it'll be takin into accound right away */
         kalpm_state.is_paused = paused;
+        invalidate_tooltips ();
         /* We might not be busy, but no_checks is set, in which case we do the
          * same as to not trigger the checks (via set_pause()). no_checks is
          * only set when called on app start and auto-checks are disabled
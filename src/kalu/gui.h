@@ -69,7 +69,7 @@ void action_news (NotifyNotification *notification,
 
 void notification_closed_cb (NotifyNotification *notification, gpointer data);
 
-gboolean is_pacman_conflicting (alpm_list_t *packages);
+gboolean is_pacman_conflicting (const packages_t *packages);
 
 void kalu_check (gboolean is_auto);
 gboolean kalu_auto_check (void);
@@ -87,6 +87,8 @@ void remove_open_window (gpointer window);
 gboolean icon_press_cb (GtkStatusIcon *icon, GdkEventButton *event,
         gpointer data);
 
+GdkPixbuf *get_icon_variant (guint variant, gint size);
+gboolean icon_size_changed_cb (GtkStatusIcon *icon, gint size, gpointer data);
 gboolean icon_query_tooltip_cb (GtkWidget *icon, gint x, gint y,
         gboolean keyboard_mode, GtkTooltip *tooltip, gpointer data);
 
@@ -96,6 +98,7 @@ void set_kalpm_nb (check_t type, gint nb, gboolean update_icon);
 GString **get_kalpm_synced_dbs (void);
 void reset_kalpm_synced_dbs (void);
 void set_kalpm_busy (gboolean busy);
+void invalidate_tooltips (void);
 void reset_timeout (void);
 gboolean skip_next_timeout (gpointer no_checks);
 gboolean reload_watched (gboolean is_aur, GError **error);
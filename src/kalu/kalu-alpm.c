@@ -27,6 +27,8 @@
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/file.h> /* flock() */
+#include <time.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
@@ -44,6 +46,7 @@
 #include "kalu-alpm.h"
 #include "util.h"
 #include "conf.h"
+#include "cache-index.h"
 
 /* global variable */
 unsigned short alpm_verbose;
@@ -52,7 +55,18 @@ unsigned short alpm_verbose;
 static kalu_alpm_t *alpm;
 static gchar *tmp_dbpath = NULL;
 static gboolean is_tmp_dbpath_set = FALSE;
-
+/* multi-root checks: DBs sync-ed for one root are kept in fleet_dir, so other
+ * roots using the same repo (name & servers) get a copy instead of downloading
+ * it again */
+static gchar *fleet_dir = NULL;
+static GHashTable *fleet_dbs = NULL;
+/* kept across checks (inotify keeps them current in between), one per list of
+ * cachedirs, so checking multiple roots doesn't re-index them for each one */
+static GHashTable *cache_indexes = NULL;
+/* the one for the loaded root */
+static cache_index_t *cache_index = NULL;
+
+static cache_index_t *get_cache_index (alpm_list_t *cachedirs);
 static gboolean copy_file (const gchar *from, const gchar *to);
 static gboolean create_local_db (const gchar *dbpath, gchar **newpath,
         GString **_synced_dbs, GError **error);
@@ -85,6 +99,28 @@ copy_file (const gchar *from, const gchar *to)
     return TRUE;
 }
 
+static gboolean
+copy_file_with_times (const gchar *from, const gchar *to)
+{
+    struct stat     filestat;
+    struct utimbuf  times;
+
+    if (stat (from, &filestat) < 0 || !copy_file (from, to))
+    {
+        return FALSE;
+    }
+
+    /* preserve time, used by libalpm to determine if DBs are up to date */
+    times.actime = filestat.st_atime;
+    times.modtime = filestat.st_mtime;
+    if (0 != utime (to, &times))
+    {
+        debug ("Unable to change time of %s", to);
+        return FALSE;
+    }
+    return TRUE;
+}
+
 static gboolean
 create_local_db (const gchar *_dbpath, gchar **newpath, GString **_synced_dbs, GError **error)
 {
@@ -499,11 +535,10 @@ kalu_alpm_load (kalu_simul_t    *simulation,
     gchar              *newpath;
     enum _alpm_errno_t  err;
     pacman_config_t    *pac_conf = NULL;
-    gchar              *section = NULL;
 
     /* parse pacman.conf */
     debug ("parsing pacman.conf (%s) for options", conffile);
-    if (!parse_pacman_conf (conffile, &section, 0, 0, &pac_conf, &local_err))
+    if (!load_pacman_conf (conffile, &pac_conf, &local_err))
     {
         g_propagate_error (error, local_err);
         free_pacman_config (pac_conf);
@@ -555,6 +590,7 @@ kalu_alpm_load (kalu_simul_t    *simulation,
     }
     /* cachedirs are used when determining download size */
     alpm_option_set_cachedirs (alpm->handle, pac_conf->cachedirs);
+    cache_index = get_cache_index (pac_conf->cachedirs);
 
 #ifndef DISABLE_UPDATER
     if (simulation)
@@ -653,6 +689,278 @@ kalu_alpm_load (kalu_simul_t    *simulation,
     return TRUE;
 }
 
+static gchar *
+get_db_key (alpm_db_t *db)
+{
+    GString     *str;
+    alpm_list_t *i;
+
+    /* same name, siglevel & servers means same DB, whatever the root. The
+     * siglevel matters since it decides whether the .sig gets downloaded */
+    str = g_string_new (alpm_db_get_name (db));
+    g_string_append_printf (str, "\n%x", (unsigned int) alpm_db_get_siglevel (db));
+    FOR_LIST (i, alpm_db_get_servers (db))
+    {
+        g_string_append_c (str, '\n');
+        g_string_append (str, (const gchar *) i->data);
+    }
+    return g_string_free (str, FALSE);
+}
+
+/* copy DB (and its signature, if any) from shared location base (i.e. base.db
+ * and base.db.sig) into our tmp dbpath, unless ours is as recent.
+ * Returns like alpm_db_update: 0 if updated, 1 if up to date, -1 on error */
+static int
+get_shared_db (alpm_db_t *db, const gchar *base)
+{
+    gchar       from[PATH_MAX];
+    gchar       to[PATH_MAX];
+    struct stat st_from;
+    struct stat st_to;
+    const char *dbname = alpm_db_get_name (db);
+
+    if (snprintf (from, PATH_MAX - 4, "%s.db", base) >= PATH_MAX - 4
+            || snprintf (to, PATH_MAX - 4, "%s/sync/%s.db", alpm->dbpath, dbname)
+            >= PATH_MAX - 4
+            || stat (from, &st_from) < 0)
+    {
+        return -1;
+    }
+
+    if (stat (to, &st_to) == 0 && st_to.st_mtime >= st_from.st_mtime)
+    {
+        return 1;
+    }
+
+    debug ("using shared copy of %s", dbname);
+    if (!copy_file_with_times (from, to))
+    {
+        return -1;
+    }
+
+    strcat (from, ".sig");
+    strcat (to, ".sig");
+    if (access (from, F_OK) == 0)
+    {
+        if (!copy_file_with_times (from, to))
+        {
+            return -1;
+        }
+    }
+    else
+    {
+        unlink (to);
+    }
+
+    return 0;
+}
+
+/* copy our DB (and its signature, if any) to shared location base. Since
+ * g_file_set_contents() writes into a temp file it then renames, files are
+ * replaced atomically */
+static gboolean
+put_shared_db (alpm_db_t *db, const gchar *base)
+{
+    gchar       from[PATH_MAX];
+    gchar       to[PATH_MAX];
+    const char *dbname = alpm_db_get_name (db);
+
+    if (snprintf (from, PATH_MAX - 4, "%s/sync/%s.db", alpm->dbpath, dbname)
+            >= PATH_MAX - 4
+            || snprintf (to, PATH_MAX - 4, "%s.db", base) >= PATH_MAX - 4
+            || !copy_file_with_times (from, to))
+    {
+        return FALSE;
+    }
+
+    strcat (from, ".sig");
+    strcat (to, ".sig");
+    if (access (from, F_OK) == 0)
+    {
+        return copy_file_with_times (from, to);
+    }
+    unlink (to);
+    return TRUE;
+}
+
+/* lock the DB in the shared cache, filling base. Every instance takes an
+ * exclusive lock, since the one finding the DB outdated will update it.
+ * Returns the fd holding the lock, or -1 */
+static gint
+cache_lock_db (alpm_db_t *db, gchar base[PATH_MAX])
+{
+    gchar       file[PATH_MAX];
+    gchar      *key;
+    gchar      *hash;
+    const char *dbname = alpm_db_get_name (db);
+    gint        fd;
+    int         l;
+
+    key = get_db_key (db);
+    hash = g_compute_checksum_for_string (G_CHECKSUM_SHA1, key, -1);
+    l = snprintf (base, PATH_MAX, "%s/%s-%s", config->shared_dbs_dir, dbname, hash);
+    g_free (hash);
+    g_free (key);
+    if (l >= PATH_MAX - 12)
+    {
+        debug ("path too long, not using shared cache for %s", dbname);
+        return -1;
+    }
+
+    snprintf (file, PATH_MAX, "%s.lock", base);
+    do
+        fd = open (file, O_RDONLY | O_CREAT | O_CLOEXEC, 0664);
+    while (fd < 0 && errno == EINTR);
+    if (fd < 0)
+    {
+        debug ("cannot open %s: %s -- not using shared cache",
+                file, strerror (errno));
+        return -1;
+    }
+
+    while (flock (fd, LOCK_EX) < 0)
+    {
+        if (errno != EINTR)
+        {
+            debug ("cannot lock %s: %s -- not using shared cache",
+                    file, strerror (errno));
+            close (fd);
+            return -1;
+        }
+    }
+
+    return fd;
+}
+
+/* whether the shared DB was checked recently enough to be used as is. *ret is
+ * set to the result of getting the shared copy, if any */
+static gboolean
+cache_is_fresh (alpm_db_t *db, const gchar *base, int *ret)
+{
+    gchar       file[PATH_MAX];
+    struct stat st;
+    time_t      age;
+
+    snprintf (file, PATH_MAX, "%s.checked", base);
+    if (stat (file, &st) < 0)
+    {
+        return FALSE;
+    }
+
+    *ret = get_shared_db (db, base);
+    if (*ret < 0)
+    {
+        /* broken cache, we'll sync ourself (and replace it) */
+        debug ("unable to use shared copy of %s", alpm_db_get_name (db));
+        *ret = 1;
+        return FALSE;
+    }
+
+    age = time (NULL) - st.st_mtime;
+    if (age < 0 || age >= config->shared_dbs_max_age)
+    {
+        return FALSE;
+    }
+
+    debug ("shared copy of %s checked %ds ago, re-using",
+            alpm_db_get_name (db), (int) age);
+    return TRUE;
+}
+
+static int
+update_db (alpm_db_t *db, GError **error)
+{
+    gchar   base[PATH_MAX];
+    gchar   file[PATH_MAX];
+    gint    fd = -1;
+    int     ret_cache = 1;
+    int     ret;
+
+    if (config->shared_dbs_dir)
+    {
+        fd = cache_lock_db (db, base);
+        if (fd >= 0 && cache_is_fresh (db, base, &ret_cache))
+        {
+            close (fd);
+            return ret_cache;
+        }
+    }
+
+    ret = alpm_db_update (0, db);
+    if (ret < 0)
+    {
+        g_set_error (error, KALU_ERROR, 1,
+                _("Failed to update %s: %s"),
+                alpm_db_get_name (db),
+                alpm_strerror (alpm_errno (alpm->handle)));
+    }
+    else if (fd >= 0)
+    {
+        snprintf (file, PATH_MAX, "%s.checked", base);
+        if (put_shared_db (db, base) && g_file_set_contents (file, "", 0, NULL))
+        {
+            debug ("updated shared copy of %s", alpm_db_get_name (db));
+        }
+        else
+        {
+            debug ("unable to update shared copy of %s", alpm_db_get_name (db));
+        }
+    }
+
+    if (fd >= 0)
+    {
+        /* releases the lock */
+        close (fd);
+    }
+    /* if we got a newer DB from the cache, it was updated all the same */
+    return (ret == 1 && ret_cache == 0) ? 0 : ret;
+}
+
+static int
+fleet_update_db (alpm_db_t *db, GError **error)
+{
+    gchar       *key;
+    gchar       *base;
+    const gchar *shared;
+    int          ret;
+
+    key = get_db_key (db);
+    shared = g_hash_table_lookup (fleet_dbs, key);
+    if (shared)
+    {
+        g_free (key);
+        ret = get_shared_db (db, shared);
+        if (ret < 0)
+        {
+            g_set_error (error, KALU_ERROR, 1,
+                    _("Failed to update %s: Unable to copy shared database"),
+                    alpm_db_get_name (db));
+        }
+        return ret;
+    }
+
+    ret = update_db (db, error);
+    if (ret < 0)
+    {
+        g_free (key);
+        return ret;
+    }
+
+    base = g_strdup_printf ("%s/%u", fleet_dir, g_hash_table_size (fleet_dbs));
+    if (put_shared_db (db, base))
+    {
+        debug ("sharing %s as %s", alpm_db_get_name (db), base);
+        g_hash_table_insert (fleet_dbs, key, base);
+    }
+    else
+    {
+        debug ("unable to share %s", alpm_db_get_name (db));
+        g_free (base);
+        g_free (key);
+    }
+    return ret;
+}
+
 gboolean
 kalu_alpm_syncdbs (GString **_synced_dbs, GError **error)
 {
@@ -680,13 +988,12 @@ kalu_alpm_syncdbs (GString **_synced_dbs, GError **error)
         if (alpm->simulation)
             alpm->simulation->on_sync_db_start (NULL, alpm_db_get_name (db));
 #endif
-        ret = alpm_db_update (0, db);
+        if (fleet_dir)
+            ret = fleet_update_db (db, error);
+        else
+            ret = update_db (db, error);
         if (ret < 0)
         {
-            g_set_error (error, KALU_ERROR, 1,
-                    _("Failed to update %s: %s"),
-                    alpm_db_get_name (db),
-                    alpm_strerror (alpm_errno (alpm->handle)));
             return FALSE;
         }
         else if (ret == 1)
@@ -736,7 +1043,7 @@ kalu_alpm_syncdbs (GString **_synced_dbs, GError **error)
 }
 
 gboolean
-kalu_alpm_has_updates (alpm_list_t **packages, GError **error)
+kalu_alpm_has_updates (packages_t **packages, GError **error)
 {
     alpm_list_t *i;
     alpm_list_t *data       = NULL;
@@ -844,34 +1151,33 @@ kalu_alpm_has_updates (alpm_list_t **packages, GError **error)
     }
 
     alpm_db_t *db_local = alpm_get_localdb (alpm->handle);
+    cache_index_refresh (cache_index);
     FOR_LIST (i, alpm_trans_get_add (alpm->handle))
     {
         alpm_pkg_t *pkg = i->data;
         alpm_pkg_t *old = alpm_db_get_pkg (db_local, alpm_pkg_get_name (pkg));
         kalu_package_t *package;
 
-        package = new0 (kalu_package_t, 1);
-        package->repo = strdup (alpm_db_get_name (alpm_pkg_get_db (pkg)));
-        package->name = strdup (alpm_pkg_get_name (pkg));
-        package->desc = strdup (alpm_pkg_get_desc (pkg));
-        package->new_version = strdup (alpm_pkg_get_version (pkg));
-        package->dl_size = (guint) alpm_pkg_download_size (pkg);
+        package = add_package (packages);
+        package->repo = intern_str (*packages, alpm_db_get_name (alpm_pkg_get_db (pkg)));
+        package->name = intern_str (*packages, alpm_pkg_get_name (pkg));
+        package->desc = intern_str (*packages, alpm_pkg_get_desc (pkg));
+        package->new_version = intern_str (*packages, alpm_pkg_get_version (pkg));
+        package->dl_size = (guint) cache_index_download_size (cache_index, pkg);
         package->new_size = (guint) alpm_pkg_get_isize (pkg);
         /* we might not have an old package, when an update requires to
          * install a new package (e.g. after a split) */
         if (old)
         {
-            package->old_version = strdup (alpm_pkg_get_version (old));
+            package->old_version = intern_str (*packages, alpm_pkg_get_version (old));
             package->old_size = (guint) alpm_pkg_get_isize (old);
         }
         else
         {
             /* TRANSLATORS: no previous version */
-            package->old_version = strdup (_("none"));
+            package->old_version = intern_str (*packages, _("none"));
             package->old_size = 0;
         }
-
-        *packages = alpm_list_add (*packages, package);
     }
 
 #ifndef DISABLE_UPDATER
@@ -885,17 +1191,15 @@ kalu_alpm_has_updates (alpm_list_t **packages, GError **error)
             alpm_pkg_t *old = alpm_db_get_pkg (db_local, alpm_pkg_get_name (pkg));
             kalu_package_t *package;
 
-            package = new0 (kalu_package_t, 1);
-            package->repo = strdup (alpm_db_get_name (alpm_pkg_get_db (pkg)));
-            package->name = strdup (alpm_pkg_get_name (pkg));
-            package->desc = strdup (alpm_pkg_get_desc (pkg));
-            package->new_version = strdup (_("none"));
+            package = add_package (packages);
+            package->repo = intern_str (*packages, alpm_db_get_name (alpm_pkg_get_db (pkg)));
+            package->name = intern_str (*packages, alpm_pkg_get_name (pkg));
+            package->desc = intern_str (*packages, alpm_pkg_get_desc (pkg));
+            package->new_version = intern_str (*packages, _("none"));
             package->dl_size = 0;
             package->new_size = 0;
-            package->old_version = strdup (alpm_pkg_get_version (old));
+            package->old_version = intern_str (*packages, alpm_pkg_get_version (old));
             package->old_size = (guint) alpm_pkg_get_isize (old);
-
-            *packages = alpm_list_add (*packages, package);
         }
 #endif
 
@@ -907,7 +1211,7 @@ cleanup:
 }
 
 gboolean
-kalu_alpm_has_updates_watched (alpm_list_t **packages, alpm_list_t *watched,
+kalu_alpm_has_updates_watched (packages_t **packages, alpm_list_t *watched,
         GError **error)
 {
     alpm_list_t *sync_dbs = alpm_get_syncdbs (alpm->handle);
@@ -920,6 +1224,7 @@ kalu_alpm_has_updates_watched (alpm_list_t **packages, alpm_list_t *watched,
         return FALSE;
     }
 
+    cache_index_refresh (cache_index);
     FOR_LIST (i, watched)
     {
         alpm_pkg_t *pkg = NULL;
@@ -949,21 +1254,24 @@ kalu_alpm_has_updates_watched (alpm_list_t **packages, alpm_list_t *watched,
                 if (alpm_pkg_vercmp (alpm_pkg_get_version (pkg),
                             w_pkg->version) > 0)
                 {
-                    package = new0 (kalu_package_t, 1);
+                    package = add_package (packages);
 
-                    package->repo = strdup (alpm_db_get_name (alpm_pkg_get_db (pkg)));
+                    package->repo = intern_str (*packages,
+                            alpm_db_get_name (alpm_pkg_get_db (pkg)));
                     /* we want to keep the name as "repo/name" (despite the
                      * "oddity" of it) so it is processed correctly in the
                      * watched list, as well as to indicate it was restricted to
                      * this specific repo */
-                    package->name = strdup ((s) ? w_pkg->name : alpm_pkg_get_name (pkg));
-                    package->desc = strdup (alpm_pkg_get_desc (pkg));
-                    package->old_version = strdup (w_pkg->version);
-                    package->new_version = strdup (alpm_pkg_get_version (pkg));
-                    package->dl_size = (guint) alpm_pkg_download_size (pkg);
+                    package->name = intern_str (*packages,
+                            (s) ? w_pkg->name : alpm_pkg_get_name (pkg));
+                    package->desc = intern_str (*packages, alpm_pkg_get_desc (pkg));
+                    package->old_version = intern_str (*packages, w_pkg->version);
+                    package->new_version = intern_str (*packages,
+                            alpm_pkg_get_version (pkg));
+                    package->dl_size = (guint) cache_index_download_size (
+                            cache_index, pkg);
                     package->new_size = (guint) alpm_pkg_get_isize (pkg);
 
-                    *packages = alpm_list_add (*packages, package);
                     debug ("found watched update %s: %s -> %s", package->name,
                             package->old_version, package->new_version);
                 }
@@ -973,16 +1281,15 @@ kalu_alpm_has_updates_watched (alpm_list_t **packages, alpm_list_t *watched,
 
         if (!pkg)
         {
-            package = new0 (kalu_package_t, 1);
+            package = add_package (packages);
 
-            package->name = strdup (w_pkg->name);
-            package->desc = strdup (_("<package not found>"));
-            package->old_version = strdup (w_pkg->version);
-            package->new_version = strdup ("-");
+            package->name = intern_str (*packages, w_pkg->name);
+            package->desc = intern_str (*packages, _("<package not found>"));
+            package->old_version = intern_str (*packages, w_pkg->version);
+            package->new_version = intern_str (*packages, "-");
             package->dl_size = 0;
             package->new_size = 0;
 
-            *packages = alpm_list_add (*packages, package);
             debug ("watched package not found: %s", package->name);
         }
     }
@@ -1036,6 +1343,74 @@ kalu_alpm_has_foreign (alpm_list_t **packages, alpm_list_t *ignore,
     return (*packages != NULL);
 }
 
+gboolean
+kalu_alpm_fleet_init (GError **error)
+{
+    if (fleet_dir)
+    {
+        return TRUE;
+    }
+
+    if (NULL == (fleet_dir = g_dir_make_tmp ("kalu-fleet-XXXXXX", NULL)))
+    {
+        g_set_error (error, KALU_ERROR, 1, _("Unable to create temp folder"));
+        return FALSE;
+    }
+    debug ("created fleet folder %s", fleet_dir);
+    fleet_dbs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+    return TRUE;
+}
+
+gboolean
+kalu_alpm_fleet_load (const gchar *conffile, GError **error)
+{
+    gchar    *main_tmp_dbpath = tmp_dbpath;
+    gboolean  main_is_set     = is_tmp_dbpath_set;
+    gboolean  ret;
+
+    /* each root gets its own tmp dbpath, without touching the one of the main
+     * root (which can be re-used across checks) */
+    tmp_dbpath = NULL;
+    is_tmp_dbpath_set = FALSE;
+
+    ret = kalu_alpm_load (NULL, conffile, NULL, error);
+    /* on success, alpm->dbpath has it */
+    if (!ret && tmp_dbpath)
+    {
+        rmrf (tmp_dbpath);
+    }
+    g_free (tmp_dbpath);
+
+    tmp_dbpath = main_tmp_dbpath;
+    is_tmp_dbpath_set = main_is_set;
+    return ret;
+}
+
+void
+kalu_alpm_fleet_unload (void)
+{
+    if (alpm && alpm->dbpath)
+    {
+        rmrf (alpm->dbpath);
+    }
+    kalu_alpm_free ();
+}
+
+void
+kalu_alpm_fleet_free (void)
+{
+    if (!fleet_dir)
+    {
+        return;
+    }
+
+    rmrf (fleet_dir);
+    g_free (fleet_dir);
+    fleet_dir = NULL;
+    g_hash_table_unref (fleet_dbs);
+    fleet_dbs = NULL;
+}
+
 const gchar *
 kalu_alpm_get_dbpath (void)
 {
@@ -1053,6 +1428,48 @@ kalu_alpm_rmdb (gboolean keep_tmp_dbpath)
     tmp_dbpath = NULL;
 }
 
+static cache_index_t *
+get_cache_index (alpm_list_t *cachedirs)
+{
+    cache_index_t *ci;
+    alpm_list_t   *i;
+    GString       *key;
+
+    if (!cache_indexes)
+        cache_indexes = g_hash_table_new_full (g_str_hash, g_str_equal,
+                g_free, (GDestroyNotify) cache_index_free);
+
+    key = g_string_new (NULL);
+    FOR_LIST (i, cachedirs)
+    {
+        g_string_append (key, i->data);
+        g_string_append_c (key, '\n');
+    }
+
+    ci = g_hash_table_lookup (cache_indexes, key->str);
+    if (ci)
+    {
+        g_string_free (key, TRUE);
+        return ci;
+    }
+
+    ci = cache_index_new ();
+    cache_index_set_dirs (ci, cachedirs, FALSE);
+    g_hash_table_insert (cache_indexes, g_string_free (key, FALSE), ci);
+    return ci;
+}
+
+void
+kalu_alpm_free_cache_index (void)
+{
+    cache_index = NULL;
+    if (cache_indexes)
+    {
+        g_hash_table_unref (cache_indexes);
+        cache_indexes = NULL;
+    }
+}
+
 void
 kalu_alpm_free (void)
 {
@@ -67,20 +67,35 @@ gboolean
 kalu_alpm_syncdbs (GString **_synced_dbs, GError **error);
 
 gboolean
-kalu_alpm_has_updates (alpm_list_t **packages, GError **error);
+kalu_alpm_has_updates (packages_t **packages, GError **error);
 
 gboolean
-kalu_alpm_has_updates_watched (alpm_list_t **packages, alpm_list_t *watched, GError **error);
+kalu_alpm_has_updates_watched (packages_t **packages, alpm_list_t *watched, GError **error);
 
 gboolean
 kalu_alpm_has_foreign (alpm_list_t **packages, alpm_list_t *ignore, GError **error);
 
+gboolean
+kalu_alpm_fleet_init (GError **error);
+
+gboolean
+kalu_alpm_fleet_load (const gchar *conffile, GError **error);
+
+void
+kalu_alpm_fleet_unload (void);
+
+void
+kalu_alpm_fleet_free (void);
+
 const gchar *
 kalu_alpm_get_dbpath (void);
 
 void
 kalu_alpm_rmdb (gboolean keep_tmp_dbpath);
 
+void
+kalu_alpm_free_cache_index (void);
+
 void
 kalu_alpm_free (void);
 
@@ -20,18 +20,28 @@
  * kalu. If not, see http://www.gnu.org/licenses/
  */
 
+/* F_GET_SEALS */
+#define _GNU_SOURCE
+
 #include <config.h>
 
 /* C */
 #include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 /* gio - for dbus */
 #include <gio/gio.h>
+#include <gio/gunixfdlist.h>
 
 /* kalu */
 #include "kalu.h"
 #include "kalu-updater.h"
 #include "closures.h"
+#include "recorder.h"
 
 #include "../kalu-dbus/updater-dbus.h"
 
@@ -177,9 +187,29 @@ struct _KaluUpdaterClass
                                      const gchar        *key_created);
 };
 
+typedef struct _signal_stat_t {
+    guint   count;
+    gint64  total;
+    gint64  max;
+} signal_stat_t;
+
+/* feeds a recorded signal stream back into the object, in place of kalu-dbus */
+typedef struct _replay_driver_t {
+    replay_t        *replay;
+    gboolean         max_speed;
+    guint            source;
+    gboolean         paused;
+    const gchar     *signal_name;   /* next record, not yet dispatched */
+    GVariant        *parameters;
+    guint32          delay;
+    GHashTable      *stats;
+} replay_driver_t;
+
 struct _KaluUpdaterPrivate
 {
     method_callback_t *method_callbacks;
+    recorder_t        *recorder;
+    replay_driver_t   *driver;
 };
 
 GType       kalu_updater_get_type   (void) G_GNUC_CONST;
@@ -279,6 +309,26 @@ kalu_updater_finalize (GObject *object)
     G_GNUC_UNUSED KaluUpdater *kupdater = KALU_UPDATER (object);
 
     free (kupdater->priv->method_callbacks);
+    if (kupdater->priv->recorder)
+    {
+        recorder_free (kupdater->priv->recorder);
+    }
+    if (kupdater->priv->driver)
+    {
+        replay_driver_t *driver = kupdater->priv->driver;
+
+        if (driver->source > 0)
+        {
+            g_source_remove (driver->source);
+        }
+        if (driver->parameters)
+        {
+            g_variant_unref (driver->parameters);
+        }
+        replay_free (driver->replay);
+        g_hash_table_unref (driver->stats);
+        free (driver);
+    }
 
     if (G_OBJECT_CLASS (kalu_updater_parent_class)->finalize != NULL)
     {
@@ -299,6 +349,7 @@ kalu_updater_init (KaluUpdater *kupdater)
     method_callback_t mc[] = {
         {"Init",        FALSE, NULL, NULL},
         {"InitAlpm",    FALSE, NULL, NULL},
+        {"Setup",       FALSE, NULL, NULL},
         {"AddDb",       FALSE, NULL, NULL},
         {"SyncDbs",     FALSE, NULL, NULL},
         {"GetPackages", FALSE, NULL, NULL},
@@ -317,10 +368,273 @@ kalu_updater_init (KaluUpdater *kupdater)
     }
 }
 
+/* GetPackagesFinished & GetPackagesTable are sent as result of either
+ * GetPackages, or Setup */
+static gboolean
+take_get_packages_callback (KaluUpdater              *kupdater,
+                            const gchar              *signal_name,
+                            KaluGetPackagesCallback  *cb,
+                            gpointer                 *data)
+{
+    method_callback_t *mc;
+
+    for (mc = kupdater->priv->method_callbacks; mc->name; ++mc)
+    {
+        if (mc->is_running && (streq (mc->name, "GetPackages")
+                    || streq (mc->name, "Setup")))
+        {
+            *cb = (KaluGetPackagesCallback) mc->callback;
+            *data = mc->data;
+
+            mc->is_running = FALSE;
+            mc->callback = NULL;
+            mc->data = NULL;
+            return TRUE;
+        }
+    }
+
+    debug ("%s: method not registered running\n", signal_name);
+    return FALSE;
+}
+
+#ifdef HAVE_MEMFD_CREATE
+/* reads the packages from the table kalu-dbus wrote in a sealed memfd: the fd
+ * is mapped read-only, strings are only interned */
+static packages_t *
+read_packages_table (gint fd, GError **error)
+{
+    const kupdater_pkg_table_t  *hdr;
+    const kupdater_pkg_record_t *rec;
+    const gchar *strings;
+    packages_t *pkgs = NULL;
+    struct stat st;
+    gsize len;
+    void *map;
+    guint32 n;
+    gint seals;
+
+    /* sealed, so it can't be changed under us while we're reading it */
+    seals = fcntl (fd, F_GET_SEALS);
+    if (seals < 0 || (seals & (F_SEAL_SHRINK | F_SEAL_WRITE))
+            != (F_SEAL_SHRINK | F_SEAL_WRITE))
+    {
+        g_set_error (error, KALU_UPDATER_ERROR, 1,
+                _("Packages table isn't sealed\n"));
+        return NULL;
+    }
+    if (fstat (fd, &st) < 0 || st.st_size < (off_t) sizeof (*hdr))
+    {
+        g_set_error (error, KALU_UPDATER_ERROR, 1,
+                _("Invalid packages table\n"));
+        return NULL;
+    }
+    len = (gsize) st.st_size;
+
+    map = mmap (NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        g_set_error (error, KALU_UPDATER_ERROR, 1,
+                _("Unable to map packages table: %s\n"), g_strerror (errno));
+        return NULL;
+    }
+
+    hdr = map;
+    rec = (const kupdater_pkg_record_t *) (hdr + 1);
+    if (memcmp (hdr->magic, KUPDATER_PKG_TABLE_MAGIC, sizeof (hdr->magic)) != 0
+            || hdr->version != KUPDATER_PKG_TABLE_VERSION
+            || hdr->nb_pkgs > (len - sizeof (*hdr)) / sizeof (*rec)
+            || hdr->strings_len == 0
+            || len != sizeof (*hdr) + hdr->nb_pkgs * sizeof (*rec)
+                        + hdr->strings_len)
+    {
+        munmap (map, len);
+        g_set_error (error, KALU_UPDATER_ERROR, 1,
+                _("Invalid packages table\n"));
+        return NULL;
+    }
+    strings = (const gchar *) (rec + hdr->nb_pkgs);
+    /* so every offset within strings_len points to a NUL-terminated string */
+    if (strings[hdr->strings_len - 1] != '\0')
+    {
+        munmap (map, len);
+        g_set_error (error, KALU_UPDATER_ERROR, 1,
+                _("Invalid packages table\n"));
+        return NULL;
+    }
+
+    for (n = 0; n < hdr->nb_pkgs; ++n, ++rec)
+    {
+        kalu_package_t *k_pkg;
+
+        if (rec->repo >= hdr->strings_len || rec->name >= hdr->strings_len
+                || rec->desc >= hdr->strings_len
+                || rec->old_version >= hdr->strings_len
+                || rec->new_version >= hdr->strings_len)
+        {
+            munmap (map, len);
+            free_packages (pkgs);
+            g_set_error (error, KALU_UPDATER_ERROR, 1,
+                    _("Invalid packages table\n"));
+            return NULL;
+        }
+
+        k_pkg = add_package (&pkgs);
+        k_pkg->repo = intern_str (pkgs, strings + rec->repo);
+        k_pkg->name = intern_str (pkgs, strings + rec->name);
+        k_pkg->desc = intern_str (pkgs, strings + rec->desc);
+        k_pkg->old_version = intern_str (pkgs, strings + rec->old_version);
+        k_pkg->new_version = intern_str (pkgs, strings + rec->new_version);
+        k_pkg->dl_size = rec->dl_size;
+        k_pkg->old_size = rec->old_size;
+        k_pkg->new_size = rec->new_size;
+    }
+
+    munmap (map, len);
+    return pkgs;
+}
+#endif /* HAVE_MEMFD_CREATE */
+
+static void
+record_signal (KaluUpdater *kupdater, const gchar *signal_name,
+               GVariant *parameters)
+{
+    GError *local_err = NULL;
+
+    if (!recorder_add (kupdater->priv->recorder, signal_name, parameters,
+                &local_err))
+    {
+        debug ("Stopping recording: %s", local_err->message);
+        g_clear_error (&local_err);
+        recorder_free (kupdater->priv->recorder);
+        kupdater->priv->recorder = NULL;
+    }
+}
+
+/* the table itself cannot be replayed, so it is recorded as the
+ * GetPackagesFinished it replaces */
+static void
+record_packages (KaluUpdater *kupdater, packages_t *pkgs)
+{
+    GVariantBuilder builder;
+    GVariant *v;
+    kalu_package_t *k_pkg;
+    guint i;
+
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(sssssuuu)"));
+    for (i = 0; pkgs && i < pkgs->nb; ++i)
+    {
+        k_pkg = &pkgs->pkgs[i];
+        g_variant_builder_add (&builder, "(sssssuuu)",
+                k_pkg->repo,
+                k_pkg->name,
+                k_pkg->desc,
+                k_pkg->old_version,
+                k_pkg->new_version,
+                k_pkg->dl_size,
+                k_pkg->old_size,
+                k_pkg->new_size);
+    }
+    v = g_variant_ref_sink (g_variant_new ("(a(sssssuuu))", &builder));
+    record_signal (kupdater, "GetPackagesFinished", v);
+    g_variant_unref (v);
+}
+
+#ifdef HAVE_MEMFD_CREATE
+typedef struct
+{
+    KaluUpdater             *kupdater;
+    KaluGetPackagesCallback  cb;
+    gpointer                 data;
+} take_table_t;
+
+static void
+take_packages_table_finish (GDBusProxy *proxy, GAsyncResult *res,
+                            take_table_t *tt)
+{
+    GError *local_err = NULL;
+    GUnixFDList *fd_list = NULL;
+    GVariant *variant;
+    packages_t *pkgs = NULL;
+    gint32 idx;
+    gint fd = -1;
+
+    variant = g_dbus_proxy_call_with_unix_fd_list_finish (proxy, &fd_list,
+            res, &local_err);
+    if (variant)
+    {
+        g_variant_get (variant, "(h)", &idx);
+        g_variant_unref (variant);
+        /* dup-ed, so we own it */
+        if (fd_list)
+        {
+            fd = g_unix_fd_list_get (fd_list, idx, &local_err);
+            g_object_unref (fd_list);
+        }
+        if (fd < 0 && !local_err)
+        {
+            g_set_error (&local_err, KALU_UPDATER_ERROR, 1,
+                    _("No packages table received\n"));
+        }
+    }
+    if (fd >= 0)
+    {
+        pkgs = read_packages_table (fd, &local_err);
+        close (fd);
+    }
+
+    if (local_err)
+    {
+        tt->cb (tt->kupdater, local_err->message, NULL, tt->data);
+        g_clear_error (&local_err);
+    }
+    else
+    {
+        if (tt->kupdater->priv->recorder)
+        {
+            record_packages (tt->kupdater, pkgs);
+        }
+        tt->cb (tt->kupdater, NULL, pkgs, tt->data);
+        free_packages (pkgs);
+    }
+
+    g_object_unref (tt->kupdater);
+    free (tt);
+}
+
+/* gets the fd of the packages table from kalu-dbus, without blocking the
+ * signal handler; the table is read and sent to cb once the call returns */
+static void
+take_packages_table (KaluUpdater             *kupdater,
+                     KaluGetPackagesCallback  cb,
+                     gpointer                 data)
+{
+    take_table_t *tt;
+
+    tt = new (take_table_t, 1);
+    tt->kupdater = g_object_ref (kupdater);
+    tt->cb = cb;
+    tt->data = data;
+
+    g_dbus_proxy_call_with_unix_fd_list (G_DBUS_PROXY (kupdater),
+            "TakePackagesTable",
+            NULL,
+            G_DBUS_CALL_FLAGS_NONE,
+            -1,
+            NULL,
+            NULL,
+            (GAsyncReadyCallback) take_packages_table_finish,
+            tt);
+}
+#endif /* HAVE_MEMFD_CREATE */
+
 #define emit_signal_answer(signal, ...)  do {                               \
     GError *error = NULL;                                                   \
     gboolean response = FALSE;                                              \
     g_signal_emit (kupdater, signals[signal], 0, __VA_ARGS__, &response);   \
+    if (kupdater->priv->driver)                                             \
+    {                                                                       \
+        break;                                                              \
+    }                                                                       \
     g_dbus_proxy_call_sync (G_DBUS_PROXY (kupdater),                        \
             "Answer",                                                       \
             g_variant_new ("(i)", (gint) response),                         \
@@ -340,6 +654,13 @@ kalu_updater_g_signal (GDBusProxy   *proxy,
                        GVariant     *parameters)
 {
     KaluUpdater *kupdater = KALU_UPDATER (proxy);
+
+    if (kupdater->priv->recorder
+            && g_strcmp0 (signal_name, "GetPackagesTable") != 0)
+    {
+        record_signal (kupdater, signal_name, parameters);
+    }
+
     if (g_strcmp0 (signal_name, "Debug") == 0)
     {
         gchar *msg;
@@ -456,68 +777,61 @@ kalu_updater_g_signal (GDBusProxy   *proxy,
     }
     else if (g_strcmp0 (signal_name, "GetPackagesFinished") == 0)
     {
+        KaluGetPackagesCallback cb;
+        gpointer data;
         GVariantIter *iter;
-        alpm_list_t *pkgs= NULL;
+        packages_t *pkgs = NULL;
 
-        method_callback_t *mc;
-        for (mc = kupdater->priv->method_callbacks; ; ++mc)
+        if (!take_get_packages_callback (kupdater, signal_name, &cb, &data))
         {
-            if (g_strcmp0 (mc->name, "GetPackages") == 0)
-            {
-                if (!mc->is_running)
-                {
-                    debug ("GetPackagesFinished: method not registered running\n");
-                    break;
-                }
-
-                KaluGetPackagesCallback cb = (KaluGetPackagesCallback) mc->callback;
-                gpointer data = mc->data;
+            return;
+        }
 
-                mc->is_running = FALSE;
-                mc->callback = NULL;
-                mc->data = NULL;
+        kalu_package_t *k_pkg;
+        const gchar *repo, *name, *desc, *old_version, *new_version;
+        guint dl_size, old_size, new_size;
+        g_variant_get (parameters, "(a(sssssuuu))", &iter);
+        /* strings aren't copied out of the variant, only interned */
+        while (g_variant_iter_next (iter, "(&s&s&s&s&suuu)",
+                    &repo,
+                    &name,
+                    &desc,
+                    &old_version,
+                    &new_version,
+                    &dl_size,
+                    &old_size,
+                    &new_size))
+        {
+            k_pkg = add_package (&pkgs);
+            k_pkg->repo = intern_str (pkgs, repo);
+            k_pkg->name = intern_str (pkgs, name);
+            k_pkg->desc = intern_str (pkgs, desc);
+            k_pkg->old_version = intern_str (pkgs, old_version);
+            k_pkg->new_version = intern_str (pkgs, new_version);
+            k_pkg->dl_size = dl_size;
+            k_pkg->old_size = old_size;
+            k_pkg->new_size = new_size;
+        }
+        g_variant_iter_free (iter);
 
-                kalu_package_t *k_pkg;
-                g_variant_get (parameters, "(a(sssssuuu))", &iter);
-                k_pkg = new0 (kalu_package_t, 1);
-                while (g_variant_iter_loop (iter, "(sssssuuu)",
-                            &k_pkg->repo,
-                            &k_pkg->name,
-                            &k_pkg->desc,
-                            &k_pkg->old_version,
-                            &k_pkg->new_version,
-                            &k_pkg->dl_size,
-                            &k_pkg->old_size,
-                            &k_pkg->new_size))
-                {
-                    pkgs = alpm_list_add (pkgs, k_pkg);
-                    k_pkg = new0 (kalu_package_t, 1);
-                }
-                g_variant_iter_free (iter);
-                free (k_pkg);
+        cb (kupdater, NULL, pkgs, data);
 
-                cb (kupdater, NULL, pkgs, data);
+        free_packages (pkgs);
+    }
+#ifdef HAVE_MEMFD_CREATE
+    else if (g_strcmp0 (signal_name, "GetPackagesTable") == 0)
+    {
+        KaluGetPackagesCallback cb;
+        gpointer data;
 
-                alpm_list_t *i;
-                for (i = pkgs; i; i = alpm_list_next (i))
-                {
-                    k_pkg = i->data;
-                    free (k_pkg->repo);
-                    free (k_pkg->name);
-                    free (k_pkg->desc);
-                    free (k_pkg->old_version);
-                    free (k_pkg->new_version);
-                    free (k_pkg);
-                }
-                alpm_list_free (pkgs);
-                break;
-            }
-            else if (mc->name == NULL)
-            {
-                debug ("GetPackagesFinished: Internal method definition missing\n");
-            }
+        if (!take_get_packages_callback (kupdater, signal_name, &cb, &data))
+        {
+            return;
         }
+
+        take_packages_table (kupdater, cb, data);
     }
+#endif
     else if (g_strcmp0 (signal_name, "SyncDbs") == 0)
     {
         gint nb;
@@ -884,6 +1198,274 @@ kalu_updater_g_signal (GDBusProxy   *proxy,
 }
 #undef emit_signal_answer
 
+/* replay */
+
+/* whether kalu-dbus could have sent the signal yet, i.e. the method it answers
+ * has been called by now */
+static gboolean
+replay_is_ready (KaluUpdater *kupdater, const gchar *signal_name,
+                 GVariant *parameters)
+{
+    method_callback_t *mc;
+    const gchar *name = NULL;
+    gboolean is_pkgs;
+
+    is_pkgs = streq (signal_name, "GetPackagesFinished");
+    if (streq (signal_name, "MethodFinished")
+            || streq (signal_name, "MethodFailed"))
+    {
+        g_variant_get_child (parameters, 0, "&s", &name);
+        if (streq (name, "Answer"))
+        {
+            return TRUE;
+        }
+    }
+    else if (!is_pkgs)
+    {
+        return TRUE;
+    }
+
+    for (mc = kupdater->priv->method_callbacks; mc->name; ++mc)
+    {
+        if (!mc->is_running)
+        {
+            continue;
+        }
+        if (is_pkgs && (streq (mc->name, "GetPackages")
+                    || streq (mc->name, "Setup")))
+        {
+            return TRUE;
+        }
+        if (name && streq (mc->name, name))
+        {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+static gint
+cmp_stats (gconstpointer a, gconstpointer b, gpointer stats)
+{
+    signal_stat_t *sa = g_hash_table_lookup (stats, a);
+    signal_stat_t *sb = g_hash_table_lookup (stats, b);
+
+    if (sa->total == sb->total)
+    {
+        return 0;
+    }
+    return (sa->total > sb->total) ? -1 : 1;
+}
+
+static void
+replay_report (replay_driver_t *driver)
+{
+    GString *str;
+    GList *names, *l;
+    signal_stat_t *stat;
+
+    str = g_string_new (
+            "Replay done, time spent in handlers & frame flushes (usec):\n");
+    g_string_append_printf (str, "%-28s %8s %10s %8s %8s\n",
+            "signal", "count", "total", "avg", "max");
+
+    names = g_hash_table_get_keys (driver->stats);
+    names = g_list_sort_with_data (names, cmp_stats, driver->stats);
+    for (l = names; l; l = l->next)
+    {
+        stat = g_hash_table_lookup (driver->stats, l->data);
+        g_string_append_printf (str, "%-28s %8u %10" G_GINT64_FORMAT
+                " %8" G_GINT64_FORMAT " %8" G_GINT64_FORMAT "\n",
+                (const gchar *) l->data,
+                stat->count,
+                stat->total,
+                stat->total / stat->count,
+                stat->max);
+    }
+    g_list_free (names);
+
+    debug ("%s", str->str);
+    fputs (str->str, stdout);
+    fflush (stdout);
+    g_string_free (str, TRUE);
+}
+
+static gboolean
+replay_load_next (replay_driver_t *driver)
+{
+    GError *local_err = NULL;
+
+    if (!replay_next (driver->replay, &driver->delay, &driver->signal_name,
+                &driver->parameters, &local_err))
+    {
+        if (local_err)
+        {
+            debug ("Replay aborted: %s", local_err->message);
+            g_clear_error (&local_err);
+        }
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static void
+replay_account (replay_driver_t *driver, const gchar *name, gint64 elapsed)
+{
+    signal_stat_t *stat;
+
+    stat = g_hash_table_lookup (driver->stats, name);
+    if (!stat)
+    {
+        stat = new0 (signal_stat_t, 1);
+        g_hash_table_insert (driver->stats, (gpointer) name, stat);
+    }
+    ++stat->count;
+    stat->total += elapsed;
+    if (elapsed > stat->max)
+    {
+        stat->max = elapsed;
+    }
+}
+
+static gboolean replay_feed (KaluUpdater *kupdater);
+
+static void
+replay_schedule (KaluUpdater *kupdater)
+{
+    replay_driver_t *driver = kupdater->priv->driver;
+
+    if (driver->max_speed || driver->delay < 1000)
+    {
+        driver->source = g_idle_add ((GSourceFunc) replay_feed, kupdater);
+    }
+    else
+    {
+        driver->source = g_timeout_add (driver->delay / 1000,
+                (GSourceFunc) replay_feed, kupdater);
+    }
+}
+
+static gboolean
+replay_feed (KaluUpdater *kupdater)
+{
+    replay_driver_t *driver = kupdater->priv->driver;
+    signal_stat_t *stat;
+    gint64 start, elapsed;
+
+    driver->source = 0;
+
+    if (!replay_is_ready (kupdater, driver->signal_name, driver->parameters))
+    {
+        /* resumed once the UI calls the method */
+        driver->paused = TRUE;
+        return G_SOURCE_REMOVE;
+    }
+
+    /* handlers might drop the last reference to us */
+    g_object_ref (kupdater);
+
+    start = g_get_monotonic_time ();
+    kalu_updater_g_signal (G_DBUS_PROXY (kupdater), NULL,
+            driver->signal_name, driver->parameters);
+    elapsed = g_get_monotonic_time () - start;
+
+    replay_account (driver, driver->signal_name, elapsed);
+
+    g_variant_unref (driver->parameters);
+    driver->parameters = NULL;
+
+    if (replay_load_next (driver))
+    {
+        replay_schedule (kupdater);
+    }
+    else
+    {
+        replay_report (driver);
+    }
+
+    g_object_unref (kupdater);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+replay_resume (KaluUpdater *kupdater)
+{
+    replay_driver_t *driver = kupdater->priv->driver;
+
+    if (driver->paused)
+    {
+        driver->paused = FALSE;
+        driver->source = g_idle_add ((GSourceFunc) replay_feed, kupdater);
+    }
+}
+
+KaluUpdater *
+kalu_updater_new_replay (const gchar *file, gboolean max_speed, GError **error)
+{
+    KaluUpdater *kupdater;
+    replay_driver_t *driver;
+    replay_t *replay;
+
+    replay = replay_new (file, error);
+    if (!replay)
+    {
+        return NULL;
+    }
+
+    /* never initialized, i.e. not connected to any bus */
+    kupdater = g_object_new (KALU_TYPE_UPDATER,
+            "g-flags",          G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES,
+            "g-interface-name", INTERFACE_NAME,
+            NULL);
+
+    driver = new0 (replay_driver_t, 1);
+    driver->replay = replay;
+    driver->max_speed = max_speed;
+    /* keys are signal names, owned by the replay, or static strings from
+     * kalu_updater_replay_account() */
+    driver->stats = g_hash_table_new_full (g_str_hash, g_str_equal,
+            NULL, free);
+    kupdater->priv->driver = driver;
+
+    if (!replay_load_next (driver))
+    {
+        g_set_error (error, KALU_UPDATER_ERROR, 1,
+                _("No signals to replay in %s\n"), file);
+        g_object_unref (kupdater);
+        return NULL;
+    }
+    replay_schedule (kupdater);
+
+    return kupdater;
+}
+
+void
+kalu_updater_replay_account (KaluUpdater *kupdater, const gchar *name,
+                             gint64 elapsed)
+{
+    if (kupdater->priv->driver)
+    {
+        replay_account (kupdater->priv->driver, name, elapsed);
+    }
+}
+
+gboolean
+kalu_updater_record (KaluUpdater *kupdater, const gchar *file, GError **error)
+{
+    if (kupdater->priv->recorder)
+    {
+        recorder_free (kupdater->priv->recorder);
+        kupdater->priv->recorder = NULL;
+    }
+    if (!file)
+    {
+        return TRUE;
+    }
+
+    kupdater->priv->recorder = recorder_new (file, error);
+    return kupdater->priv->recorder != NULL;
+}
+
 static void
 kalu_updater_class_init (KaluUpdaterClass *klass)
 {
@@ -1359,6 +1941,11 @@ abort_method (KaluUpdater *kupdater, const gchar *name)
     {                                                           \
         return FALSE;                                           \
     }                                                           \
+    if (kupdater->priv->driver)                                 \
+    {                                                           \
+        replay_resume (kupdater);                               \
+        return TRUE;                                            \
+    }                                                           \
 } while (0)
 
 #define end(name)     do {                  \
@@ -1374,6 +1961,8 @@ abort_method (KaluUpdater *kupdater, const gchar *name)
 /* Init */
 gboolean    kalu_updater_init_upd           (KaluUpdater        *kupdater,
                                              gboolean            downloadonly,
+                                             guint               rate,
+                                             guint               idle,
                                              GCancellable       *cancellable,
                                              KaluMethodCallback  callback,
                                              gpointer            data,
@@ -1384,7 +1973,7 @@ gboolean    kalu_updater_init_upd           (KaluUpdater        *kupdater,
 
     variant = g_dbus_proxy_call_sync (G_DBUS_PROXY (kupdater),
             "Init",
-            g_variant_new ("(b)", downloadonly),
+            g_variant_new ("(buu)", downloadonly, rate, idle),
             G_DBUS_CALL_FLAGS_NONE,
             -1,
             cancellable,
@@ -1497,6 +2086,95 @@ gboolean    kalu_updater_init_alpm          (KaluUpdater         *kupdater,
 }
 
 
+/* Setup */
+
+static GVariantBuilder *
+new_strings_builder (alpm_list_t *list)
+{
+    GVariantBuilder *builder;
+    alpm_list_t *i;
+
+    builder = g_variant_builder_new (G_VARIANT_TYPE ("as"));
+    FOR_LIST (i, list)
+    {
+        g_variant_builder_add (builder, "s", i->data);
+    }
+    return builder;
+}
+
+/* if flags include SETUP_GET_PACKAGES, callback is a KaluGetPackagesCallback */
+gboolean    kalu_updater_setup              (KaluUpdater         *kupdater,
+                                             pacman_config_t     *pac_conf,
+                                             gchar               *dbpath,
+                                             gchar               *logfile,
+                                             setup_flags_t        flags,
+                                             GCancellable        *cancellable,
+                                             KaluMethodCallback   callback,
+                                             gpointer             data,
+                                             GError             **error)
+{
+    GVariant *variant;
+    check ("Setup");
+
+    GVariantBuilder *builders[6];
+    GVariantBuilder *dbs_builder;
+    alpm_list_t *i;
+    int n;
+
+    builders[0] = new_strings_builder (pac_conf->hookdirs);
+    builders[1] = new_strings_builder (pac_conf->cachedirs);
+    builders[2] = new_strings_builder (pac_conf->ignorepkgs);
+    builders[3] = new_strings_builder (pac_conf->ignoregroups);
+    builders[4] = new_strings_builder (pac_conf->noupgrades);
+    builders[5] = new_strings_builder (pac_conf->noextracts);
+
+    dbs_builder = g_variant_builder_new (G_VARIANT_TYPE ("a(sias)"));
+    FOR_LIST (i, pac_conf->databases)
+    {
+        database_t *db_conf = i->data;
+        GVariantBuilder *servers_builder;
+
+        servers_builder = new_strings_builder (db_conf->servers);
+        g_variant_builder_add (dbs_builder, "(sias)",
+                db_conf->name,
+                db_conf->siglevel,
+                servers_builder);
+        g_variant_builder_unref (servers_builder);
+    }
+
+    variant = g_dbus_proxy_call_sync (G_DBUS_PROXY (kupdater),
+            "Setup",
+            g_variant_new ("(ssssasasisbbdasasasasa(sias)uu)",
+                pac_conf->rootdir,
+                dbpath,
+                logfile,
+                pac_conf->gpgdir,
+                builders[0],
+                builders[1],
+                pac_conf->siglevel,
+                pac_conf->arch,
+                pac_conf->checkspace,
+                pac_conf->usesyslog,
+                pac_conf->usedelta,
+                builders[2],
+                builders[3],
+                builders[4],
+                builders[5],
+                dbs_builder,
+                (guint) pac_conf->parallel_downloads,
+                (guint) flags),
+            G_DBUS_CALL_FLAGS_NONE,
+            -1,
+            cancellable,
+            error);
+
+    for (n = 0; n < 6; ++n)
+        g_variant_builder_unref (builders[n]);
+    g_variant_builder_unref (dbs_builder);
+    end ("Setup");
+}
+
+
 /* AddDb */
 
 gboolean    kalu_updater_add_db             (KaluUpdater         *kupdater,
@@ -30,6 +30,10 @@
 #include <alpm.h>
 #include <alpm_list.h>
 
+/* kalu */
+#include "conf.h"
+#include "../kalu-dbus/kupdater.h"
+
 typedef struct _provider_t {
     gchar *repo;
     gchar *pkg;
@@ -52,7 +56,7 @@ typedef struct _KaluUpdaterPrivate KaluUpdaterPrivate;
 typedef void (*KaluMethodCallback)      (KaluUpdater *updater, const gchar *errmsg,
                                          gpointer data);
 typedef void (*KaluGetPackagesCallback) (KaluUpdater *updater, const gchar *errmsg,
-                                         alpm_list_t *pkgs, gpointer data);
+                                         packages_t *pkgs, gpointer data);
 
 typedef struct _method_callback_t {
     const gchar        *name;
@@ -68,9 +72,25 @@ kalu_updater_new (GCancellable *cancellable, GAsyncReadyCallback callback, gpoin
 KaluUpdater *
 kalu_updater_new_finish (GAsyncResult *res, GError **error);
 
+/* replays signals recorded via kalu_updater_record(), without kalu-dbus */
+KaluUpdater *
+kalu_updater_new_replay (const gchar *file, gboolean max_speed, GError **error);
+
+/* when replaying, adds elapsed (usec) under name (a static string) to the
+ * report, for work done outside of signal handlers; no-op otherwise */
+void
+kalu_updater_replay_account (KaluUpdater *kupdater, const gchar *name,
+                             gint64 elapsed);
+
+/* record incoming signals to file; NULL stops recording */
+gboolean
+kalu_updater_record (KaluUpdater *kupdater, const gchar *file, GError **error);
+
 /* Init */
 gboolean    kalu_updater_init_upd           (KaluUpdater        *updater,
                                              gboolean            downloadonly,
+                                             guint               rate,
+                                             guint               idle,
                                              GCancellable       *cancellable,
                                              KaluMethodCallback  callback,
                                              gpointer            data,
@@ -100,6 +120,18 @@ gboolean    kalu_updater_init_alpm          (KaluUpdater         *kupdater,
                                              GError             **error);
 
 
+/* Setup */
+gboolean    kalu_updater_setup              (KaluUpdater         *kupdater,
+                                             pacman_config_t     *pac_conf,
+                                             gchar               *dbpath,
+                                             gchar               *logfile,
+                                             setup_flags_t        flags,
+                                             GCancellable        *cancellable,
+                                             KaluMethodCallback   callback,
+                                             gpointer             data,
+                                             GError             **error);
+
+
 /* AddDb */
 gboolean    kalu_updater_add_db             (KaluUpdater         *kupdater,
                                              gchar               *name,
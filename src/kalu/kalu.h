@@ -56,9 +56,8 @@
 
 #define KALU_ERROR              g_quark_from_static_string ("kalu error")
 
-#define FREE_PACKAGE_LIST(p)    do {                            \
-    alpm_list_free_inner (p, (alpm_list_fn_free) free_package); \
-    alpm_list_free (p);                                         \
+#define FREE_PACKAGES(p)        do {                            \
+    free_packages (p);                                          \
     p = NULL;                                                   \
 } while(0)
 
@@ -110,14 +109,17 @@ enum {
     IPv6
 };
 
-#ifdef ENABLE_STATUS_NOTIFIER
+/* tray icon variants; paused ones must follow the one they're made from */
 enum {
-    SN_ICON_KALU = 0,
-    SN_ICON_KALU_PAUSED,
-    SN_ICON_KALU_GRAY,
-    SN_ICON_KALU_GRAY_PAUSED,
-    NB_SN_ICONS
+    TRAY_ICON_KALU = 0,
+    TRAY_ICON_KALU_PAUSED,
+    TRAY_ICON_KALU_GRAY,
+    TRAY_ICON_KALU_GRAY_PAUSED,
+    NB_TRAY_ICONS
 };
+#define NB_ICON_SIZES           8
+
+#ifdef ENABLE_STATUS_NOTIFIER
 #define SN_ACTIVATE             1
 #define SN_SECONDARY_ACTIVATE   2
 #endif
@@ -202,6 +204,8 @@ typedef struct _config_t {
     int              use_ip;
     gboolean         auto_notifs;
     gboolean         notif_buttons;
+    char            *shared_dbs_dir;
+    int              shared_dbs_max_age;
 
     templates_t      templates[_NB_TPL];
 
@@ -211,7 +215,7 @@ typedef struct _config_t {
     alpm_list_t     *watched_aur;
 
     char            *news_last;
-    alpm_list_t     *news_read;
+    GHashTable      *news_read; /* set of titles */
 #ifndef DISABLE_GUI
     char            *cmdline_link;
 #endif
@@ -226,6 +230,7 @@ typedef struct _config_t {
     char            *color_warning;
     char            *color_error;
     gboolean         auto_show_log;
+    int              updater_resident;
 #endif
 } config_t;
 
@@ -245,6 +250,15 @@ typedef struct _kalu_package_t {
     guint    new_size; /* new installed size */
 } kalu_package_t;
 
+/* packages found by a check: stored contiguously, with all their strings
+ * interned in a chunk (so e.g. repos or versions are only stored once) */
+typedef struct _packages_t {
+    kalu_package_t  *pkgs;
+    guint            nb;
+    guint            alloc;
+    GStringChunk    *strings;
+} packages_t;
+
 typedef enum {
     SKIP_UNKNOWN = 0,
     SKIP_BEGIN,
@@ -268,11 +282,14 @@ typedef struct _kalpm_state_t {
     gint        nb_news;
 } kalpm_state_t;
 
+/* notifications about packages/news keep them (for news, titles are used as
+ * names), summary & text are only expanded when shown */
 typedef struct _notif_t {
     check_t     type;
     gchar      *summary;
     gchar      *text;
     gpointer    data;
+    packages_t *packages;
 } notif_t;
 
 /* global variable */
@@ -280,9 +297,14 @@ extern config_t *config;
 
 void debug (const char *fmt, ...);
 
-void free_package (kalu_package_t *package);
+kalu_package_t *add_package (packages_t **packages);
+char *intern_str (packages_t *packages, const char *s);
+void free_packages (packages_t *packages);
 void free_watched_package (watched_package_t *w_pkg);
 
 void kalu_check_work (gboolean is_auto);
+void compile_templates (void);
+void expand_notif (check_t type, const kalu_package_t *pkgs, guint nb,
+        gchar **summary, gchar **text);
 
 #endif /* _KALU_H */
@@ -0,0 +1,796 @@
+/**
+ * kalu - Copyright (C) 2012-2018 Olivier Brunel
+ *
+ * log-view.c
+ * Copyright (C) 2012-2018 Olivier Brunel <jjk@jjacky.com>
+ *
+ * This file is part of kalu.
+ *
+ * kalu is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * kalu is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * kalu. If not, see http://www.gnu.org/licenses/
+ */
+
+#include <config.h>
+
+/* C */
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+/* kalu */
+#include "kalu.h"
+#include "log-view.h"
+
+/* lines are stored in segments of (about) that size */
+#define SEGMENT_SIZE        (64 * 1024)
+/* left margin of text */
+#define PADDING             4
+/* lines scrolled per (wheel) step */
+#define SCROLL_LINES        3
+
+typedef struct _line_t {
+    guint32     segment;
+    guint32     offset;     /* within segment */
+    guint32     len;
+    guint32     level;
+} line_t;
+
+typedef struct _segment_t {
+    goffset     pos;        /* within the file */
+    guint32     size;
+    gchar      *data;       /* when it couldn't be written to the file */
+} segment_t;
+
+struct _log_view_t
+{
+    GtkWidget       *widget;
+    GtkWidget       *area;
+    GtkAdjustment   *vadj;  /* in lines */
+    GtkAdjustment   *hadj;  /* in pixels */
+    GdkRGBA         *colors;
+    gboolean        *has_color;
+    guint            nb_levels;
+    gint             line_height;
+    gint             max_width;
+    gboolean         follow;
+
+    /* store */
+    gint             fd;
+    goffset          fd_size;
+    GArray          *lines;
+    GArray          *segments;
+    GString         *tail;          /* segment being filled */
+    GString         *pending;       /* last line, until its newline */
+    guint            pending_level;
+    guint            cache_seg;
+    gchar           *cache;
+
+    /* filtering: line numbers shown, NULL when showing all lines */
+    guint            min_level;
+    GArray          *rows;
+
+    /* selection, as line numbers */
+    gboolean         has_sel;
+    guint            sel_start;
+    guint            sel_end;
+};
+
+static void
+flush_tail (log_view_t *lv)
+{
+    segment_t seg = { lv->fd_size, (guint32) lv->tail->len, NULL };
+
+    if (lv->fd >= 0)
+    {
+        gsize done = 0;
+        ssize_t r;
+
+        while (done < lv->tail->len)
+        {
+            r = pwrite (lv->fd, lv->tail->str + done, lv->tail->len - done,
+                    lv->fd_size + (goffset) done);
+            if (r < 0 && errno == EINTR)
+                continue;
+            if (r <= 0)
+                break;
+            done += (gsize) r;
+        }
+        if (done < lv->tail->len)
+        {
+            debug ("log-view: failed to write segment: %s", strerror (errno));
+            seg.data = g_strndup (lv->tail->str, lv->tail->len);
+        }
+        else
+            lv->fd_size += lv->tail->len;
+    }
+    else
+        seg.data = g_strndup (lv->tail->str, lv->tail->len);
+
+    g_array_append_val (lv->segments, seg);
+    g_string_truncate (lv->tail, 0);
+}
+
+/* invalid UTF-8 (e.g. from a scriptlet) is replaced, as pango requires it */
+static void
+append_valid (GString *str, const gchar *text, gsize len)
+{
+    const gchar *end;
+
+    while (!g_utf8_validate (text, (gssize) len, &end))
+    {
+        g_string_append_len (str, text, end - text);
+        g_string_append_c (str, '?');
+        len -= (gsize) (end - text) + 1;
+        text = end + 1;
+    }
+    g_string_append_len (str, text, (gssize) len);
+}
+
+static inline gboolean
+pending_shown (log_view_t *lv)
+{
+    return lv->pending->len > 0 && lv->pending_level >= lv->min_level;
+}
+
+static inline guint
+nb_rows (log_view_t *lv)
+{
+    return ((lv->rows) ? lv->rows->len : lv->lines->len)
+        + ((pending_shown (lv)) ? 1 : 0);
+}
+
+static inline guint
+row_to_line (log_view_t *lv, guint row)
+{
+    guint nb = (lv->rows) ? lv->rows->len : lv->lines->len;
+
+    if (row >= nb)
+        return lv->lines->len;
+    return (lv->rows) ? g_array_index (lv->rows, guint, row) : row;
+}
+
+static void
+commit_line (log_view_t *lv, const gchar *text, gsize len, guint level)
+{
+    line_t line;
+    guint n = lv->lines->len;
+
+    if (lv->tail->len > 0 && lv->tail->len + len > SEGMENT_SIZE)
+        flush_tail (lv);
+
+    line.segment = lv->segments->len;
+    line.offset = (guint32) lv->tail->len;
+    line.level = level;
+    append_valid (lv->tail, text, len);
+    line.len = (guint32) (lv->tail->len - line.offset);
+    g_array_append_val (lv->lines, line);
+
+    if (lv->rows && level >= lv->min_level)
+        g_array_append_val (lv->rows, n);
+}
+
+/* returned text is only valid until the next call */
+static const gchar *
+get_line (log_view_t *lv, guint n, guint32 *len, guint *level)
+{
+    line_t *line;
+    segment_t *seg;
+
+    if (n >= lv->lines->len)
+    {
+        *len = (guint32) lv->pending->len;
+        *level = lv->pending_level;
+        return lv->pending->str;
+    }
+
+    line = &g_array_index (lv->lines, line_t, n);
+    *len = line->len;
+    *level = line->level;
+    if (line->segment == lv->segments->len)
+        return lv->tail->str + line->offset;
+
+    seg = &g_array_index (lv->segments, segment_t, line->segment);
+    if (seg->data)
+        return seg->data + line->offset;
+
+    if (lv->cache_seg != line->segment)
+    {
+        gsize done = 0;
+        ssize_t r;
+
+        lv->cache = renew (gchar, seg->size, lv->cache);
+        while (done < seg->size)
+        {
+            r = pread (lv->fd, lv->cache + done, seg->size - done,
+                    seg->pos + (goffset) done);
+            if (r < 0 && errno == EINTR)
+                continue;
+            if (r <= 0)
+                break;
+            done += (gsize) r;
+        }
+        if (done < seg->size)
+        {
+            debug ("log-view: failed to read segment %u: %s",
+                    line->segment, strerror (errno));
+            lv->cache_seg = G_MAXUINT;
+            *len = 0;
+            return "";
+        }
+        lv->cache_seg = line->segment;
+    }
+    return lv->cache + line->offset;
+}
+
+static void
+update_vadj (log_view_t *lv)
+{
+    gdouble page;
+    gdouble upper;
+    gdouble value;
+
+    page = (gdouble) gtk_widget_get_allocated_height (lv->area)
+        / (gdouble) lv->line_height;
+    upper = (gdouble) nb_rows (lv);
+    value = (lv->follow) ? upper - page : gtk_adjustment_get_value (lv->vadj);
+    gtk_adjustment_configure (lv->vadj, MAX (value, 0.0), 0.0, upper,
+            1.0, MAX (page - 1.0, 1.0), page);
+}
+
+static void
+update_hadj (log_view_t *lv)
+{
+    gdouble page = (gdouble) gtk_widget_get_allocated_width (lv->area);
+
+    gtk_adjustment_configure (lv->hadj, gtk_adjustment_get_value (lv->hadj),
+            0.0, (gdouble) (lv->max_width + 2 * PADDING),
+            (gdouble) lv->line_height, page, page);
+}
+
+static void
+scroll_to_row (log_view_t *lv, guint row)
+{
+    gdouble page = gtk_adjustment_get_page_size (lv->vadj);
+    gdouble value = gtk_adjustment_get_value (lv->vadj);
+
+    if ((gdouble) row < value || (gdouble) row + 1.0 > value + page)
+        gtk_adjustment_set_value (lv->vadj, (gdouble) row - page / 2.0);
+}
+
+static guint
+line_to_row (log_view_t *lv, guint line)
+{
+    guint lo, hi, mid;
+
+    if (!lv->rows || line >= lv->lines->len)
+        return MIN (line, nb_rows (lv) - 1);
+
+    /* rows are sorted, find the first one showing line or after it */
+    lo = 0;
+    hi = lv->rows->len;
+    while (lo < hi)
+    {
+        mid = (lo + hi) / 2;
+        if (g_array_index (lv->rows, guint, mid) < line)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return MIN (lo, nb_rows (lv) - 1);
+}
+
+static gboolean
+draw_cb (GtkWidget *area, cairo_t *cr, log_view_t *lv)
+{
+    GtkStyleContext *context;
+    PangoLayout *layout;
+    GdkRGBA fg, color;
+    gint width, height, w;
+    gdouble value, x, y;
+    guint nb, row, line, level, first, last;
+    guint32 len;
+    const gchar *text;
+    gint max_width = lv->max_width;
+
+    context = gtk_widget_get_style_context (area);
+    width = gtk_widget_get_allocated_width (area);
+    height = gtk_widget_get_allocated_height (area);
+    gtk_render_background (context, cr, 0, 0, width, height);
+    gtk_style_context_get_color (context, gtk_style_context_get_state (context),
+            &fg);
+
+    first = MIN (lv->sel_start, lv->sel_end);
+    last = MAX (lv->sel_start, lv->sel_end);
+
+    layout = gtk_widget_create_pango_layout (area, NULL);
+    value = gtk_adjustment_get_value (lv->vadj);
+    x = PADDING - gtk_adjustment_get_value (lv->hadj);
+    nb = nb_rows (lv);
+    for (row = (guint) value, y = -(value - (gdouble) row) * lv->line_height;
+            row < nb && y < height;
+            ++row, y += lv->line_height)
+    {
+        line = row_to_line (lv, row);
+        text = get_line (lv, line, &len, &level);
+
+        if (lv->has_sel && line >= first && line <= last)
+        {
+            gtk_style_context_save (context);
+            gtk_style_context_set_state (context, GTK_STATE_FLAG_SELECTED);
+            gtk_render_background (context, cr, 0, y, width, lv->line_height);
+            gtk_style_context_get_color (context, GTK_STATE_FLAG_SELECTED,
+                    &color);
+            gtk_style_context_restore (context);
+        }
+        else if (level < lv->nb_levels && lv->has_color[level])
+            color = lv->colors[level];
+        else
+            color = fg;
+
+        pango_layout_set_text (layout, text, (gint) len);
+        pango_layout_get_pixel_size (layout, &w, NULL);
+        if (w > max_width)
+            max_width = w;
+
+        gdk_cairo_set_source_rgba (cr, &color);
+        cairo_move_to (cr, x, y);
+        pango_cairo_show_layout (cr, layout);
+    }
+    g_object_unref (layout);
+
+    /* only lines drawn so far are measured */
+    if (max_width > lv->max_width)
+    {
+        lv->max_width = max_width;
+        update_hadj (lv);
+    }
+
+    return FALSE;
+}
+
+static void
+size_allocate_cb (GtkWidget *area _UNUSED_, GdkRectangle *alloc _UNUSED_,
+                  log_view_t *lv)
+{
+    update_vadj (lv);
+    update_hadj (lv);
+}
+
+static void
+style_updated_cb (GtkWidget *area, log_view_t *lv)
+{
+    PangoLayout *layout;
+
+    layout = gtk_widget_create_pango_layout (area, "Xg");
+    pango_layout_get_pixel_size (layout, NULL, &lv->line_height);
+    g_object_unref (layout);
+    if (lv->line_height <= 0)
+        lv->line_height = 1;
+    lv->max_width = 0;
+    update_vadj (lv);
+    update_hadj (lv);
+}
+
+static void
+vadj_changed_cb (GtkAdjustment *adj, log_view_t *lv)
+{
+    gdouble value = gtk_adjustment_get_value (adj);
+    gdouble upper = gtk_adjustment_get_upper (adj);
+    gdouble page = gtk_adjustment_get_page_size (adj);
+
+    /* keep showing new lines as long as we're at the bottom */
+    lv->follow = value + page >= upper - 0.5;
+    gtk_widget_queue_draw (lv->area);
+}
+
+static void
+hadj_changed_cb (GtkAdjustment *adj _UNUSED_, log_view_t *lv)
+{
+    gtk_widget_queue_draw (lv->area);
+}
+
+static gboolean
+scroll_cb (GtkWidget *area _UNUSED_, GdkEventScroll *event, log_view_t *lv)
+{
+    gdouble dx = 0.0, dy = 0.0;
+
+    switch (event->direction)
+    {
+        case GDK_SCROLL_UP:
+            dy = -1.0;
+            break;
+        case GDK_SCROLL_DOWN:
+            dy = 1.0;
+            break;
+        case GDK_SCROLL_LEFT:
+            dx = -1.0;
+            break;
+        case GDK_SCROLL_RIGHT:
+            dx = 1.0;
+            break;
+        case GDK_SCROLL_SMOOTH:
+            gdk_event_get_scroll_deltas ((GdkEvent *) event, &dx, &dy);
+            break;
+    }
+
+    if (dy != 0.0)
+        gtk_adjustment_set_value (lv->vadj,
+                gtk_adjustment_get_value (lv->vadj) + dy * SCROLL_LINES);
+    if (dx != 0.0)
+        gtk_adjustment_set_value (lv->hadj,
+                gtk_adjustment_get_value (lv->hadj)
+                + dx * SCROLL_LINES * lv->line_height);
+    return TRUE;
+}
+
+static gboolean
+row_at_y (log_view_t *lv, gdouble y, guint *row)
+{
+    gdouble r;
+    guint nb = nb_rows (lv);
+
+    if (nb == 0)
+        return FALSE;
+    r = gtk_adjustment_get_value (lv->vadj) + y / lv->line_height;
+    *row = (r < 0.0) ? 0 : MIN ((guint) r, nb - 1);
+    return TRUE;
+}
+
+static gboolean
+button_press_cb (GtkWidget *area, GdkEventButton *event, log_view_t *lv)
+{
+    guint row;
+
+    if (event->button != 1 || event->type != GDK_BUTTON_PRESS)
+        return FALSE;
+
+    gtk_widget_grab_focus (area);
+    if (!row_at_y (lv, event->y, &row))
+        return TRUE;
+
+    lv->sel_end = row_to_line (lv, row);
+    if (!lv->has_sel || !(event->state & GDK_SHIFT_MASK))
+        lv->sel_start = lv->sel_end;
+    lv->has_sel = TRUE;
+    gtk_widget_queue_draw (area);
+    return TRUE;
+}
+
+static gboolean
+motion_notify_cb (GtkWidget *area, GdkEventMotion *event, log_view_t *lv)
+{
+    guint row;
+
+    if (!(event->state & GDK_BUTTON1_MASK) || !lv->has_sel
+            || !row_at_y (lv, event->y, &row))
+        return FALSE;
+
+    lv->sel_end = row_to_line (lv, row);
+    scroll_to_row (lv, row);
+    gtk_widget_queue_draw (area);
+    return TRUE;
+}
+
+static void
+copy_selection (log_view_t *lv)
+{
+    GString *str;
+    const gchar *text;
+    guint32 len;
+    guint line, level, last;
+
+    if (!lv->has_sel)
+        return;
+
+    str = g_string_new (NULL);
+    last = MAX (lv->sel_start, lv->sel_end);
+    for (line = MIN (lv->sel_start, lv->sel_end); line <= last; ++line)
+    {
+        text = get_line (lv, line, &len, &level);
+        if (level < lv->min_level)
+            continue;
+        g_string_append_len (str, text, (gssize) len);
+        g_string_append_c (str, '\n');
+        if (line >= lv->lines->len)
+            break;
+    }
+    gtk_clipboard_set_text (gtk_clipboard_get (GDK_SELECTION_CLIPBOARD),
+            str->str, (gint) str->len);
+    g_string_free (str, TRUE);
+}
+
+static gboolean
+key_press_cb (GtkWidget *area, GdkEventKey *event, log_view_t *lv)
+{
+    gdouble page = gtk_adjustment_get_page_size (lv->vadj);
+    gdouble value = gtk_adjustment_get_value (lv->vadj);
+
+    if (event->state & GDK_CONTROL_MASK)
+    {
+        if (event->keyval == GDK_KEY_c)
+            copy_selection (lv);
+        else if (event->keyval == GDK_KEY_a && nb_rows (lv) > 0)
+        {
+            lv->has_sel = TRUE;
+            lv->sel_start = 0;
+            lv->sel_end = row_to_line (lv, nb_rows (lv) - 1);
+            gtk_widget_queue_draw (area);
+        }
+        else if (event->keyval == GDK_KEY_Home)
+            gtk_adjustment_set_value (lv->vadj, 0.0);
+        else if (event->keyval == GDK_KEY_End)
+            gtk_adjustment_set_value (lv->vadj, (gdouble) nb_rows (lv));
+        else
+            return FALSE;
+        return TRUE;
+    }
+
+    switch (event->keyval)
+    {
+        case GDK_KEY_Up:
+            gtk_adjustment_set_value (lv->vadj, value - 1.0);
+            break;
+        case GDK_KEY_Down:
+            gtk_adjustment_set_value (lv->vadj, value + 1.0);
+            break;
+        case GDK_KEY_Page_Up:
+            gtk_adjustment_set_value (lv->vadj, value - page);
+            break;
+        case GDK_KEY_Page_Down:
+            gtk_adjustment_set_value (lv->vadj, value + page);
+            break;
+        default:
+            return FALSE;
+    }
+    return TRUE;
+}
+
+static void
+free_log_view (log_view_t *lv)
+{
+    guint i;
+
+    g_signal_handlers_disconnect_by_data (lv->vadj, lv);
+    g_signal_handlers_disconnect_by_data (lv->hadj, lv);
+    if (lv->fd >= 0)
+        close (lv->fd);
+    for (i = 0; i < lv->segments->len; ++i)
+        g_free (g_array_index (lv->segments, segment_t, i).data);
+    g_array_free (lv->segments, TRUE);
+    g_array_free (lv->lines, TRUE);
+    if (lv->rows)
+        g_array_free (lv->rows, TRUE);
+    g_string_free (lv->tail, TRUE);
+    g_string_free (lv->pending, TRUE);
+    free (lv->cache);
+    free (lv->colors);
+    free (lv->has_color);
+    free (lv);
+}
+
+log_view_t *
+log_view_new (const gchar **colors, guint nb_levels)
+{
+    GError *error = NULL;
+    log_view_t *lv;
+    GtkWidget *grid;
+    GtkWidget *scrollbar;
+    gchar *file;
+    guint i;
+
+    lv = new0 (log_view_t, 1);
+    lv->follow = TRUE;
+    lv->line_height = 1;
+    lv->cache_seg = G_MAXUINT;
+    lv->lines = g_array_new (FALSE, FALSE, sizeof (line_t));
+    lv->segments = g_array_new (FALSE, FALSE, sizeof (segment_t));
+    lv->tail = g_string_sized_new (SEGMENT_SIZE);
+    lv->pending = g_string_new (NULL);
+
+    lv->nb_levels = nb_levels;
+    lv->colors = new0 (GdkRGBA, nb_levels);
+    lv->has_color = new0 (gboolean, nb_levels);
+    for (i = 0; i < nb_levels; ++i)
+        lv->has_color[i] = colors[i]
+            && gdk_rgba_parse (&lv->colors[i], colors[i]);
+
+    /* nothing but us will ever see it, so unlink right away; if that fails we
+     * keep it all in memory */
+    lv->fd = g_file_open_tmp ("kalu-log-XXXXXX", &file, &error);
+    if (lv->fd < 0)
+    {
+        debug ("log-view: no temporary file, keeping log in memory: %s",
+                error->message);
+        g_clear_error (&error);
+    }
+    else
+    {
+        unlink (file);
+        g_free (file);
+    }
+
+    grid = gtk_grid_new ();
+    lv->widget = grid;
+
+    lv->vadj = gtk_adjustment_new (0.0, 0.0, 0.0, 1.0, 1.0, 1.0);
+    lv->hadj = gtk_adjustment_new (0.0, 0.0, 0.0, 1.0, 1.0, 1.0);
+
+    lv->area = gtk_drawing_area_new ();
+    gtk_widget_set_hexpand (lv->area, TRUE);
+    gtk_widget_set_vexpand (lv->area, TRUE);
+    gtk_widget_set_can_focus (lv->area, TRUE);
+    gtk_widget_add_events (lv->area, GDK_SCROLL_MASK | GDK_SMOOTH_SCROLL_MASK
+            | GDK_BUTTON_PRESS_MASK | GDK_BUTTON_MOTION_MASK
+            | GDK_KEY_PRESS_MASK);
+    gtk_style_context_add_class (gtk_widget_get_style_context (lv->area),
+            GTK_STYLE_CLASS_VIEW);
+    gtk_grid_attach (GTK_GRID (grid), lv->area, 0, 0, 1, 1);
+    gtk_widget_show (lv->area);
+
+    scrollbar = gtk_scrollbar_new (GTK_ORIENTATION_VERTICAL, lv->vadj);
+    gtk_grid_attach (GTK_GRID (grid), scrollbar, 1, 0, 1, 1);
+    gtk_widget_show (scrollbar);
+
+    scrollbar = gtk_scrollbar_new (GTK_ORIENTATION_HORIZONTAL, lv->hadj);
+    gtk_grid_attach (GTK_GRID (grid), scrollbar, 0, 1, 1, 1);
+    gtk_widget_show (scrollbar);
+
+    g_signal_connect (G_OBJECT (lv->area), "draw",
+            G_CALLBACK (draw_cb), lv);
+    g_signal_connect (G_OBJECT (lv->area), "size-allocate",
+            G_CALLBACK (size_allocate_cb), lv);
+    g_signal_connect (G_OBJECT (lv->area), "style-updated",
+            G_CALLBACK (style_updated_cb), lv);
+    g_signal_connect (G_OBJECT (lv->area), "scroll-event",
+            G_CALLBACK (scroll_cb), lv);
+    g_signal_connect (G_OBJECT (lv->area), "button-press-event",
+            G_CALLBACK (button_press_cb), lv);
+    g_signal_connect (G_OBJECT (lv->area), "motion-notify-event",
+            G_CALLBACK (motion_notify_cb), lv);
+    g_signal_connect (G_OBJECT (lv->area), "key-press-event",
+            G_CALLBACK (key_press_cb), lv);
+    g_signal_connect_swapped (G_OBJECT (lv->area), "destroy",
+            G_CALLBACK (free_log_view), lv);
+    g_signal_connect (G_OBJECT (lv->vadj), "value-changed",
+            G_CALLBACK (vadj_changed_cb), lv);
+    g_signal_connect (G_OBJECT (lv->hadj), "value-changed",
+            G_CALLBACK (hadj_changed_cb), lv);
+
+    style_updated_cb (lv->area, lv);
+
+    return lv;
+}
+
+GtkWidget *
+log_view_get_widget (log_view_t *lv)
+{
+    return lv->widget;
+}
+
+void
+log_view_append (log_view_t *lv, guint level, const gchar *text)
+{
+    const gchar *nl;
+    guint before = nb_rows (lv);
+    gdouble bottom;
+
+    bottom = gtk_adjustment_get_value (lv->vadj)
+        + gtk_adjustment_get_page_size (lv->vadj);
+
+    for ( ; *text; text = nl + 1)
+    {
+        nl = strchr (text, '\n');
+        if (!nl)
+        {
+            if (lv->pending->len == 0)
+                lv->pending_level = level;
+            g_string_append (lv->pending, text);
+            break;
+        }
+
+        if (lv->pending->len > 0)
+        {
+            g_string_append_len (lv->pending, text, nl - text);
+            commit_line (lv, lv->pending->str, lv->pending->len,
+                    lv->pending_level);
+            g_string_truncate (lv->pending, 0);
+        }
+        else
+            commit_line (lv, text, (gsize) (nl - text), level);
+    }
+
+    /* when following, vadj_changed_cb() takes care of redrawing */
+    update_vadj (lv);
+    if ((gdouble) before < bottom + 1.0)
+        gtk_widget_queue_draw (lv->area);
+}
+
+void
+log_view_set_min_level (log_view_t *lv, guint level)
+{
+    guint i;
+
+    if (level == lv->min_level)
+        return;
+
+    lv->min_level = level;
+    if (lv->rows)
+    {
+        g_array_free (lv->rows, TRUE);
+        lv->rows = NULL;
+    }
+    if (level > 0)
+    {
+        /* only the index is scanned */
+        lv->rows = g_array_new (FALSE, FALSE, sizeof (guint));
+        for (i = 0; i < lv->lines->len; ++i)
+            if (g_array_index (lv->lines, line_t, i).level >= level)
+                g_array_append_val (lv->rows, i);
+    }
+
+    update_vadj (lv);
+    if (!lv->follow && lv->has_sel && nb_rows (lv) > 0)
+        scroll_to_row (lv, line_to_row (lv, lv->sel_end));
+    gtk_widget_queue_draw (lv->area);
+}
+
+static gboolean
+contains (const gchar *text, guint32 len, const gchar *needle, gsize nlen)
+{
+    const gchar *s;
+
+    if (nlen > len)
+        return FALSE;
+    for (s = text; s <= text + len - nlen; ++s)
+        if (g_ascii_strncasecmp (s, needle, nlen) == 0)
+            return TRUE;
+    return FALSE;
+}
+
+/* looks for the next/previous line containing needle (ignoring case), from the
+ * selected line, or the top of the view. Lines are read in order, so each
+ * segment is loaded (at most) once */
+gboolean
+log_view_search (log_view_t *lv, const gchar *needle, gboolean backwards)
+{
+    const gchar *text;
+    guint32 len;
+    guint nb, start, row, line, level, i;
+    gsize nlen = strlen (needle);
+
+    nb = nb_rows (lv);
+    if (nb == 0 || nlen == 0)
+        return FALSE;
+
+    if (lv->has_sel)
+        start = line_to_row (lv, lv->sel_end);
+    else
+        start = (guint) gtk_adjustment_get_value (lv->vadj)
+            + ((backwards) ? 0 : nb - 1);
+
+    for (i = 1; i <= nb; ++i)
+    {
+        row = (backwards) ? (start + nb - i % nb) % nb : (start + i) % nb;
+        line = row_to_line (lv, row);
+        text = get_line (lv, line, &len, &level);
+        if (contains (text, len, needle, nlen))
+        {
+            lv->has_sel = TRUE;
+            lv->sel_start = lv->sel_end = line;
+            scroll_to_row (lv, row);
+            gtk_widget_queue_draw (lv->area);
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
@@ -0,0 +1,53 @@
+/**
+ * kalu - Copyright (C) 2012-2018 Olivier Brunel
+ *
+ * log-view.h
+ * Copyright (C) 2012-2018 Olivier Brunel <jjk@jjacky.com>
+ *
+ * This file is part of kalu.
+ *
+ * kalu is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * kalu is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * kalu. If not, see http://www.gnu.org/licenses/
+ */
+
+#ifndef _KALU_LOG_VIEW_H
+#define _KALU_LOG_VIEW_H
+
+/* gtk */
+#include <gtk/gtk.h>
+
+/* Read-only view of a (possibly huge) log: lines are kept in segments spilled
+ * to an unlinked temporary file, only an index of line offsets stays in
+ * memory, and only the visible lines are ever laid out/drawn.
+ * Each line has a level (0 being the lowest), used for colors & filtering. */
+
+typedef struct _log_view_t log_view_t;
+
+/* colors[level] can be NULL to use the theme's text color. The log view is
+ * freed alongside its widget */
+log_view_t *
+log_view_new (const gchar **colors, guint nb_levels);
+
+GtkWidget *
+log_view_get_widget (log_view_t *lv);
+
+void
+log_view_append (log_view_t *lv, guint level, const gchar *text);
+
+void
+log_view_set_min_level (log_view_t *lv, guint level);
+
+gboolean
+log_view_search (log_view_t *lv, const gchar *needle, gboolean backwards);
+
+#endif /* _KALU_LOG_VIEW_H */
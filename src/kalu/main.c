@@ -53,6 +53,9 @@
 #ifndef DISABLE_GUI
 #include "gui.h"
 #include "util-gtk.h"
+#ifndef DISABLE_UPDATER
+#include "updater.h"
+#endif
 #endif
 #include "kalu-alpm.h"
 #include "conf.h"
@@ -86,8 +89,13 @@ const gchar *tpl_sce_names[_NB_TPL_SCE] = {
 };
 
 
-static void notify_updates (alpm_list_t *packages, check_t type,
-        gchar *xml_news, gboolean show_it);
+/* templates, compiled from config (see compile_templates) */
+static compiled_tpl_t *compiled_tpls[_NB_TPL][_NB_FLD];
+/* buffer size for a humanized size */
+#define SIZE_LEN        32
+
+static void notify_updates (packages_t *packages, check_t type,
+        gboolean show_it);
 static void free_config (void);
 
 #ifdef DISABLE_GUI
@@ -182,41 +190,67 @@ get_fld_value (tpl_t tpl, unsigned int fld)
     }
 }
 
-static void
-notify_updates (
-        alpm_list_t *packages,
-        check_t      type,
-        gchar       *xml_news,
-        gboolean     show_it
-        )
+void
+compile_templates (void)
 {
-    alpm_list_t     *i;
+    static const tpl_var_t vars_title[] = {
+        TPL_VAR_NB, TPL_VAR_DL, TPL_VAR_NET, TPL_VAR_INS, TPL_VAR_LITERAL
+    };
+    static const tpl_var_t vars_title_news[] = {
+        TPL_VAR_NB, TPL_VAR_LITERAL
+    };
+    static const tpl_var_t vars_package[] = {
+        TPL_VAR_REPO, TPL_VAR_PKG, TPL_VAR_OLD, TPL_VAR_NEW, TPL_VAR_DL,
+        TPL_VAR_INS, TPL_VAR_NET, TPL_VAR_DESC, TPL_VAR_LITERAL
+    };
+    static const tpl_var_t vars_package_news[] = {
+        TPL_VAR_NEWS, TPL_VAR_LITERAL
+    };
+    /* separator is used as is */
+    static const tpl_var_t vars_sep[] = { TPL_VAR_LITERAL };
+    int tpl, fld;
+
+    for (tpl = 0; tpl < _NB_TPL; ++tpl)
+    {
+        for (fld = 0; fld < _NB_FLD; ++fld)
+            free_compiled_tpl (compiled_tpls[tpl][fld]);
+
+        compiled_tpls[tpl][FLD_TITLE] = compile_tpl (
+                get_fld_value ((tpl_t) tpl, FLD_TITLE),
+                (tpl == TPL_NEWS) ? vars_title_news : vars_title);
+        compiled_tpls[tpl][FLD_PACKAGE] = compile_tpl (
+                get_fld_value ((tpl_t) tpl, FLD_PACKAGE),
+                (tpl == TPL_NEWS) ? vars_package_news : vars_package);
+        compiled_tpls[tpl][FLD_SEP] = compile_tpl (
+                get_fld_value ((tpl_t) tpl, FLD_SEP),
+                vars_sep);
+    }
+    debug ("templates compiled");
+}
 
-    unsigned int     nb          = 0;
+void
+expand_notif (check_t type, const kalu_package_t *pkgs, guint nb,
+              gchar **summary, gchar **text)
+{
+    unsigned int     n;
     int              net_size;
     off_t            dsize       = 0;
     off_t            isize       = 0;
     off_t            nsize       = 0;
 
-    gchar           *summary;
-    gchar           *text = NULL;
-    unsigned int     alloc;
-    unsigned int     len;
-    char             buf[255];
+    size_t           len         = 0;
     char            *s;
-    const char      *b;
-    const char      *fields[_NB_FLD];
+    char             buf[4][SIZE_LEN];
+    char            *sizes       = NULL;
+    const char     **values      = NULL;
+    const char      *title_values[_NB_TPL_VARS] = { NULL };
+    compiled_tpl_t  *ctpl[_NB_FLD];
     tpl_t            tpl;
     const char      *unit;
     double           size_h;
-    replacement_t   *replacements[9];
     gboolean         escaping = FALSE;
-    GString         *string_pkgs = NULL;     /* list of AUR packages */
 
-#ifdef DISABLE_GUI
-    (void) xml_news;
-    (void) show_it;
-#else
+#ifndef DISABLE_GUI
     escaping = !is_cli;
 #endif
 
@@ -225,12 +259,7 @@ notify_updates (
     else if (type & CHECK_WATCHED)
         tpl = TPL_WATCHED;
     else if (type & CHECK_AUR)
-    {
         tpl = TPL_AUR;
-        /* if needed, init the string that will hold the list of packages */
-        if (config->cmdline_aur)
-            string_pkgs = g_string_sized_new (255);
-    }
     else if (type & CHECK_WATCHED_AUR)
         tpl = TPL_WATCHED_AUR;
     else if (type & CHECK_NEWS)
@@ -238,240 +267,179 @@ notify_updates (
     else /* _CHECK_AUR_NOT_FOUND */
         tpl = TPL_AUR_NOT_FOUND;
 
-    fields[FLD_TITLE]   = get_fld_value (tpl, FLD_TITLE);
-    fields[FLD_PACKAGE] = get_fld_value (tpl, FLD_PACKAGE);
-    fields[FLD_SEP]     = get_fld_value (tpl, FLD_SEP);
+    ctpl[FLD_TITLE]   = compiled_tpls[tpl][FLD_TITLE];
+    ctpl[FLD_PACKAGE] = compiled_tpls[tpl][FLD_PACKAGE];
+    ctpl[FLD_SEP]     = compiled_tpls[tpl][FLD_SEP];
 
-    if (fields[FLD_PACKAGE] || string_pkgs)
+    if (text)
+        *text = NULL;
+    if (text && ctpl[FLD_PACKAGE] && nb > 0)
     {
-        if (fields[FLD_PACKAGE])
-        {
-            alloc = 1024;
-            text = new (gchar, alloc + 1);
-            len = 0;
-        }
+        /* all values are gathered first, so the text can be sized exactly */
+        values = new0 (const char *, nb * _NB_TPL_VARS);
+        if (ctpl[FLD_PACKAGE]->used & (TPL_VAR_BIT (TPL_VAR_DL)
+                    | TPL_VAR_BIT (TPL_VAR_INS) | TPL_VAR_BIT (TPL_VAR_NET)))
+            sizes = new (char, nb * 3 * SIZE_LEN);
+        len = (nb - 1) * tpl_expand_len (ctpl[FLD_SEP], NULL, FALSE);
+    }
+
+    for (n = 0; n < nb; ++n)
+    {
+        const kalu_package_t *pkg = &pkgs[n];
+        const char **v = (values) ? values + n * _NB_TPL_VARS : NULL;
 
-        FOR_LIST (i, packages)
+        if (type & CHECK_NEWS)
         {
-            ++nb;
-            if (type & CHECK_NEWS)
+            if (v)
             {
-                replacements[0] = new0 (replacement_t, 1);
-                replacements[0]->name = "NEWS";
-                replacements[0]->value = i->data;
-                replacements[0]->need_escaping = TRUE;
-                replacements[1] = NULL;
-
-                /* add separator? */
-                if (nb > 1 && fields[FLD_SEP])
-                {
-                    s = text + len;
-                    for (b = fields[FLD_SEP]; *b; ++b, ++s, ++len)
-                    {
-                        *s = *b;
-                    }
-                }
-
-                parse_tpl (fields[FLD_PACKAGE], &text, &len, &alloc,
-                        replacements, escaping);
-
-                free (replacements[0]);
-
-                debug ("-> %s", (char *) i->data);
+                v[TPL_VAR_NEWS] = pkg->name;
+                len += tpl_expand_len (ctpl[FLD_PACKAGE], v, escaping);
             }
-            else
-            {
-                kalu_package_t *pkg = i->data;
-
-                if (fields[FLD_PACKAGE])
-                {
-                    int j;
-
-                    net_size = (int) (pkg->new_size - pkg->old_size);
-                    dsize += pkg->dl_size;
-                    isize += pkg->new_size;
-                    nsize += net_size;
-
-                    replacements[0] = new0 (replacement_t, 1);
-                    replacements[0]->name = "REPO";
-                    replacements[0]->value = (pkg->repo) ? pkg->repo : (char *) "-";
-                    replacements[0]->need_escaping = TRUE;
-                    replacements[1] = new0 (replacement_t, 1);
-                    replacements[1]->name = "PKG";
-                    replacements[1]->value = pkg->name;
-                    replacements[1]->need_escaping = TRUE;
-                    replacements[2] = new0 (replacement_t, 1);
-                    replacements[2]->name = "OLD";
-                    replacements[2]->value = pkg->old_version;
-                    replacements[3] = new0 (replacement_t, 1);
-                    replacements[3]->name = "NEW";
-                    replacements[3]->value = pkg->new_version;
-                    replacements[4] = new0 (replacement_t, 1);
-                    replacements[4]->name = "DL";
-                    size_h = humanize_size (pkg->dl_size, '\0', &unit);
-                    snprint_size (buf, 255, size_h, unit);
-                    replacements[4]->value = strdup (buf);
-                    replacements[5] = new0 (replacement_t, 1);
-                    replacements[5]->name = "INS";
-                    size_h = humanize_size (pkg->new_size, '\0', &unit);
-                    snprint_size (buf, 255, size_h, unit);
-                    replacements[5]->value = strdup (buf);
-                    replacements[6] = new0 (replacement_t, 1);
-                    replacements[6]->name = "NET";
-                    size_h = humanize_size (net_size, '\0', &unit);
-                    snprint_size (buf, 255, size_h, unit);
-                    replacements[6]->value = strdup (buf);
-                    replacements[7] = new0 (replacement_t, 1);
-                    replacements[7]->name = "DESC";
-                    replacements[7]->value = pkg->desc;
-                    replacements[7]->need_escaping = TRUE;
-                    replacements[8] = NULL;
-
-                    /* add separator? */
-                    if (nb > 1 && fields[FLD_SEP])
-                    {
-                        s = text + len;
-                        for (b = fields[FLD_SEP]; *b; ++b, ++s, ++len)
-                        {
-                            *s = *b;
-                        }
-                    }
+            continue;
+        }
 
-                    parse_tpl (fields[FLD_PACKAGE], &text, &len, &alloc,
-                            replacements, escaping);
-
-                    free (replacements[4]->value);
-                    free (replacements[5]->value);
-                    free (replacements[6]->value);
-                    for (j = 0; j < 7; ++j)
-                        free (replacements[j]);
-
-                    debug ("-> %s %s -> %s [dl=%d; ins=%d]",
-                            pkg->name,
-                            pkg->old_version,
-                            pkg->new_version,
-                            (int) pkg->dl_size,
-                            (int) pkg->new_size);
-                }
+        net_size = (int) (pkg->new_size - pkg->old_size);
+        dsize += pkg->dl_size;
+        isize += pkg->new_size;
+        nsize += net_size;
 
-                /* construct list of packages, for use in cmdline */
-                if (string_pkgs)
-                {
-                    string_pkgs = g_string_append (string_pkgs, pkg->name);
-                    string_pkgs = g_string_append_c (string_pkgs, ' ');
-                }
+        if (v)
+        {
+            v[TPL_VAR_REPO] = (pkg->repo) ? pkg->repo : "-";
+            v[TPL_VAR_PKG]  = pkg->name;
+            v[TPL_VAR_OLD]  = pkg->old_version;
+            v[TPL_VAR_NEW]  = pkg->new_version;
+            v[TPL_VAR_DESC] = pkg->desc;
+            if (sizes)
+            {
+                s = sizes + n * 3 * SIZE_LEN;
+                size_h = humanize_size (pkg->dl_size, '\0', &unit);
+                snprint_size (s, SIZE_LEN, size_h, unit);
+                v[TPL_VAR_DL] = s;
+                s += SIZE_LEN;
+                size_h = humanize_size (pkg->new_size, '\0', &unit);
+                snprint_size (s, SIZE_LEN, size_h, unit);
+                v[TPL_VAR_INS] = s;
+                s += SIZE_LEN;
+                size_h = humanize_size (net_size, '\0', &unit);
+                snprint_size (s, SIZE_LEN, size_h, unit);
+                v[TPL_VAR_NET] = s;
             }
+            len += tpl_expand_len (ctpl[FLD_PACKAGE], v, escaping);
         }
     }
 
-    alloc = 255;
-    summary = new0 (gchar, alloc + 1);
-    len = 0;
-
-    replacements[0] = new0 (replacement_t, 1);
-    replacements[0]->name = "NB";
-    snprintf (buf, 255, "%d", nb);
-    replacements[0]->value = strdup (buf);
-    if (type & CHECK_NEWS)
+    if (values)
     {
-        replacements[1] = NULL;
+        *text = new (gchar, len + 1);
+        for (n = 0, s = *text; n < nb; ++n)
+        {
+            if (n > 0)
+                s = tpl_expand (ctpl[FLD_SEP], NULL, FALSE, s);
+            s = tpl_expand (ctpl[FLD_PACKAGE], values + n * _NB_TPL_VARS,
+                    escaping, s);
+        }
+        *s = '\0';
+        free (values);
+        free (sizes);
     }
-    else
+
+    if (!summary)
+        return;
+
+    snprintf (buf[0], SIZE_LEN, "%u", nb);
+    title_values[TPL_VAR_NB] = buf[0];
+    if (!(type & CHECK_NEWS))
     {
-        replacements[1] = new0 (replacement_t, 1);
-        replacements[1]->name = "DL";
         size_h = humanize_size (dsize, '\0', &unit);
-        snprint_size (buf, 255, size_h, unit);
-        replacements[1]->value = strdup (buf);
-        replacements[2] = new0 (replacement_t, 1);
-        replacements[2]->name = "NET";
+        snprint_size (buf[1], SIZE_LEN, size_h, unit);
+        title_values[TPL_VAR_DL] = buf[1];
         size_h = humanize_size (nsize, '\0', &unit);
-        snprint_size (buf, 255, size_h, unit);
-        replacements[2]->value = strdup (buf);
-        replacements[3] = new0 (replacement_t, 1);
-        replacements[3]->name = "INS";
+        snprint_size (buf[2], SIZE_LEN, size_h, unit);
+        title_values[TPL_VAR_NET] = buf[2];
         size_h = humanize_size (isize, '\0', &unit);
-        snprint_size (buf, 255, size_h, unit);
-        replacements[3]->value = strdup (buf);
-        replacements[4] = NULL;
+        snprint_size (buf[3], SIZE_LEN, size_h, unit);
+        title_values[TPL_VAR_INS] = buf[3];
     }
 
-    parse_tpl (fields[FLD_TITLE], &summary, &len, &alloc,
-            replacements, escaping);
+    len = tpl_expand_len (ctpl[FLD_TITLE], title_values, escaping);
+    *summary = new (gchar, len + 1);
+    s = tpl_expand (ctpl[FLD_TITLE], title_values, escaping, *summary);
+    *s = '\0';
+}
 
-    free (replacements[0]->value);
-    free (replacements[0]);
-    if (!(type & CHECK_NEWS))
-    {
-        free (replacements[1]->value);
-        free (replacements[2]->value);
-        free (replacements[3]->value);
-        free (replacements[1]);
-        free (replacements[2]);
-        free (replacements[3]);
-    }
+/* packages are then owned by the notification (kept in last_notifs, so it can
+ * be shown again) or, on CLI, freed */
+static void
+notify_updates (
+        packages_t  *packages,
+        check_t      type,
+        gboolean     show_it
+        )
+{
+    const kalu_package_t *pkgs = (packages) ? packages->pkgs : NULL;
+    guint nb = (packages) ? packages->nb : 0;
 
-#ifndef DISABLE_GUI
-    if (is_cli)
+#ifdef DISABLE_GUI
+    (void) show_it;
+#else
+    if (!is_cli)
     {
-#endif
-        puts (summary);
-        if (text)
-            puts (text);
-        free (summary);
-        free (text);
-        return;
-#ifndef DISABLE_GUI
-    }
+        notif_t *notif;
 
-    notif_t *notif;
-    notif = new (notif_t, 1);
-    notif->type = type;
-    notif->summary = summary;
-    notif->text = text;
-    notif->data = NULL;
+        notif = new0 (notif_t, 1);
+        notif->type = type;
+        notif->packages = packages;
 
-    if (type & CHECK_AUR)
-    {
-        if (config->cmdline_aur && string_pkgs)
+        if ((type & CHECK_AUR) && config->cmdline_aur && nb > 0)
         {
             /* if we have a list of pkgs, update the cmdline */
+            GString *string_pkgs;
+            guint n;
+
+            string_pkgs = g_string_sized_new (255);
+            for (n = 0; n < nb; ++n)
+            {
+                string_pkgs = g_string_append (string_pkgs, pkgs[n].name);
+                string_pkgs = g_string_append_c (string_pkgs, ' ');
+            }
             notif->data = strreplace (config->cmdline_aur, "$PACKAGES",
                     string_pkgs->str);
             g_string_free (string_pkgs, TRUE);
         }
         /* else no user data, so it'll default to config->cmdline_aur
          * So we'll always be able to call free (cmdline) in action_upgrade */
-    }
-    else if (type & CHECK_NEWS)
-    {
-        notif->data = xml_news;
-    }
-    else if (!(type & _CHECK_AUR_NOT_FOUND))
-    {
-        /* CHECK_UPGRADES, CHECK_WATCHED & CHECK_WATCHED_AUR all use packages */
-        notif->data = packages;
-    }
 
-    /* add the notif to the last of last notifications, so we can re-show it later */
-    debug ("adding new notif (%s) to last_notifs", notif->summary);
-    config->last_notifs = alpm_list_add (config->last_notifs, notif);
-    /* show it */
-    if (show_it)
-    {
-        show_notif (notif);
+        /* add the notif to the last of last notifications, so we can re-show it later */
+        debug ("adding new notif (type %d) to last_notifs", type);
+        config->last_notifs = alpm_list_add (config->last_notifs, notif);
+        /* show it */
+        if (show_it)
+        {
+            show_notif (notif);
+        }
+        return;
     }
-
 #endif /* DISABLE_GUI */
+
+    gchar *summary;
+    gchar *text;
+
+    expand_notif (type, pkgs, nb, &summary, &text);
+    puts (summary);
+    if (text)
+        puts (text);
+    free (summary);
+    free (text);
+    free_packages (packages);
 }
 
 void
 kalu_check_work (gboolean is_auto)
 {
     GError      *error = NULL;
-    alpm_list_t *packages;
+    packages_t  *packages;
     alpm_list_t *aur_pkgs;
-    gchar       *xml_news;
     gboolean     got_something      = FALSE;
 #ifndef DISABLE_GUI
     gint         nb_upgrades        = -1;
@@ -492,21 +460,28 @@ kalu_check_work (gboolean is_auto)
     FREE_NOTIFS_LIST (config->last_notifs);
 #endif
 
-    /* we will not free packages nor xml_news, because they'll be stored in
-     * notif_t (inside config->last_notifs) so we can re-show notifications.
-     * Everything gets free-d through the FREE_NOTIFS_LIST above */
-
     if (checks & CHECK_NEWS)
     {
-        packages = NULL;
-        if (news_has_updates (&packages, &xml_news, &error))
+        alpm_list_t *titles = NULL;
+
+        if (news_has_updates (&titles, &error))
         {
+            alpm_list_t *i;
+
             got_something = TRUE;
 #ifndef DISABLE_GUI
-            nb_news = (gint) alpm_list_count (packages);
+            nb_news = (gint) alpm_list_count (titles);
 #endif /* DISABLE_GUI */
-            notify_updates (packages, CHECK_NEWS, xml_news, show_it);
-            FREELIST (packages);
+            /* titles are used as names */
+            packages = NULL;
+            FOR_LIST (i, titles)
+            {
+                kalu_package_t *pkg = add_package (&packages);
+
+                pkg->name = intern_str (packages, i->data);
+            }
+            FREELIST (titles);
+            notify_updates (packages, CHECK_NEWS, show_it);
         }
         else if (error != NULL)
         {
@@ -581,9 +556,9 @@ kalu_check_work (gboolean is_auto)
             {
                 got_something = TRUE;
 #ifndef DISABLE_GUI
-                nb_upgrades = (gint) alpm_list_count (packages);
+                nb_upgrades = (gint) packages->nb;
 #endif /* DISABLE_GUI */
-                notify_updates (packages, CHECK_UPGRADES, NULL, show_it);
+                notify_updates (packages, CHECK_UPGRADES, show_it);
             }
 #ifndef DISABLE_GUI
             else if (error == NULL)
@@ -607,11 +582,10 @@ kalu_check_work (gboolean is_auto)
                              * ("Update system") to be featured. */
                             notif_t *notif;
 
-                            notif = new (notif_t, 1);
+                            notif = new0 (notif_t, 1);
                             notif->type = CHECK_UPGRADES;
                             notif->summary = strdup (_("Unable to compile list of packages"));
                             notif->text = strdup (error->message);
-                            notif->data = NULL;
 
                             /* add the notif to the last of last notifications,
                              * so we can re-show it later */
@@ -661,9 +635,9 @@ kalu_check_work (gboolean is_auto)
             {
                 got_something = TRUE;
 #ifndef DISABLE_GUI
-                nb_watched = (gint) alpm_list_count (packages);
+                nb_watched = (gint) packages->nb;
 #endif
-                notify_updates (packages, CHECK_WATCHED, NULL, show_it);
+                notify_updates (packages, CHECK_WATCHED, show_it);
             }
 #ifndef DISABLE_GUI
             else if (error == NULL)
@@ -694,24 +668,22 @@ kalu_check_work (gboolean is_auto)
             aur_pkgs = NULL;
             if (kalu_alpm_has_foreign (&aur_pkgs, config->aur_ignore, &error))
             {
-                alpm_list_t *not_found = NULL;
+                packages_t *not_found = NULL;
 
                 packages = NULL;
                 if (aur_has_updates (&packages, &not_found, aur_pkgs, FALSE, &error))
                 {
                     got_something = TRUE;
 #ifndef DISABLE_GUI
-                    nb_aur = (gint) alpm_list_count (packages);
+                    nb_aur = (gint) packages->nb;
 #endif
-                    notify_updates (packages, CHECK_AUR, NULL, show_it);
-                    FREE_PACKAGE_LIST (packages);
+                    notify_updates (packages, CHECK_AUR, show_it);
                     if (not_found)
                     {
 #ifndef DISABLE_GUI
-                        nb_aur_not_found = (gint) alpm_list_count (not_found);
+                        nb_aur_not_found = (gint) not_found->nb;
 #endif
-                        notify_updates (not_found, _CHECK_AUR_NOT_FOUND, NULL, show_it);
-                        FREE_PACKAGE_LIST (not_found);
+                        notify_updates (not_found, _CHECK_AUR_NOT_FOUND, show_it);
                     }
                 }
 #ifndef DISABLE_GUI
@@ -720,9 +692,8 @@ kalu_check_work (gboolean is_auto)
                     nb_aur = 0;
                     if (not_found)
                     {
-                        nb_aur_not_found = (gint) alpm_list_count (not_found);
-                        notify_updates (not_found, _CHECK_AUR_NOT_FOUND, NULL, show_it);
-                        FREE_PACKAGE_LIST (not_found);
+                        nb_aur_not_found = (gint) not_found->nb;
+                        notify_updates (not_found, _CHECK_AUR_NOT_FOUND, show_it);
                     }
                     else
                     {
@@ -780,9 +751,9 @@ kalu_check_work (gboolean is_auto)
         {
             got_something = TRUE;
 #ifndef DISABLE_GUI
-            nb_watched_aur = (gint) alpm_list_count (packages);
+            nb_watched_aur = (gint) packages->nb;
 #endif
-            notify_updates (packages, CHECK_WATCHED_AUR, NULL, show_it);
+            notify_updates (packages, CHECK_WATCHED_AUR, show_it);
         }
 #ifndef DISABLE_GUI
         else if (error == NULL)
@@ -829,6 +800,66 @@ kalu_check_work (gboolean is_auto)
 #endif
 }
 
+static void
+kalu_check_roots (gboolean is_auto, gchar **roots)
+{
+    GError       *error = NULL;
+    packages_t   *packages;
+    gchar       **root;
+    unsigned int  checks = (is_auto)
+        ? config->checks_auto
+        : config->checks_manual;
+
+    /* only upgrades are checked on additional roots; everything else (watched,
+     * AUR, news) is tied to the user/main root */
+    if (!(checks & CHECK_UPGRADES))
+    {
+        return;
+    }
+
+    for (root = roots; *root; ++root)
+    {
+        printf (_("Root: %s\n"), *root);
+
+        if (!kalu_alpm_fleet_load (*root, &error))
+        {
+            do_notify_error (
+                    _("Unable to check for updates -- loading alpm library failed"),
+                    error->message);
+            g_clear_error (&error);
+            continue;
+        }
+
+        /* DBs already sync-ed for a previous root will simply be copied */
+        if (!kalu_alpm_syncdbs (NULL, &error))
+        {
+            do_notify_error (
+                    _("Unable to check for updates -- could not synchronize databases"),
+                    error->message);
+            g_clear_error (&error);
+            kalu_alpm_fleet_unload ();
+            continue;
+        }
+
+        packages = NULL;
+        if (kalu_alpm_has_updates (&packages, &error))
+        {
+            notify_updates (packages, CHECK_UPGRADES, FALSE);
+        }
+        else if (error != NULL)
+        {
+            do_notify_error (_("Unable to check for updates"), error->message);
+            g_clear_error (&error);
+        }
+        else if (!is_auto)
+        {
+            do_notify_error (_("No upgrades available."), NULL);
+        }
+
+        kalu_alpm_fleet_unload ();
+    }
+}
+
 static void
 free_config (void)
 {
@@ -844,7 +875,10 @@ free_config (void)
     /* templates: custom values */
     for (tpl = 0; tpl < _NB_TPL; ++tpl)
         for (fld = 0; fld < _NB_FLD; ++fld)
+        {
             free (config->templates[tpl].fields[fld].custom);
+            free_compiled_tpl (compiled_tpls[tpl][fld]);
+        }
 
     /* watched */
     FREE_WATCHED_PACKAGE_LIST (config->watched);
@@ -855,26 +889,54 @@ free_config (void)
     /* aur ignore */
     FREELIST (config->aur_ignore);
 
+    free (config->shared_dbs_dir);
+
 #ifndef DISABLE_UPDATER
     FREELIST (config->cmdline_post);
 #endif
 
     /* news */
     free (config->news_last);
-    FREELIST (config->news_read);
+    g_hash_table_destroy (config->news_read);
 
     free (config);
 }
 
+/* returns a new (zeroed) package, only valid until the next one is added;
+ * packages is created if needed */
+kalu_package_t *
+add_package (packages_t **packages)
+{
+    packages_t *p = *packages;
+
+    if (!p)
+    {
+        p = *packages = new0 (packages_t, 1);
+        p->strings = g_string_chunk_new (4096);
+    }
+    if (p->nb == p->alloc)
+    {
+        p->alloc = (p->alloc) ? 2 * p->alloc : 16;
+        p->pkgs = renew (kalu_package_t, p->alloc, p->pkgs);
+    }
+    zero (p->pkgs[p->nb]);
+    return &p->pkgs[p->nb++];
+}
+
+char *
+intern_str (packages_t *packages, const char *s)
+{
+    return (s) ? g_string_chunk_insert_const (packages->strings, s) : NULL;
+}
+
 void
-free_package (kalu_package_t *package)
+free_packages (packages_t *packages)
 {
-    free (package->repo);
-    free (package->name);
-    free (package->desc);
-    free (package->old_version);
-    free (package->new_version);
-    free (package);
+    if (!packages)
+        return;
+    free (packages->pkgs);
+    g_string_chunk_free (packages->strings);
+    free (packages);
 }
 
 void
@@ -913,26 +975,31 @@ debug (const char *fmt, ...)
 #ifndef DISABLE_GUI
 #ifdef ENABLE_STATUS_NOTIFIER
 extern StatusNotifier *sn;
-extern GdkPixbuf *sn_icon[NB_SN_ICONS];
 #endif
 extern GtkStatusIcon *icon;
 extern GPtrArray     *open_windows;
+extern const gchar   *icon_names[NB_TRAY_ICONS];
+extern const gint     icon_sizes[NB_ICON_SIZES];
+extern GdkPixbuf     *icon_variants[NB_TRAY_ICONS][NB_ICON_SIZES];
 
 static GdkPixbuf *
-get_paused_pixbuf (GdkPixbuf *pixbuf)
+get_paused_pixbuf (GdkPixbuf *pixbuf, gint size)
 {
     cairo_surface_t *s;
     cairo_t         *cr;
     GdkPixbuf       *pb;
 
-    s = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, 48, 48);
+    s = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, size, size);
     cr = cairo_create (s);
 
     /* put the icon from pixbuf */
     gdk_cairo_set_source_pixbuf (cr, pixbuf, 0, 0);
-    cairo_rectangle (cr, 0, 0, 48, 48);
+    cairo_rectangle (cr, 0, 0, size, size);
     cairo_fill (cr);
 
+    /* bars are drawn as on a 48x48 icon */
+    cairo_scale (cr, size / 48., size / 48.);
+
     /* draw black borders */
     cairo_rectangle (cr, 13, 12, 10, 2);
     cairo_rectangle (cr, 21, 14, 2, 24);
@@ -952,43 +1019,121 @@ get_paused_pixbuf (GdkPixbuf *pixbuf)
     cairo_fill (cr);
 
     cairo_destroy (cr);
-    pb = gdk_pixbuf_get_from_surface (s, 0, 0, 48, 48);
+    pb = gdk_pixbuf_get_from_surface (s, 0, 0, size, size);
     cairo_surface_destroy (s);
 
     return pb;
 }
 
 static GdkPixbuf *
-get_gray_pixbuf (GdkPixbuf *pixbuf)
+get_gray_pixbuf (GdkPixbuf *pixbuf, gint size)
 {
     cairo_surface_t *s;
     cairo_pattern_t *pattern;
     cairo_t         *cr;
     GdkPixbuf       *pb;
 
-    s = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, 48, 48);
+    s = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, size, size);
     cr = cairo_create (s);
 
     /* put the icon from pixbuf */
     gdk_cairo_set_source_pixbuf (cr, pixbuf, 0, 0);
-    cairo_rectangle (cr, 0, 0, 48, 48);
+    cairo_rectangle (cr, 0, 0, size, size);
     cairo_fill (cr);
 
     /* use saturation to turn it gray */
     pattern = cairo_pattern_create_for_surface (s);
-    cairo_rectangle (cr, 0, 0, 48, 48);
+    cairo_rectangle (cr, 0, 0, size, size);
     cairo_set_source_rgb (cr, 0, 0, 0);
     cairo_set_operator (cr, CAIRO_OPERATOR_HSL_SATURATION);
     cairo_mask (cr, pattern);
 
     cairo_pattern_destroy (pattern);
     cairo_destroy (cr);
-    pb = gdk_pixbuf_get_from_surface (s, 0, 0, 48, 48);
+    pb = gdk_pixbuf_get_from_surface (s, 0, 0, size, size);
     cairo_surface_destroy (s);
 
     return pb;
 }
 
+/* icon stuff: we use 4 icons - "kalu", "kalu-paused", "kalu-gray" and
+ * "kalu-gray-paused" - from the theme.
+ * Using icon name allows user to easily specify icons (putting files in
+ * ~/.local/share/icons) for each of the 4 icons. Because we need them all,
+ * we ensure they all exists, and if not create them.
+ * "kalu" will come from kalu's binary
+ * "kalu-paused" comes from "kalu" w/ added bars
+ * "kalu-gray" comes from "kalu" but in gray
+ * "kaly-gray-paused" comes from "kalu-gray" w/ added bars
+ *
+ * All of them are loaded/rendered once for every size in icon_sizes, so
+ * switching icons (or sizes) later on never renders anything. */
+static void
+load_icons (void)
+{
+    GtkIconTheme *icon_theme;
+    GdkPixbuf    *logo = NULL;
+    gboolean      in_theme[NB_TRAY_ICONS];
+    guint         i, n;
+
+    icon_theme = gtk_icon_theme_get_default ();
+    for (i = 0; i < NB_TRAY_ICONS; ++i)
+    {
+        in_theme[i] = gtk_icon_theme_has_icon (icon_theme, icon_names[i]);
+        if (!in_theme[i])
+            debug ("No icon '%s' in theme -- creating it", icon_names[i]);
+    }
+
+    if (!in_theme[TRAY_ICON_KALU])
+    {
+        GInputStream *stream;
+
+        /* fallback to inline logo */
+        stream = g_memory_input_stream_new_from_data (kalu_logo, kalu_logo_size, NULL);
+        logo = gdk_pixbuf_new_from_stream (stream, NULL, NULL);
+        g_object_unref (G_OBJECT (stream));
+    }
+
+    for (n = 0; n < NB_ICON_SIZES; ++n)
+    {
+        gint size = icon_sizes[n];
+
+        for (i = 0; i < NB_TRAY_ICONS; ++i)
+        {
+            GdkPixbuf *pixbuf = NULL;
+            /* paused ones come from the previous variant */
+            GdkPixbuf *from = (i == TRAY_ICON_KALU_GRAY)
+                ? icon_variants[TRAY_ICON_KALU][n]
+                : (i > 0) ? icon_variants[i - 1][n] : logo;
+
+            if (in_theme[i])
+                pixbuf = gtk_icon_theme_load_icon (icon_theme, icon_names[i],
+                        size, GTK_ICON_LOOKUP_FORCE_SIZE, NULL);
+            else if (!from)
+                continue;
+            else if (i == TRAY_ICON_KALU)
+                pixbuf = gdk_pixbuf_scale_simple (from, size, size,
+                        GDK_INTERP_BILINEAR);
+            else if (i == TRAY_ICON_KALU_GRAY)
+                pixbuf = get_gray_pixbuf (from, size);
+            else
+                pixbuf = get_paused_pixbuf (from, size);
+
+            if (pixbuf && !in_theme[i])
+            {
+                /* so it can be used by name as well */
+                G_GNUC_BEGIN_IGNORE_DEPRECATIONS
+                gtk_icon_theme_add_builtin_icon (icon_names[i], size, pixbuf);
+                G_GNUC_END_IGNORE_DEPRECATIONS
+            }
+            icon_variants[i][n] = pixbuf;
+        }
+    }
+
+    if (logo)
+        g_object_unref (logo);
+}
+
 struct fifo
 {
     gchar *name;
@@ -1145,11 +1290,15 @@ create_status_icon (void)
 {
     G_GNUC_BEGIN_IGNORE_DEPRECATIONS
     debug ("create GtkStatusIcon");
-    icon = gtk_status_icon_new_from_icon_name ("kalu-gray");
+    icon = gtk_status_icon_new ();
+    /* set the current variant */
+    icon_size_changed_cb (icon, gtk_status_icon_get_size (icon), NULL);
     gtk_status_icon_set_name (icon, "kalu");
     gtk_status_icon_set_title (icon, "kalu");
     gtk_status_icon_set_tooltip_text (icon, "kalu");
 
+    g_signal_connect (G_OBJECT (icon), "size-changed",
+            G_CALLBACK (icon_size_changed_cb), NULL);
     g_signal_connect (G_OBJECT (icon), "query-tooltip",
             G_CALLBACK (icon_query_tooltip_cb), NULL);
     g_signal_connect (G_OBJECT (icon), "popup-menu",
@@ -1184,20 +1333,12 @@ sn_state_cb (void)
 static void
 sn_reg_failed (StatusNotifier *_sn _UNUSED_, GError *error)
 {
-    guint i;
-
     debug ("StatusNotifier registration failed: %s", error->message);
     if (status_notifier_get_state (sn) == STATUS_NOTIFIER_STATE_FAILED)
     {
         debug ("no possible recovery; destroy StatusNotifier");
         g_object_unref (sn);
         sn = NULL;
-        for (i = 0; i < NB_SN_ICONS; ++i)
-            if (sn_icon[i])
-            {
-                g_object_unref (sn_icon[i]);
-                sn_icon[i] = NULL;
-            }
     }
     /* fallback to systray */
     create_status_icon ();
@@ -1231,9 +1372,6 @@ main (int argc, char *argv[])
 {
     GError          *error = NULL;
 #ifndef DISABLE_GUI
-    GtkIconTheme    *icon_theme;
-    GdkPixbuf       *pixbuf;
-    GdkPixbuf       *pixbuf_kalu;
     struct fifo      fifo = { .fd = -1, .name = NULL };
     gint             r;
 #endif
@@ -1258,17 +1396,33 @@ main (int argc, char *argv[])
     gboolean         run_auto_checks    = FALSE;
     gchar           *tmp_dbpath         = NULL;
     gboolean         keep_tmp_dbpath    = FALSE;
+    gchar          **roots              = NULL;
+#ifndef DISABLE_UPDATER
+    gchar           *record_file        = NULL;
+    gchar           *replay_file        = NULL;
+    gboolean         replay_max_speed   = FALSE;
+#endif
     GOptionEntry     options[] = {
         { "auto-checks",    'a', 0, G_OPTION_ARG_NONE, &run_auto_checks,
             N_("Run automatic checks"), NULL },
         { "manual-checks",  'm', 0, G_OPTION_ARG_NONE, &run_manual_checks,
             N_("Run manual checks"), NULL },
+        { "root-conf",      'R', 0, G_OPTION_ARG_FILENAME_ARRAY, &roots,
+            N_("Also check for upgrades the root configured in FILE"), "FILE" },
         { "tmp-dbpath",     'T', 0, G_OPTION_ARG_STRING, &tmp_dbpath,
             N_("Use PATH as temporary dbpath"), "PATH" },
         { "keep-tmp-dbpath",'K', 0, G_OPTION_ARG_NONE, &keep_tmp_dbpath,
             N_("Keep tmp dbpath folder"), NULL },
         { "debug",          'd', G_OPTION_FLAG_NO_ARG, G_OPTION_ARG_CALLBACK,
             opt_debug, N_("Enable debug mode"), NULL },
+#ifndef DISABLE_UPDATER
+        { "record-updater", 0, 0, G_OPTION_ARG_FILENAME, &record_file,
+            N_("Record signals received by the updater into FILE"), "FILE" },
+        { "replay-updater", 0, 0, G_OPTION_ARG_FILENAME, &replay_file,
+            N_("Run the updater on signals replayed from FILE"), "FILE" },
+        { "replay-max-speed", 0, 0, G_OPTION_ARG_NONE, &replay_max_speed,
+            N_("Replay signals as fast as possible"), NULL },
+#endif
         { "version",        'V', 0, G_OPTION_ARG_NONE, &show_version,
             N_("Show version information"), NULL },
         { NULL }
@@ -1311,9 +1465,23 @@ main (int argc, char *argv[])
         {
             is_cli = TRUE;
         }
+        else if (roots)
+        {
+            fputs (_("Option --root-conf requires --auto-checks or --manual-checks\n"),
+                    stderr);
+            g_strfreev (roots);
+            roots = NULL;
+        }
 #endif
         if (tmp_dbpath)
             kalu_alpm_set_tmp_dbpath (tmp_dbpath);
+#ifndef DISABLE_UPDATER
+        if (record_file)
+        {
+            updater_set_record (record_file);
+            g_free (record_file);
+        }
+#endif
         g_option_context_free (context);
     }
 
@@ -1329,6 +1497,9 @@ main (int argc, char *argv[])
         | CHECK_WATCHED_AUR | CHECK_NEWS;
     config->auto_notifs = TRUE;
     config->notif_buttons = TRUE;
+    config->shared_dbs_max_age = 300; /* 5 minutes */
+    config->news_read = g_hash_table_new_full (g_str_hash, g_str_equal,
+            free, NULL);
 #ifndef DISABLE_UPDATER
     config->action = UPGRADE_ACTION_KALU;
     config->confirm_post = TRUE;
@@ -1409,6 +1580,7 @@ main (int argc, char *argv[])
                 error->message, NULL);
         g_clear_error (&error);
     }
+    compile_templates ();
     /* parse watched */
     snprintf (conffile, PATH_MAX - 1, "%s/kalu/watched.conf",
             g_get_user_config_dir ());
@@ -1453,11 +1625,39 @@ main (int argc, char *argv[])
     if (run_manual_checks || run_auto_checks)
     {
 #endif
+        if (roots && !kalu_alpm_fleet_init (&error))
+        {
+            do_show_error (_("Unable to check multiple roots"),
+                    error->message, NULL);
+            g_clear_error (&error);
+            g_strfreev (roots);
+            roots = NULL;
+        }
+        if (roots)
+        {
+            printf (_("Root: %s\n"), config->pacmanconf);
+        }
         kalu_check_work (run_auto_checks);
+        if (roots)
+        {
+            kalu_check_roots (run_auto_checks, roots);
+            kalu_alpm_fleet_free ();
+            g_strfreev (roots);
+        }
 #ifndef DISABLE_GUI
         goto eop;
     }
 
+#ifndef DISABLE_UPDATER
+    if (replay_file)
+    {
+        updater_replay (replay_file, replay_max_speed);
+        g_free (replay_file);
+        gtk_main ();
+        goto eop;
+    }
+#endif
+
     /* FIFO */
     fifo.name = g_strdup_printf ("%s/kalu_fifo_%d",
             g_get_user_runtime_dir (), getpid ());
@@ -1476,91 +1676,7 @@ main (int argc, char *argv[])
         open_fifo (&fifo);
     }
 
-    /* icon stuff: we use 4 icons - "kalu", "kalu-paused", "kalu-gray" and
-     * "kalu-gray-paused" - from the theme.
-     * Using icon name allows user to easily specify icons (putting files in
-     * ~/.local/share/icons) for each of the 4 icons. Because we need them all,
-     * we ensure they all exists, and if not create them.
-     * "kalu" will come from kalu's binary
-     * "kalu-paused" comes from "kalu" w/ added bars
-     * "kalu-gray" comes from "kalu" but in gray
-     * "kaly-gray-paused" comes from "kalu-gray" w/ added bars */
-
-    icon_theme = gtk_icon_theme_get_default ();
-    pixbuf_kalu = NULL;
-
-    /* kalu */
-    if (!gtk_icon_theme_has_icon (icon_theme, "kalu"))
-    {
-        GInputStream *stream;
-
-        /* fallback to inline logo */
-        debug ("No icon 'kalu' in theme -- load inline logo");
-        stream = g_memory_input_stream_new_from_data (kalu_logo, kalu_logo_size, NULL);
-        pixbuf_kalu = gdk_pixbuf_new_from_stream (stream, NULL, NULL);
-        g_object_unref (G_OBJECT (stream));
-#ifdef ENABLE_STATUS_NOTIFIER
-        sn_icon[SN_ICON_KALU] = g_object_ref (pixbuf_kalu);
-#endif
-
-        G_GNUC_BEGIN_IGNORE_DEPRECATIONS
-        gtk_icon_theme_add_builtin_icon ("kalu", 48, pixbuf_kalu);
-        G_GNUC_END_IGNORE_DEPRECATIONS
-    }
-
-    /* kalu-paused */
-    if (!gtk_icon_theme_has_icon (icon_theme, "kalu-paused"))
-    {
-        if (!pixbuf_kalu)
-            pixbuf_kalu = gtk_icon_theme_load_icon (icon_theme, "kalu", 48, 0, NULL);
-
-        debug ("No icon 'kalu-paused' -- creating it");
-        pixbuf = get_paused_pixbuf (pixbuf_kalu);
-        G_GNUC_BEGIN_IGNORE_DEPRECATIONS
-        gtk_icon_theme_add_builtin_icon ("kalu-paused", 48, pixbuf);
-        G_GNUC_END_IGNORE_DEPRECATIONS
-#ifdef ENABLE_STATUS_NOTIFIER
-        sn_icon[SN_ICON_KALU_PAUSED] = g_object_ref (pixbuf);
-#endif
-        g_object_unref (pixbuf);
-    }
-
-    /* kalu-gray */
-    if (!gtk_icon_theme_has_icon (icon_theme, "kalu-gray"))
-    {
-        if (!pixbuf_kalu)
-            pixbuf_kalu = gtk_icon_theme_load_icon (icon_theme, "kalu", 48, 0, NULL);
-
-        debug ("No icon 'kalu-gray' -- creating it");
-        pixbuf = get_gray_pixbuf (pixbuf_kalu);
-        G_GNUC_BEGIN_IGNORE_DEPRECATIONS
-        gtk_icon_theme_add_builtin_icon ("kalu-gray", 48, pixbuf);
-        G_GNUC_END_IGNORE_DEPRECATIONS
-#ifdef ENABLE_STATUS_NOTIFIER
-        sn_icon[SN_ICON_KALU_GRAY] = g_object_ref (pixbuf);
-#endif
-        g_object_unref (pixbuf);
-    }
-
-    if (pixbuf_kalu)
-        g_object_unref (pixbuf_kalu);
-
-    /* kalu-gray-paused */
-    if (!gtk_icon_theme_has_icon (icon_theme, "kalu-gray-paused"))
-    {
-        pixbuf_kalu = gtk_icon_theme_load_icon (icon_theme, "kalu-gray", 48, 0, NULL);
-
-        debug ("No icon 'kalu-gray-paused' -- creating it");
-        pixbuf = get_paused_pixbuf (pixbuf_kalu);
-        G_GNUC_BEGIN_IGNORE_DEPRECATIONS
-        gtk_icon_theme_add_builtin_icon ("kalu-gray-paused", 48, pixbuf);
-        G_GNUC_END_IGNORE_DEPRECATIONS
-#ifdef ENABLE_STATUS_NOTIFIER
-        sn_icon[SN_ICON_KALU_GRAY_PAUSED] = g_object_ref (pixbuf);
-#endif
-        g_object_unref (pixbuf);
-        g_object_unref (pixbuf_kalu);
-    }
+    load_icons ();
 
 #ifdef ENABLE_STATUS_NOTIFIER
     debug ("create StatusNotifier");
@@ -1569,15 +1685,15 @@ main (int argc, char *argv[])
             "title",            "kalu",
             "tooltip-title",    "kalu",
             NULL));
-    if (sn_icon[SN_ICON_KALU_GRAY])
+    if (get_icon_variant (TRAY_ICON_KALU_GRAY, 48))
         g_object_set (G_OBJECT (sn),
-                "main-icon-pixbuf",     sn_icon[SN_ICON_KALU_GRAY],
-                "tooltip-icon-pixbuf",  sn_icon[SN_ICON_KALU_GRAY],
+                "main-icon-pixbuf",     get_icon_variant (TRAY_ICON_KALU_GRAY, 48),
+                "tooltip-icon-pixbuf",  get_icon_variant (TRAY_ICON_KALU_GRAY, 48),
                 NULL);
     else
         g_object_set (G_OBJECT (sn),
-                "main-icon-name",       "kaly-gray",
-                "tooltip-icon-name",    "kaly-gray",
+                "main-icon-name",       "kalu-gray",
+                "tooltip-icon-name",    "kalu-gray",
                 NULL);
     g_signal_connect (G_OBJECT (sn), "notify::state",
             G_CALLBACK (sn_state_cb), NULL);
@@ -1610,16 +1726,18 @@ eop:
     {
         notify_uninit ();
     }
+    guint i, n;
+    for (i = 0; i < NB_TRAY_ICONS; ++i)
+        for (n = 0; n < NB_ICON_SIZES; ++n)
+            if (icon_variants[i][n])
+                g_object_unref (icon_variants[i][n]);
 #ifdef ENABLE_STATUS_NOTIFIER
-    guint i;
-    for (i = 0; i < NB_SN_ICONS; ++i)
-        if (sn_icon[i])
-            g_object_unref (sn_icon[i]);
     if (sn)
         g_object_unref (sn);
 #endif
 #endif /* DISABLE_GUI */
     kalu_alpm_rmdb (keep_tmp_dbpath);
+    kalu_alpm_free_cache_index ();
     if (config->is_curl_init)
     {
         curl_global_cleanup ();
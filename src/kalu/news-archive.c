@@ -0,0 +1,635 @@
+/**
+ * kalu - Copyright (C) 2012-2018 Olivier Brunel
+ *
+ * news-archive.c
+ * Copyright (C) 2012-2018 Olivier Brunel <jjk@jjacky.com>
+ *
+ * This file is part of kalu.
+ *
+ * kalu is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * kalu is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * kalu. If not, see http://www.gnu.org/licenses/
+ */
+
+#include <config.h>
+
+/* C */
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+/* kalu */
+#include "kalu.h"
+#include "news-archive.h"
+#include "util.h"
+
+/* The archive (news.archive) only ever gets news items appended to it, oldest
+ * first, as records: u32 size, then u32 length + bytes for each field (title,
+ * date, link & description)
+ * The index (news.index) lists them newest first, with the offset & title of
+ * each record, and the size of the archive it was written for. It is only a
+ * cache, rebuilt from the archive whenever it doesn't match. */
+#define ARCHIVE_FILE        "news.archive"
+#define INDEX_FILE          "news.index"
+#define ARCHIVE_MAGIC       "KALUNEWS"
+#define INDEX_MAGIC         "KALUNIDX"
+#define MAGIC_LEN           8
+
+typedef struct _index_entry_t {
+    guint64  offset;
+    gchar   *title;
+} index_entry_t;
+
+void
+free_news_item (news_item_t *item)
+{
+    if (!item)
+    {
+        return;
+    }
+    free (item->title);
+    free (item->date);
+    free (item->link);
+    free (item->description);
+    free (item);
+}
+
+static void
+free_index_entry (index_entry_t *entry)
+{
+    free (entry->title);
+    free (entry);
+}
+
+static gchar *
+get_file (const gchar *name)
+{
+    return g_strdup_printf ("%s/kalu/%s", g_get_user_cache_dir (), name);
+}
+
+static alpm_list_t *
+prepend (alpm_list_t *list, void *data)
+{
+    return alpm_list_join (alpm_list_add (NULL, data), list);
+}
+
+static gboolean
+read_u32 (const gchar *data, gsize end, gsize *pos, guint32 *val)
+{
+    if (end - *pos < sizeof (*val))
+    {
+        return FALSE;
+    }
+    memcpy (val, data + *pos, sizeof (*val));
+    *pos += sizeof (*val);
+    return TRUE;
+}
+
+static gchar *
+read_string (const gchar *data, gsize end, gsize *pos)
+{
+    gchar   *s;
+    guint32  len;
+
+    if (!read_u32 (data, end, pos, &len) || end - *pos < len)
+    {
+        return NULL;
+    }
+    s = strndup (data + *pos, len);
+    *pos += len;
+    return s;
+}
+
+static void
+write_string (GString *str, const gchar *s)
+{
+    guint32 len = (s) ? (guint32) strlen (s) : 0;
+
+    g_string_append_len (str, (const gchar *) &len, sizeof (len));
+    if (len > 0)
+    {
+        g_string_append_len (str, s, (gssize) len);
+    }
+}
+
+/* returns the item from record at offset, and sets next to the offset of the
+ * following one */
+static news_item_t *
+read_record (const gchar *data, gsize len, guint64 offset, gsize *next)
+{
+    news_item_t *item;
+    guint32      size;
+    gsize        pos = (gsize) offset;
+    gsize        end;
+
+    if (offset < MAGIC_LEN || offset > len
+            || !read_u32 (data, len, &pos, &size) || len - pos < size)
+    {
+        return NULL;
+    }
+    end = pos + size;
+
+    item = new0 (news_item_t, 1);
+    item->title = read_string (data, end, &pos);
+    item->date = read_string (data, end, &pos);
+    item->link = read_string (data, end, &pos);
+    item->description = read_string (data, end, &pos);
+    if (!item->title || !item->date || !item->link || !item->description
+            || pos != end)
+    {
+        free_news_item (item);
+        return NULL;
+    }
+
+    if (next)
+    {
+        *next = end;
+    }
+    return item;
+}
+
+static void
+write_record (GString *str, news_item_t *item)
+{
+    gsize   start = str->len;
+    guint32 size;
+
+    /* placeholder for the size */
+    g_string_append_len (str, "\0\0\0\0", sizeof (size));
+    write_string (str, item->title);
+    write_string (str, item->date);
+    write_string (str, item->link);
+    write_string (str, item->description);
+    size = (guint32) (str->len - start - sizeof (size));
+    memcpy (str->str + start, &size, sizeof (size));
+}
+
+/* returns the mapped archive, or NULL if there's none (not an error) */
+static GMappedFile *
+open_archive (GError **error)
+{
+    GMappedFile *archive;
+    GError      *local_err = NULL;
+    gchar       *file;
+
+    file = get_file (ARCHIVE_FILE);
+    archive = g_mapped_file_new (file, FALSE, &local_err);
+    if (!archive)
+    {
+        if (local_err->domain != G_FILE_ERROR
+                || local_err->code != G_FILE_ERROR_NOENT)
+        {
+            g_set_error (error, KALU_ERROR, 1,
+                    _("Unable to open news archive %s: %s"),
+                    file, local_err->message);
+        }
+        g_clear_error (&local_err);
+        g_free (file);
+        return NULL;
+    }
+
+    if (g_mapped_file_get_length (archive) < MAGIC_LEN
+            || memcmp (g_mapped_file_get_contents (archive),
+                ARCHIVE_MAGIC, MAGIC_LEN) != 0)
+    {
+        debug ("news archive: invalid file %s, ignoring", file);
+        g_mapped_file_unref (archive);
+        archive = NULL;
+    }
+    g_free (file);
+    return archive;
+}
+
+static alpm_list_t *
+rebuild_index (const gchar *data, gsize len)
+{
+    alpm_list_t *entries = NULL;
+    news_item_t *item;
+    gsize        offset = MAGIC_LEN;
+    gsize        next;
+
+    while ((item = read_record (data, len, offset, &next)))
+    {
+        index_entry_t *entry = new (index_entry_t, 1);
+        entry->offset = offset;
+        entry->title = item->title;
+        item->title = NULL;
+        free_news_item (item);
+        entries = prepend (entries, entry);
+        offset = next;
+    }
+    if (offset < len)
+    {
+        debug ("news archive: ignoring invalid data at offset %u",
+                (unsigned int) offset);
+    }
+    debug ("news archive: index rebuilt, %u items",
+            (unsigned int) alpm_list_count (entries));
+
+    return entries;
+}
+
+/* returns the index entries (newest first) for archive data/len. If the index
+ * is missing or doesn't match the archive, it is rebuilt (and rebuilt is set) */
+static alpm_list_t *
+load_index (const gchar *data, gsize len, gboolean *rebuilt)
+{
+    alpm_list_t *entries = NULL;
+    gchar       *file;
+    gchar       *contents;
+    gsize        contents_len;
+    gsize        pos = MAGIC_LEN;
+    guint64      size;
+    guint32      nb;
+
+    *rebuilt = FALSE;
+    if (!data)
+    {
+        return NULL;
+    }
+
+    file = get_file (INDEX_FILE);
+    if (!g_file_get_contents (file, &contents, &contents_len, NULL))
+    {
+        g_free (file);
+        *rebuilt = TRUE;
+        return rebuild_index (data, len);
+    }
+    g_free (file);
+
+    if (contents_len < MAGIC_LEN + sizeof (size)
+            || memcmp (contents, INDEX_MAGIC, MAGIC_LEN) != 0)
+    {
+        g_free (contents);
+        *rebuilt = TRUE;
+        return rebuild_index (data, len);
+    }
+    memcpy (&size, contents + pos, sizeof (size));
+    pos += sizeof (size);
+    /* e.g. crash after appending to archive, before writing the index */
+    if (size != len || !read_u32 (contents, contents_len, &pos, &nb))
+    {
+        g_free (contents);
+        *rebuilt = TRUE;
+        return rebuild_index (data, len);
+    }
+
+    for ( ; nb > 0; --nb)
+    {
+        index_entry_t *entry;
+        guint64 offset;
+
+        if (contents_len - pos < sizeof (offset))
+        {
+            break;
+        }
+        memcpy (&offset, contents + pos, sizeof (offset));
+        pos += sizeof (offset);
+        if (offset < MAGIC_LEN || offset >= len)
+        {
+            break;
+        }
+
+        entry = new (index_entry_t, 1);
+        entry->offset = offset;
+        entry->title = read_string (contents, contents_len, &pos);
+        if (!entry->title)
+        {
+            free (entry);
+            break;
+        }
+        entries = alpm_list_add (entries, entry);
+    }
+    g_free (contents);
+
+    if (nb > 0 || pos != contents_len)
+    {
+        debug ("news archive: invalid index");
+        alpm_list_free_inner (entries, (alpm_list_fn_free) free_index_entry);
+        alpm_list_free (entries);
+        *rebuilt = TRUE;
+        return rebuild_index (data, len);
+    }
+
+    return entries;
+}
+
+static gboolean
+save_index (alpm_list_t *entries, guint64 archive_size, GError **error)
+{
+    GError      *local_err = NULL;
+    GString     *str;
+    alpm_list_t *i;
+    gchar       *file;
+    guint32      nb = (guint32) alpm_list_count (entries);
+    gboolean     success = TRUE;
+
+    str = g_string_sized_new (MAGIC_LEN + sizeof (archive_size) + sizeof (nb)
+            + nb * 64);
+    g_string_append_len (str, INDEX_MAGIC, MAGIC_LEN);
+    g_string_append_len (str, (const gchar *) &archive_size, sizeof (archive_size));
+    g_string_append_len (str, (const gchar *) &nb, sizeof (nb));
+    FOR_LIST (i, entries)
+    {
+        index_entry_t *entry = i->data;
+
+        g_string_append_len (str, (const gchar *) &entry->offset,
+                sizeof (entry->offset));
+        write_string (str, entry->title);
+    }
+
+    file = get_file (INDEX_FILE);
+    if (!g_file_set_contents (file, str->str, (gssize) str->len, &local_err))
+    {
+        g_set_error (error, KALU_ERROR, 1,
+                _("Unable to save news archive index: %s"), local_err->message);
+        g_clear_error (&local_err);
+        success = FALSE;
+    }
+    g_free (file);
+    g_string_free (str, TRUE);
+    return success;
+}
+
+/* returns the length of the archive up to the end of its last valid record,
+ * i.e. the one of the first entry (newest) */
+static gsize
+valid_length (const gchar *data, gsize len, alpm_list_t *entries)
+{
+    news_item_t *item;
+    gsize        end = MAGIC_LEN;
+
+    if (entries)
+    {
+        item = read_record (data, len,
+                ((index_entry_t *) entries->data)->offset, &end);
+        if (!item)
+        {
+            /* shouldn't happen; don't risk dropping anything */
+            return len;
+        }
+        free_news_item (item);
+    }
+    return end;
+}
+
+/* adds items (newest first) not yet in the archive to it */
+gboolean
+news_archive_add (alpm_list_t *items, GError **error)
+{
+    GMappedFile *archive;
+    GError      *local_err = NULL;
+    GHashTable  *titles;
+    GString     *str;
+    alpm_list_t *entries;
+    alpm_list_t *new_items = NULL;
+    alpm_list_t *i;
+    const gchar *data = NULL;
+    gchar       *file;
+    gsize        len = 0;
+    gsize        done = 0;
+    gboolean     rebuilt;
+    gboolean     success = TRUE;
+    int          fd;
+
+    archive = open_archive (&local_err);
+    if (local_err)
+    {
+        g_propagate_error (error, local_err);
+        return FALSE;
+    }
+    if (archive)
+    {
+        data = g_mapped_file_get_contents (archive);
+        len = g_mapped_file_get_length (archive);
+    }
+    entries = load_index (data, len, &rebuilt);
+    if (archive)
+    {
+        gsize end = valid_length (data, len, entries);
+
+        /* e.g. crash while appending: drop the torn record, else new ones
+         * would get appended after it, and be lost on next rebuild */
+        if (end < len)
+        {
+            file = get_file (ARCHIVE_FILE);
+            if (truncate (file, (off_t) end) < 0)
+            {
+                g_set_error (error, KALU_ERROR, 1,
+                        _("Unable to truncate news archive %s: %s"),
+                        file, strerror (errno));
+                g_free (file);
+                success = FALSE;
+                goto done;
+            }
+            debug ("news archive: dropped %u bytes of invalid data",
+                    (unsigned int) (len - end));
+            g_free (file);
+            len = end;
+            rebuilt = TRUE;
+        }
+    }
+
+    titles = g_hash_table_new (g_str_hash, g_str_equal);
+    FOR_LIST (i, entries)
+    {
+        g_hash_table_add (titles, ((index_entry_t *) i->data)->title);
+    }
+    /* oldest first, as they'll be appended */
+    FOR_LIST (i, items)
+    {
+        news_item_t *item = i->data;
+
+        if (!g_hash_table_contains (titles, item->title))
+        {
+            g_hash_table_add (titles, item->title);
+            new_items = prepend (new_items, item);
+        }
+    }
+    g_hash_table_destroy (titles);
+
+    if (!new_items)
+    {
+        if (rebuilt && !save_index (entries, len, &local_err))
+        {
+            debug ("news archive: %s", local_err->message);
+            g_clear_error (&local_err);
+        }
+        goto done;
+    }
+
+    file = get_file (ARCHIVE_FILE);
+    if (!ensure_path (file))
+    {
+        g_set_error (error, KALU_ERROR, 1,
+                _("Unable to create folder for %s"), file);
+        g_free (file);
+        success = FALSE;
+        goto done;
+    }
+    /* no (valid) archive, start a new one */
+    fd = open (file, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC
+            | ((archive) ? 0 : O_TRUNC), 0644);
+    if (fd < 0)
+    {
+        g_set_error (error, KALU_ERROR, 1,
+                _("Unable to open news archive %s: %s"), file, strerror (errno));
+        g_free (file);
+        success = FALSE;
+        goto done;
+    }
+
+    str = g_string_sized_new (4096);
+    if (!archive)
+    {
+        g_string_append_len (str, ARCHIVE_MAGIC, MAGIC_LEN);
+    }
+    FOR_LIST (i, new_items)
+    {
+        index_entry_t *entry = new (index_entry_t, 1);
+
+        entry->offset = len + str->len;
+        entry->title = strdup (((news_item_t *) i->data)->title);
+        entries = prepend (entries, entry);
+        write_record (str, i->data);
+    }
+
+    while (done < str->len)
+    {
+        ssize_t r = write (fd, str->str + done, str->len - done);
+        if (r < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+        done += (gsize) r;
+    }
+    if (done < str->len || fsync (fd) < 0)
+    {
+        g_set_error (error, KALU_ERROR, 1,
+                _("Unable to write to news archive %s: %s"),
+                file, strerror (errno));
+        if (ftruncate (fd, (off_t) len) < 0)
+        {
+            debug ("news archive: failed to truncate back: %s", strerror (errno));
+        }
+        success = FALSE;
+    }
+    else
+    {
+        debug ("news archive: added %u items",
+                (unsigned int) alpm_list_count (new_items));
+        /* failing to save the index isn't an error, it'll be rebuilt */
+        if (!save_index (entries, len + str->len, &local_err))
+        {
+            debug ("news archive: %s", local_err->message);
+            g_clear_error (&local_err);
+        }
+    }
+    close (fd);
+    g_string_free (str, TRUE);
+    g_free (file);
+
+done:
+    alpm_list_free (new_items);
+    alpm_list_free_inner (entries, (alpm_list_fn_free) free_index_entry);
+    alpm_list_free (entries);
+    if (archive)
+    {
+        g_mapped_file_unref (archive);
+    }
+    return success;
+}
+
+static gboolean
+item_matches (news_item_t *item, const gchar *needle)
+{
+    gchar    *s;
+    gboolean  match;
+
+    s = g_utf8_casefold (item->title, -1);
+    match = strstr (s, needle) != NULL;
+    g_free (s);
+    if (!match)
+    {
+        s = g_utf8_casefold (item->description, -1);
+        match = strstr (s, needle) != NULL;
+        g_free (s);
+    }
+    return match;
+}
+
+/* returns all archived items (newest first), or only those with search in
+ * their title or description (case insensitive) */
+alpm_list_t *
+news_archive_get_items (const gchar *search, GError **error)
+{
+    GMappedFile *archive;
+    GError      *local_err = NULL;
+    alpm_list_t *entries;
+    alpm_list_t *items = NULL;
+    alpm_list_t *i;
+    const gchar *data;
+    gchar       *needle = NULL;
+    gsize        len;
+    gboolean     rebuilt;
+
+    archive = open_archive (&local_err);
+    if (!archive)
+    {
+        if (local_err)
+        {
+            g_propagate_error (error, local_err);
+        }
+        return NULL;
+    }
+    data = g_mapped_file_get_contents (archive);
+    len = g_mapped_file_get_length (archive);
+
+    entries = load_index (data, len, &rebuilt);
+    if (rebuilt && !save_index (entries, len, &local_err))
+    {
+        debug ("news archive: %s", local_err->message);
+        g_clear_error (&local_err);
+    }
+
+    if (search && *search)
+    {
+        needle = g_utf8_casefold (search, -1);
+    }
+    FOR_LIST (i, entries)
+    {
+        news_item_t *item;
+
+        item = read_record (data, len, ((index_entry_t *) i->data)->offset, NULL);
+        if (!item)
+        {
+            continue;
+        }
+        if (needle && !item_matches (item, needle))
+        {
+            free_news_item (item);
+            continue;
+        }
+        items = alpm_list_add (items, item);
+    }
+
+    g_free (needle);
+    alpm_list_free_inner (entries, (alpm_list_fn_free) free_index_entry);
+    alpm_list_free (entries);
+    g_mapped_file_unref (archive);
+    return items;
+}
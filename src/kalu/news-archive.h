@@ -0,0 +1,53 @@
+/**
+ * kalu - Copyright (C) 2012-2018 Olivier Brunel
+ *
+ * news-archive.h
+ * Copyright (C) 2012-2018 Olivier Brunel <jjk@jjacky.com>
+ *
+ * This file is part of kalu.
+ *
+ * kalu is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * kalu is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * kalu. If not, see http://www.gnu.org/licenses/
+ */
+
+#ifndef _KALU_NEWS_ARCHIVE_H
+#define _KALU_NEWS_ARCHIVE_H
+
+/* glib */
+#include <glib-2.0/glib.h>
+
+/* alpm list */
+#include <alpm_list.h>
+
+typedef struct _news_item_t {
+    gchar   *title;
+    gchar   *date;
+    gchar   *link;
+    gchar   *description;
+} news_item_t;
+
+void
+free_news_item (news_item_t *item);
+
+#define FREE_NEWS_ITEMS_LIST(p)    do { \
+    alpm_list_free_inner (p, (alpm_list_fn_free) free_news_item); \
+    alpm_list_free (p); \
+    p = NULL; } while(0)
+
+gboolean
+news_archive_add (alpm_list_t *items, GError **error);
+
+alpm_list_t *
+news_archive_get_items (const gchar *search, GError **error);
+
+#endif /* _KALU_NEWS_ARCHIVE_H */
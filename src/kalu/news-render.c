@@ -0,0 +1,435 @@
+/**
+ * kalu - Copyright (C) 2012-2018 Olivier Brunel
+ *
+ * news-render.c
+ * Copyright (C) 2012-2017 Olivier Brunel <jjk@jjacky.com>
+ *
+ * This file is part of kalu.
+ *
+ * kalu is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * kalu is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * kalu. If not, see http://www.gnu.org/licenses/
+ */
+
+#include <config.h>
+
+/* C */
+#include <string.h>
+
+/* gtk */
+#include <gtk/gtk.h>
+
+/* alpm list */
+#include <alpm_list.h>
+
+/* kalu */
+#include "kalu.h"
+#include "news-render.h"
+
+void
+news_render_create_tags (GtkTextBuffer *buffer)
+{
+    /* create tags */
+    GdkRGBA color;
+
+    gdk_rgba_parse (&color, "rgb(0,119,187)");
+    gtk_text_buffer_create_tag (buffer, "title",
+            "size-points",      10.0,
+            "weight",           800,
+            "foreground-rgba",  &color,
+            NULL);
+
+    gtk_text_buffer_create_tag (buffer, "bold",
+            "weight",           800,
+            NULL);
+
+    gdk_rgba_parse (&color, "rgb(255,255,221)");
+    gtk_text_buffer_create_tag (buffer, "code",
+            "family",           "Monospace",
+            "background-rgba",  &color,
+            NULL);
+
+    gdk_rgba_parse (&color, "rgb(221,255,221)");
+    gtk_text_buffer_create_tag (buffer, "pre",
+            "family",           "Monospace",
+            "background-rgba",  &color,
+            NULL);
+
+    gtk_text_buffer_create_tag (buffer, "italic",
+            "style",            PANGO_STYLE_ITALIC,
+            NULL);
+
+    gtk_text_buffer_create_tag (buffer, "listitem",
+            "left-margin",      15,
+            NULL);
+}
+
+/* inserts text at iter (moved to its end), applying all tags (names) */
+static void
+insert_with_tags (GtkTextBuffer *buffer,
+                  GtkTextIter   *iter,
+                  GtkTextMark   *mark,
+                  GString       *text,
+                  alpm_list_t   *tags)
+{
+    GtkTextIter  start;
+    alpm_list_t *i;
+
+    if (text->len == 0)
+    {
+        return;
+    }
+
+    gtk_text_buffer_move_mark (buffer, mark, iter);
+    gtk_text_buffer_insert (buffer, iter, text->str, (gint) text->len);
+    gtk_text_buffer_get_iter_at_mark (buffer, &start, mark);
+    FOR_LIST (i, tags)
+    {
+        gtk_text_buffer_apply_tag_by_name (buffer, i->data, &start, iter);
+    }
+    g_string_truncate (text, 0);
+}
+
+/* if s is an HTML entity we know, puts its char in c and returns its length */
+static gsize
+parse_entity (const gchar *s, const gchar *end, gchar *c)
+{
+    static const struct {
+        const gchar *name;
+        gsize        len;
+        gchar        c;
+    } entities[] = {
+        { "minus",  5, '-' },
+        { "lsquo",  5, '`' },
+        { "rsquo",  5, '\'' },
+        { "quot",   4, '"' },
+        { "amp",    3, '&' },
+        { "lt",     2, '<' },
+        { "gt",     2, '>' },
+    };
+    guint e;
+
+    for (e = 0; e < G_N_ELEMENTS (entities); ++e)
+    {
+        if ((gsize) (end - s) >= entities[e].len + 2
+                && s[entities[e].len + 1] == ';'
+                && strncmp (s + 1, entities[e].name, entities[e].len) == 0)
+        {
+            *c = entities[e].c;
+            return entities[e].len + 2;
+        }
+    }
+    return 0;
+}
+
+static inline gboolean
+is_tag (const gchar *name, gsize len, const gchar *tag)
+{
+    return strlen (tag) == len && strncmp (name, tag, len) == 0;
+}
+
+/* renders the HTML text into buffer, in one pass: text is accumulated until a
+ * tag changes formatting, at which point it is inserted with current tags */
+void
+news_render_html (GtkTextBuffer *buffer, const gchar *text, gsize text_len)
+{
+    GtkTextIter  iter, iter2;
+    GtkTextMark *mark;
+    GtkTextMark *mark_link = NULL;
+    GtkTextTag  *tag;
+    GString     *run;
+    alpm_list_t *i, *tags = NULL;
+    const gchar *p, *end, *close, *name, *ss;
+    gsize        name_len, len;
+    gchar        buf[10];
+    gchar        c;
+    gint         margin;
+    gint         in_ordered_list = -1;
+    gboolean     in_code = FALSE;
+    GdkRGBA      color;
+    gchar       *link = NULL;
+
+    /* color used for links */
+    gdk_rgba_parse (&color, "rgb(0,119,187)");
+
+    gtk_text_buffer_get_end_iter (buffer, &iter);
+    mark = gtk_text_buffer_create_mark (buffer, NULL, &iter, TRUE);
+    run = g_string_sized_new (text_len);
+
+    p = text;
+    end = text + text_len;
+    while (p < end)
+    {
+        if (*p == '&')
+        {
+            len = parse_entity (p, end, &c);
+            if (len > 0)
+            {
+                g_string_append_c (run, c);
+                p += len;
+            }
+            else
+            {
+                g_string_append_c (run, *p++);
+            }
+            continue;
+        }
+        else if (*p == '\n')
+        {
+            /* inside <code> blocs, \n must not be converted to space */
+            g_string_append_c (run, (in_code) ? '\n' : ' ');
+            ++p;
+            continue;
+        }
+        else if (*p != '<')
+        {
+            /* plain text, up to the next char of interest */
+            for (ss = p; ss < end && *ss != '<' && *ss != '&' && *ss != '\n'; ++ss)
+                ;
+            g_string_append_len (run, p, ss - p);
+            p = ss;
+            continue;
+        }
+
+        /* a tag */
+        close = memchr (p, '>', (size_t) (end - p));
+        if (!close)
+        {
+            /* not a tag, then */
+            g_string_append_c (run, *p++);
+            continue;
+        }
+        name = p + 1;
+        name_len = (gsize) (close - name);
+        p = close + 1;
+
+        if (name_len >= 2 && name[0] == 'b' && name[1] == 'r')
+        {
+            g_string_append_c (run, '\n');
+        }
+        else if (name_len >= 1 && name[0] == 'p'
+                && (name_len == 1 || name[1] == ' '))
+        {
+            insert_with_tags (buffer, &iter, mark, run, tags);
+            gtk_text_buffer_insert (buffer, &iter, "\n", -1);
+
+            /* look for the margin-left style, and create a corresponding tag.
+             * This is useful when showing the (HTML) man page */
+            if ((ss = g_strstr_len (name, (gssize) name_len, "margin-left:")))
+            {
+                ss += 12; /* 12 = strlen ("margin-left:") */
+                for (margin = 0; ss < close && *ss >= '0' && *ss <= '9'; ++ss)
+                {
+                    margin = margin * 10 + (*ss - '0');
+                }
+                snprintf (buf, 10, "margin%d", margin);
+                if (!gtk_text_tag_table_lookup (
+                            gtk_text_buffer_get_tag_table (buffer),
+                            buf))
+                {
+                    gtk_text_buffer_create_tag (buffer, buf,
+                            "left-margin",      margin,
+                            NULL);
+                }
+                tags = alpm_list_add (tags, (void *) g_intern_string (buf));
+            }
+        }
+        else if (is_tag (name, name_len, "/p"))
+        {
+            insert_with_tags (buffer, &iter, mark, run, tags);
+            gtk_text_buffer_insert (buffer, &iter, "\n", -1);
+
+            /* when showing the (HTML) man page, <p> tags (might) have a margin,
+             * that should be closed here. we assume proper HTML, no recursion
+             * and whatnot, but that should be the case
+             * Go through tags from last to first (first->prev is last) and
+             * remove the first margin found */
+            for (i = alpm_list_last (tags); i; i = (i == tags) ? NULL : i->prev)
+            {
+                if (strncmp (i->data, "margin", 6) == 0)
+                {
+                    tags = alpm_list_remove_item (tags, i);
+                    free (i);
+                    break;
+                }
+            }
+        }
+        else if (is_tag (name, name_len, "strong") || is_tag (name, name_len, "b"))
+        {
+            insert_with_tags (buffer, &iter, mark, run, tags);
+            tags = alpm_list_add (tags, (void *) "bold");
+        }
+        else if (is_tag (name, name_len, "/strong") || is_tag (name, name_len, "/b"))
+        {
+            insert_with_tags (buffer, &iter, mark, run, tags);
+            tags = alpm_list_remove_str (tags, "bold", NULL);
+        }
+        else if (is_tag (name, name_len, "code"))
+        {
+            insert_with_tags (buffer, &iter, mark, run, tags);
+            tags = alpm_list_add (tags, (void *) "code");
+            in_code = TRUE;
+        }
+        else if (is_tag (name, name_len, "/code"))
+        {
+            insert_with_tags (buffer, &iter, mark, run, tags);
+            tags = alpm_list_remove_str (tags, "code", NULL);
+            in_code = FALSE;
+        }
+        else if (is_tag (name, name_len, "pre"))
+        {
+            insert_with_tags (buffer, &iter, mark, run, tags);
+            tags = alpm_list_add (tags, (void *) "pre");
+        }
+        else if (is_tag (name, name_len, "/pre"))
+        {
+            insert_with_tags (buffer, &iter, mark, run, tags);
+            tags = alpm_list_remove_str (tags, "pre", NULL);
+        }
+        else if (is_tag (name, name_len, "h2"))
+        {
+            insert_with_tags (buffer, &iter, mark, run, tags);
+            gtk_text_buffer_insert (buffer, &iter, "\n", -1);
+            tags = alpm_list_add (tags, (void *) "title");
+        }
+        else if (is_tag (name, name_len, "/h2"))
+        {
+            insert_with_tags (buffer, &iter, mark, run, tags);
+            gtk_text_buffer_insert (buffer, &iter, "\n", -1);
+            tags = alpm_list_remove_str (tags, "title", NULL);
+        }
+        else if (is_tag (name, name_len, "i"))
+        {
+            insert_with_tags (buffer, &iter, mark, run, tags);
+            tags = alpm_list_add (tags, (void *) "italic");
+        }
+        else if (is_tag (name, name_len, "/i"))
+        {
+            insert_with_tags (buffer, &iter, mark, run, tags);
+            tags = alpm_list_remove_str (tags, "italic", NULL);
+        }
+        else if (is_tag (name, name_len, "ul"))
+        {
+            insert_with_tags (buffer, &iter, mark, run, tags);
+            gtk_text_buffer_insert (buffer, &iter, "\n", -1);
+        }
+        else if (is_tag (name, name_len, "ol"))
+        {
+            insert_with_tags (buffer, &iter, mark, run, tags);
+            gtk_text_buffer_insert (buffer, &iter, "\n", -1);
+            in_ordered_list = 0;
+        }
+        else if (is_tag (name, name_len, "li"))
+        {
+            insert_with_tags (buffer, &iter, mark, run, tags);
+            gtk_text_buffer_insert (buffer, &iter, "\n", -1);
+            tags = alpm_list_add (tags, (void *) "listitem");
+            if (in_ordered_list == -1)
+            {
+                g_string_append (run, "• ");
+            }
+            else
+            {
+                g_string_append_printf (run, "%d. ", ++in_ordered_list);
+            }
+        }
+        else if (is_tag (name, name_len, "/li"))
+        {
+            insert_with_tags (buffer, &iter, mark, run, tags);
+            gtk_text_buffer_insert (buffer, &iter, "\n", -1);
+            tags = alpm_list_remove_str (tags, "listitem", NULL);
+        }
+        else if (is_tag (name, name_len, "/ol"))
+        {
+            insert_with_tags (buffer, &iter, mark, run, tags);
+            in_ordered_list = -1;
+        }
+        else if (name_len >= 2 && name[0] == 'a' && name[1] == ' ')
+        {
+            const gchar *url, *url_end;
+
+            insert_with_tags (buffer, &iter, mark, run, tags);
+            free (link);
+            link = NULL;
+            /* get URL */
+            if ((url = g_strstr_len (name, (gssize) name_len, "href"))
+                    && (url = memchr (url, '"', (size_t) (close - url)))
+                    && (url_end = memchr (url + 1, '"', (size_t) (close - url - 1))))
+            {
+                ++url;
+                GString *str = g_string_sized_new ((gsize) (url_end - url) + 25);
+
+                /* links on Arch's website don't always include the http:// part */
+                if (*url == '/')
+                {
+                    /* TODO: get domain from NEWS_RSS_URL */
+                    g_string_append (str, "http://www.archlinux.org");
+                }
+                while (url < url_end)
+                {
+                    len = (*url == '&') ? parse_entity (url, url_end, &c) : 0;
+                    if (len > 0)
+                    {
+                        g_string_append_c (str, c);
+                        url += len;
+                    }
+                    else
+                    {
+                        g_string_append_c (str, *url++);
+                    }
+                }
+                link = strdup (str->str);
+                g_string_free (str, TRUE);
+
+                /* remember where the link starts */
+                if (mark_link)
+                {
+                    gtk_text_buffer_move_mark (buffer, mark_link, &iter);
+                }
+                else
+                {
+                    mark_link = gtk_text_buffer_create_mark (buffer, NULL,
+                            &iter, TRUE);
+                }
+            }
+        }
+        else if (is_tag (name, name_len, "/a"))
+        {
+            insert_with_tags (buffer, &iter, mark, run, tags);
+            if (link)
+            {
+                /* create a new tag, so we can set the link to it */
+                tag = gtk_text_buffer_create_tag (buffer, NULL,
+                        "foreground-rgba",  &color,
+                        "underline",        PANGO_UNDERLINE_SINGLE,
+                        NULL);
+                /* set link, and apply it */
+                g_object_set_data_full (G_OBJECT (tag), "link", link, free);
+                gtk_text_buffer_get_iter_at_mark (buffer, &iter2, mark_link);
+                gtk_text_buffer_apply_tag (buffer, tag, &iter2, &iter);
+                /* done */
+                link = NULL;
+            }
+        }
+        /* unknown tag - just skip it */
+    }
+    insert_with_tags (buffer, &iter, mark, run, tags);
+
+    if (mark_link)
+    {
+        gtk_text_buffer_delete_mark (buffer, mark_link);
+    }
+    gtk_text_buffer_delete_mark (buffer, mark);
+    g_string_free (run, TRUE);
+    free (link);
+    alpm_list_free (tags);
+}
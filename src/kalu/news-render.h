@@ -0,0 +1,37 @@
+/**
+ * kalu - Copyright (C) 2012-2018 Olivier Brunel
+ *
+ * news-render.h
+ * Copyright (C) 2012-2017 Olivier Brunel <jjk@jjacky.com>
+ *
+ * This file is part of kalu.
+ *
+ * kalu is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * kalu is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * kalu. If not, see http://www.gnu.org/licenses/
+ */
+
+#ifndef _KALU_NEWS_RENDER_H
+#define _KALU_NEWS_RENDER_H
+
+/* gtk */
+#include <gtk/gtk.h>
+
+/* creates the tags used by news_render_html() in buffer */
+void
+news_render_create_tags (GtkTextBuffer *buffer);
+
+/* appends the (news/man page) HTML text to buffer */
+void
+news_render_html (GtkTextBuffer *buffer, const gchar *text, gsize text_len);
+
+#endif /* _KALU_NEWS_RENDER_H */
@@ -37,10 +37,13 @@
 /* kalu */
 #include "kalu.h"
 #include "news.h"
+#include "conf.h"
 #include "curl.h"
+#include "news-archive.h"
 #include "util.h"
 #ifndef DISABLE_GUI
 #include "util-gtk.h"
+#include "news-render.h"
 #include "gui.h" /* show_notif() */
 #endif
 
@@ -51,10 +54,23 @@ enum {
     NB_LISTS
 };
 
-typedef struct _parse_updates_data_t {
-    gboolean     is_last_reached;
+/* called with every (complete) item parsed, which it then owns. Return FALSE
+ * to stop parsing */
+typedef gboolean (*news_item_fn) (news_item_t *item, gpointer data);
+
+typedef struct _parse_items_data_t {
+    GMarkupParseContext *context;
+    GError              *error;
+    news_item_fn         item_fn;
+    gpointer             item_data;
+    news_item_t         *item;
+    gboolean             stopped;
+} parse_items_data_t;
+
+typedef struct _check_data_t {
+    alpm_list_t *items;
     alpm_list_t *titles;
-} parse_updates_data_t;
+} check_data_t;
 
 #ifndef DISABLE_GUI
 
@@ -67,27 +83,9 @@ typedef struct _parse_news_data_t {
     GtkTextBuffer   *buffer;
     PangoAttrList   *attr_list;
 
-    gboolean         is_last_reached;
     alpm_list_t    **lists;
 } parse_news_data_t;
 
-typedef void (*GMP_text_fn) (GMarkupParseContext *context,
-                             const gchar         *text,
-                             gsize                text_len,
-                             gpointer             user_data,
-                             GError             **error);
-
-static void
-create_tags (GtkTextBuffer *buffer);
-
-static void
-xml_parser_news_text (GMarkupParseContext *context,
-                      const gchar         *text,
-                      gsize                text_len,
-                      parse_news_data_t   *parse_news_data,
-                      GError             **error _UNUSED_);
-
-
 /* TRUE when hovering over a link */
 static gboolean hovering_link = FALSE;
 /* standard & hover-link cursors */
@@ -96,174 +94,244 @@ static GdkCursor *cursor_link = NULL;
 /* nb of windows open */
 static gint nb_windows = 0;
 
+#endif /* DISABLE_GUI */
 
 static void
-xml_parser_updates_text (GMarkupParseContext   *context,
-                         const gchar           *text,
-                         gsize                  text_len _UNUSED_,
-                         parse_updates_data_t  *parse_updates_data,
-                         GError               **error _UNUSED_)
+xml_parser_items_start (GMarkupParseContext  *context _UNUSED_,
+                        const gchar          *element_name,
+                        const gchar         **attribute_names _UNUSED_,
+                        const gchar         **attribute_values _UNUSED_,
+                        gpointer              user_data,
+                        GError              **error _UNUSED_)
 {
-    const GSList         *list;
-    alpm_list_t          *i;
+    parse_items_data_t *data = user_data;
 
-    /* have we already reached the last unread item */
-    if (parse_updates_data->is_last_reached)
+    if (streq ("item", element_name))
     {
-        return;
+        free_news_item (data->item);
+        data->item = new0 (news_item_t, 1);
     }
+}
+
+static void
+xml_parser_items_text (GMarkupParseContext  *context,
+                       const gchar          *text,
+                       gsize                 text_len,
+                       gpointer              user_data,
+                       GError              **error _UNUSED_)
+{
+    parse_items_data_t *data = user_data;
+    const GSList *list;
+    gchar       **field;
 
     /* is this a tag (title, description, ...) inside an item? */
     list = g_markup_parse_context_get_element_stack (context);
-    if (!list->next || !streq ("item", list->next->data))
+    if (!data->item || !list->next || !streq ("item", list->next->data))
     {
         return;
     }
 
     if (streq ("title", list->data))
     {
-        gchar *s = (gchar *) text;
-
-        /* if it needs trimming, let's do it. (If not we use text as-is to avoid
-         * a possibly unneeded call strdup) */
-        if (isspace (*s) || isspace (s[strlen (s) - 1]))
-        {
-            s = strtrim (strdup (s));
-        }
-
-        /* is this the last item from last check? */
-        if (NULL != config->news_last && streq (config->news_last, s))
-        {
-            parse_updates_data->is_last_reached = TRUE;
-            if (s != text)
-            {
-                free (s);
-            }
-            return;
-        }
+        field = &data->item->title;
+    }
+    else if (streq ("pubDate", list->data))
+    {
+        field = &data->item->date;
+    }
+    else if (streq ("link", list->data))
+    {
+        field = &data->item->link;
+    }
+    else if (streq ("description", list->data))
+    {
+        field = &data->item->description;
+    }
+    else
+    {
+        return;
+    }
 
-        /* was this item already read? */
-        FOR_LIST (i, config->news_read)
-        {
-            if (streq (i->data, s))
-            {
-                if (s != text)
-                {
-                    free (s);
-                }
-                return;
-            }
-        }
+    /* text might come in more than one go, e.g. with CDATA */
+    if (*field)
+    {
+        gsize len = strlen (*field);
 
-        /* add title to the new news */
-        if (s == text)
-        {
-            s = strdup (s);
-        }
-        parse_updates_data->titles = alpm_list_add (parse_updates_data->titles, s);
+        *field = renew (gchar, len + text_len + 1, *field);
+        memcpy (*field + len, text, text_len);
+        (*field)[len + text_len] = '\0';
+    }
+    else
+    {
+        *field = strndup (text, text_len);
     }
 }
 
-#endif /* DISABLE_GUI */
-
-static gboolean
-parse_xml (gchar *xml, gboolean for_updates, gpointer data_out, GError **error)
+static void
+xml_parser_items_end (GMarkupParseContext  *context _UNUSED_,
+                      const gchar          *element_name,
+                      gpointer              user_data,
+                      GError              **error)
 {
-    GMarkupParseContext *context;
-    GMarkupParser        parser;
-    GError              *local_err = NULL;
+    parse_items_data_t *data = user_data;
+    news_item_t *item = data->item;
 
-    zero (parser);
-    if (for_updates)
+    if (!item || !streq ("item", element_name))
     {
-#ifndef DISABLE_GUI
-        parser.text = (GMP_text_fn) xml_parser_updates_text;
-#endif
+        return;
     }
-    else
+    data->item = NULL;
+
+    if (!item->title)
     {
-#ifdef DISABLE_GUI
-        return FALSE;
-#else
-        parse_news_data_t   *data;
-        GtkTextBuffer       *buffer;
+        free_news_item (item);
+        return;
+    }
+    strtrim (item->title);
+    if (!item->date)
+    {
+        item->date = strdup ("");
+    }
+    if (!item->link)
+    {
+        item->link = strdup ("");
+    }
+    if (!item->description)
+    {
+        item->description = strdup ("");
+    }
 
-        parser.text = (GMP_text_fn) xml_parser_news_text;
-        data = data_out;
-        buffer = data->buffer;
+    if (!data->item_fn (item, data->item_data))
+    {
+        data->stopped = TRUE;
+        /* nothing more of interest, so stop the parsing right here */
+        g_set_error_literal (error, KALU_ERROR, 0, "parsing stopped");
+    }
+}
 
-        create_tags (buffer);
+static void
+init_items_parser (parse_items_data_t *data,
+                   news_item_fn        item_fn,
+                   gpointer            item_data)
+{
+    static GMarkupParser parser = {
+        .start_element  = xml_parser_items_start,
+        .end_element    = xml_parser_items_end,
+        .text           = xml_parser_items_text,
+    };
+
+    zero (*data);
+    data->item_fn = item_fn;
+    data->item_data = item_data;
+    data->context = g_markup_parse_context_new (&parser,
+            G_MARKUP_TREAT_CDATA_AS_TEXT, data, NULL);
+}
 
-        if (data->only_updates)
+static void
+free_items_parser (parse_items_data_t *data)
+{
+    g_markup_parse_context_free (data->context);
+    free_news_item (data->item);
+}
+
+/* feeds the parser with data as it gets downloaded, and stops the download
+ * as soon as parsing is stopped (or on error) */
+static gboolean
+parse_items_chunk (const char         *chunk,
+                   size_t              len,
+                   parse_items_data_t *data)
+{
+    if (!g_markup_parse_context_parse (data->context, chunk, (gssize) len,
+                &data->error))
+    {
+        if (data->stopped)
         {
-            /* create a attribute list, for labels of check-titles */
-            PangoAttribute *attr;
-
-            data->attr_list = pango_attr_list_new ();
-            attr = pango_attr_weight_new (800);
-            pango_attr_list_insert (data->attr_list, attr);
-            attr = pango_attr_size_new (10 * PANGO_SCALE);
-            pango_attr_list_insert (data->attr_list, attr);
-            attr = pango_attr_foreground_new (0, 30583, 48059);
-            pango_attr_list_insert (data->attr_list, attr);
+            g_clear_error (&data->error);
         }
-#endif
+        return FALSE;
+    }
+    return TRUE;
+}
 
+/* downloads the news feed, calling item_fn for each item */
+static gboolean
+download_items (news_item_fn item_fn, gpointer item_data, GError **error)
+{
+    GError             *local_err = NULL;
+    parse_items_data_t  data;
+
+    init_items_parser (&data, item_fn, item_data);
+    curl_download_stream (NEWS_RSS_URL,
+            (curl_stream_fn) parse_items_chunk, &data, &local_err);
+    /* unless we stopped it, make sure the document was complete, i.e. the
+     * transfer wasn't cut short */
+    if (!local_err && !data.error && !data.stopped)
+    {
+        g_markup_parse_context_end_parse (data.context, &data.error);
     }
-    context = g_markup_parse_context_new (&parser, G_MARKUP_TREAT_CDATA_AS_TEXT,
-            data_out, NULL);
+    free_items_parser (&data);
 
-    if (!g_markup_parse_context_parse (context,
-                xml,
-                (gssize) strlen (xml),
-                &local_err))
+    if (local_err != NULL)
     {
-        g_markup_parse_context_free (context);
-#ifndef DISABLE_GUI
-        if (!for_updates && ((parse_news_data_t *)data_out)->only_updates)
-        {
-            pango_attr_list_unref (((parse_news_data_t *)data_out)->attr_list);
-        }
-#endif
+        g_clear_error (&data.error);
         g_propagate_error (error, local_err);
         return FALSE;
     }
-    g_markup_parse_context_free (context);
-#ifndef DISABLE_GUI
-    if (!for_updates && ((parse_news_data_t *)data_out)->only_updates)
+    else if (data.error != NULL)
     {
-        pango_attr_list_unref (((parse_news_data_t *)data_out)->attr_list);
+        g_propagate_error (error, data.error);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static gboolean
+check_item (news_item_t *item, check_data_t *data)
+{
+    /* all go in the archive */
+    data->items = alpm_list_add (data->items, item);
+
+    /* is this the last item from last check? */
+    if (NULL != config->news_last && streq (config->news_last, item->title))
+    {
+        return FALSE;
+    }
+
+    /* was this item already read? */
+    if (!g_hash_table_contains (config->news_read, item->title))
+    {
+        /* add title to the new news */
+        data->titles = alpm_list_add (data->titles, strdup (item->title));
     }
-#endif
     return TRUE;
 }
 
 gboolean
 news_has_updates (alpm_list_t **titles,
-                  gchar       **xml_news,
                   GError      **error)
 {
-    GError               *local_err = NULL;
-    parse_updates_data_t  data;
+    GError       *local_err = NULL;
+    check_data_t  data;
 
-    *xml_news = curl_download (NEWS_RSS_URL, &local_err);
-    if (local_err != NULL)
+    zero (data);
+    if (!download_items ((news_item_fn) check_item, &data, &local_err))
     {
+        FREE_NEWS_ITEMS_LIST (data.items);
+        FREELIST (data.titles);
         g_propagate_error (error, local_err);
         return FALSE;
     }
 
-    zero (data);
-    if (!parse_xml (*xml_news, TRUE, (gpointer) &data, &local_err))
+    /* so the news can be shown without having to download them again */
+    if (!news_archive_add (data.items, &local_err))
     {
-        free (*xml_news);
-        g_propagate_error (error, local_err);
-        return FALSE;
+        debug ("unable to archive news: %s", local_err->message);
+        g_clear_error (&local_err);
     }
+    FREE_NEWS_ITEMS_LIST (data.items);
 
     if (data.titles == NULL)
     {
-        free (*xml_news);
         return FALSE;
     }
     else
@@ -295,542 +363,77 @@ title_toggled_cb (GtkToggleButton *button, alpm_list_t **lists)
     }
 }
 
-#define insert_text_with_tags() do {                                        \
-    gtk_text_buffer_move_mark (buffer, mark, &iter);                        \
-    gtk_text_buffer_insert (buffer, &iter, ss, -1);                         \
-    gtk_text_buffer_get_iter_at_mark (buffer, &iter2, mark);                \
-    FOR_LIST (i, tags)                                                      \
-    {                                                                       \
-        gtk_text_buffer_apply_tag_by_name (buffer, i->data, &iter, &iter2); \
-    }                                                                       \
-} while (0)
-static void
-parse_to_buffer (GtkTextBuffer *buffer, const gchar *text, gsize text_len)
-{
-    GtkTextIter  iter, iter2;
-    GtkTextMark *mark;
-    GtkTextTag  *tag;
-    alpm_list_t *i, *tags = NULL;
-    gchar       *s, *ss, *start, *end;
-    gchar        buf[10];
-    gint         c, margin;
-    gint         in_ordered_list = -1;
-    GdkRGBA      color;
-    gchar       *link = NULL;
-
-    s = new (gchar, text_len + 2);
-    snprintf (s, text_len + 1, "%s", text);
-
-    /* color used for links */
-    gdk_rgba_parse (&color, "rgb(0,119,187)");
-
-    /* inside <code> blocs, \n must not be converted to space */
-    start = s;
-    while ((start = strstr (start, "<code>")))
-    {
-        if (!(end = strstr (start, "</code>")))
-        {
-            break;
-        }
-        /* for now, we turn them into \r */
-        while ((ss = strchr (start, '\n')) && ss < end)
-        {
-            *ss = '\r';
-        }
-        start = end;
-    }
-    /* \n replaced by space */
-    while ((ss = strchr (s, '\n')))
-    {
-        *ss = ' ';
-    }
-    /* turn the \r from <code> blocks into \n */
-    while ((ss = strchr (s, '\r')))
-    {
-        *ss = '\n';
-    }
-    /* now turn <br> into \n */
-    while ((ss = strstr (s, "<br")))
-    {
-        if (!(end = strchr (ss, '>')))
-        {
-            break;
-        }
-        *ss = '\n';
-        start = end + 1;
-        memmove (++ss, start, strlen (start) + 1);
-    }
-    /* convert some HTML stuff */
-    ss = s;
-    while ((ss = strchr (ss, '&')))
-    {
-        end = strchr (++ss, ';');
-        if (!end)
-        {
-            break;
-        }
-        *end = '\0';
-        if (streq (ss, "minus"))
-        {
-            *--ss = '-';
-            ++end;
-            memmove (++ss, end, strlen (end) + 1);
-        }
-        else if (streq (ss, "lsquo"))
-        {
-            *--ss = '`';
-            ++end;
-            memmove (++ss, end, strlen (end) + 1);
-        }
-        else if (streq (ss, "rsquo"))
-        {
-            *--ss = '\'';
-            ++end;
-            memmove (++ss, end, strlen (end) + 1);
-        }
-        else if (streq (ss, "quot"))
-        {
-            *--ss = '"';
-            ++end;
-            memmove (++ss, end, strlen (end) + 1);
-        }
-        else if (streq (ss, "amp"))
-        {
-            *--ss = '&';
-            ++end;
-            memmove (++ss, end, strlen (end) + 1);
-        }
-        else if (streq (ss, "lt"))
-        {
-            *--ss = '<';
-            *end = '>';
-        }
-        else if (streq (ss, "gt"))
-        {
-            *--ss = '<';
-            *end = '>';
-        }
-        else
-        {
-            *end = ';';
-            ss = end + 1;
-        }
-    }
-
-    gtk_text_buffer_get_end_iter (buffer, &iter);
-    mark = gtk_text_buffer_create_mark (buffer, "mark", &iter, TRUE);
-
-    ss = s;
-    while ((start = strchr (ss, '<')))
-    {
-        if (NULL == (end = strchr (start, '>')))
-        {
-            break;
-        }
-        *end = '\0';
-        if (*(start + 1) == 'p' && (*(start + 2) == '\0'
-                    || *(start + 2) == ' '))
-        {
-            *start = '\0';
-            insert_text_with_tags ();
-            gtk_text_buffer_insert (buffer, &iter, "\n", -1);
-
-            /* look for the margin-left style, and create a corresponding tag.
-             * This is useful when showing the (HTML) man page */
-            ++start;
-            if ((ss = strstr (start, "margin-left:")))
-            {
-                ss += 12; /* 12 = strlen ("margin-left:") */
-                for (c = 0, margin = 0; *ss >= '0' && *ss <= '9'; ++ss, ++c)
-                {
-                    margin = margin * 10 + (*ss - '0');
-                }
-                snprintf (buf, 10, "margin%d", margin);
-                if (!gtk_text_tag_table_lookup (
-                            gtk_text_buffer_get_tag_table (buffer),
-                            buf))
-                {
-                    gtk_text_buffer_create_tag (buffer, buf,
-                            "left-margin",      margin,
-                            NULL);
-                }
-                tags = alpm_list_add (tags, (void *) buf);
-            }
-        }
-        else if (streq (start + 1, "/p"))
-        {
-            *start = '\0';
-            insert_text_with_tags ();
-            gtk_text_buffer_insert (buffer, &iter, "\n", -1);
-
-            /* when showing the (HTML) man page, <p> tags (might) have a margin,
-             * that should be closed here. we assume proper HTML, no recursion
-             * and whatnot, but that should be the case
-             * Go through tags from last to first (first->prev is last) and
-             * remove the first margin found */
-            if (tags)
-                for (i = tags->prev; i; i = i->prev)
-                {
-                    if (strncmp (i->data, "margin", 6) == 0)
-                    {
-                        tags = alpm_list_remove_str (tags, i->data, NULL);
-                        break;
-                    }
-                    else if (!i->prev->next)
-                        /* i is the first element */
-                        break;
-                }
-
-        }
-        else if (streq (start + 1, "strong"))
-        {
-            *start = '\0';
-            insert_text_with_tags ();
-            tags = alpm_list_add (tags, (void *) "bold");
-        }
-        else if (streq (start + 1, "/strong"))
-        {
-            *start = '\0';
-            insert_text_with_tags ();
-            tags = alpm_list_remove_str (tags, "bold", NULL);
-        }
-        else if (streq (start + 1, "b"))
-        {
-            *start = '\0';
-            insert_text_with_tags ();
-            tags = alpm_list_add (tags, (void *) "bold");
-        }
-        else if (streq (start + 1, "/b"))
-        {
-            *start = '\0';
-            insert_text_with_tags ();
-            tags = alpm_list_remove_str (tags, "bold", NULL);
-        }
-        else if (streq (start + 1, "code"))
-        {
-            *start = '\0';
-            insert_text_with_tags ();
-            tags = alpm_list_add (tags, (void *) "code");
-        }
-        else if (streq (start + 1, "/code"))
-        {
-            *start = '\0';
-            insert_text_with_tags ();
-            tags = alpm_list_remove_str (tags, "code", NULL);
-        }
-        else if (streq (start + 1, "pre"))
-        {
-            *start = '\0';
-            insert_text_with_tags ();
-            tags = alpm_list_add (tags, (void *) "pre");
-        }
-        else if (streq (start + 1, "/pre"))
-        {
-            *start = '\0';
-            insert_text_with_tags ();
-            tags = alpm_list_remove_str (tags, "pre", NULL);
-        }
-        else if (streq (start + 1, "h2"))
-        {
-            *start = '\0';
-            insert_text_with_tags ();
-            gtk_text_buffer_insert (buffer, &iter, "\n", -1);
-            tags = alpm_list_add (tags, (void *) "title");
-        }
-        else if (streq (start + 1, "/h2"))
-        {
-            *start = '\0';
-            insert_text_with_tags ();
-            gtk_text_buffer_insert (buffer, &iter, "\n", -1);
-            tags = alpm_list_remove_str (tags, "title", NULL);
-        }
-        else if (streq (start + 1, "i"))
-        {
-            *start = '\0';
-            insert_text_with_tags ();
-            tags = alpm_list_add (tags, (void *) "italic");
-        }
-        else if (streq (start + 1, "/i"))
-        {
-            *start = '\0';
-            insert_text_with_tags ();
-            tags = alpm_list_remove_str (tags, "italic", NULL);
-        }
-        else if (streq (start + 1, "ul"))
-        {
-            *start = '\0';
-            insert_text_with_tags ();
-            gtk_text_buffer_insert (buffer, &iter, "\n", -1);
-        }
-        else if (streq (start + 1, "ol"))
-        {
-            *start = '\0';
-            insert_text_with_tags ();
-            gtk_text_buffer_insert (buffer, &iter, "\n", -1);
-            in_ordered_list = 0;
-        }
-        else if (streq (start + 1, "li"))
-        {
-            *start = '\0';
-            insert_text_with_tags ();
-            gtk_text_buffer_insert (buffer, &iter, "\n", -1);
-            tags = alpm_list_add (tags, (void *) "listitem");
-            if (in_ordered_list == -1)
-            {
-                ss = (gchar *) "• ";
-            }
-            else
-            {
-                ++in_ordered_list;
-                snprintf (buf, 10, "%d. ", in_ordered_list);
-                ss = buf;
-            }
-            insert_text_with_tags ();
-        }
-        else if (streq (start + 1, "/li"))
-        {
-            *start = '\0';
-            insert_text_with_tags ();
-            gtk_text_buffer_insert (buffer, &iter, "\n", -1);
-            tags = alpm_list_remove_str (tags, "listitem", NULL);
-        }
-        else if (streq (start + 1, "/ol"))
-        {
-            *start = '\0';
-            insert_text_with_tags ();
-            in_ordered_list = -1;
-        }
-        else if (streq (start + 1, "lt"))
-        {
-            *start = '\0';
-            insert_text_with_tags ();
-            ss = (gchar *) "<";
-            insert_text_with_tags ();
-        }
-        else if (streq (start + 1, "gt"))
-        {
-            *start = '\0';
-            insert_text_with_tags ();
-            ss = (gchar *) ">";
-            insert_text_with_tags ();
-        }
-        else if (strncmp (start + 1, "a ", 2) == 0)
-        {
-            /* add the text */
-            *start = '\0';
-            insert_text_with_tags ();
-            /* get URL */
-            if ((link = strstr (start + 1, "href"))
-                    && (link = strchr (link, '"')))
-            {
-                /* got one, end it properly */
-                ss = strchr (++link, '"');
-                *ss = '\0';
-            }
-        }
-        else if (streq (start + 1, "/a"))
-        {
-            *start = '\0';
-            insert_text_with_tags ();
-            if (link)
-            {
-                /* create a new tag, so we can set the link to it */
-                tag = gtk_text_buffer_create_tag (buffer, NULL,
-                        "foreground-rgba",  &color,
-                        "underline",        PANGO_UNDERLINE_SINGLE,
-                        NULL);
-                /* links on Arch's website don't always include the http:// part */
-                if (link[0] == '/')
-                {
-                    ss = new (gchar, strlen (link) + 25);
-                    /* TODO: get domain from NEWS_RSS_URL */
-                    sprintf (ss, "http://www.archlinux.org%s", link);
-                    link = ss;
-                }
-                else
-                {
-                    link = strdup (link);
-                }
-                /* set link, and apply it */
-                g_object_set_data_full (G_OBJECT (tag), "link", link, free);
-                gtk_text_buffer_apply_tag (buffer, tag, &iter, &iter2);
-                /* done */
-                link = NULL;
-            }
-        }
-        else
-        {
-            /* unknown tag - just skip it */
-            *start = '\0';
-            insert_text_with_tags ();
-        }
-        ss = end + 1;
-    }
-    insert_text_with_tags ();
-
-    gtk_text_buffer_delete_mark (buffer, mark);
-    free (s);
-}
-#undef insert_text_with_tags
-
-static void
-xml_parser_news_text (GMarkupParseContext *context,
-                      const gchar         *text,
-                      gsize                text_len,
-                      parse_news_data_t   *parse_news_data,
-                      GError             **error _UNUSED_)
+/* adds item to the buffer. Returns FALSE when only showing updates and this was
+ * the last read news, i.e. no more item should be added */
+static gboolean
+add_item (parse_news_data_t *parse_news_data, news_item_t *item)
 {
     GtkTextBuffer   *buffer = parse_news_data->buffer;
     GtkTextIter     iter;
     gchar           *s = NULL;
-    const GSList    *list;
-    alpm_list_t     *i;
-    gboolean        is_title = FALSE;
-    static gboolean skip_next_description = FALSE;
-    alpm_list_t   **lists = NULL;
-
-    /* have we already reached the last unread item */
-    if (parse_news_data->only_updates && parse_news_data->is_last_reached)
-    {
-        return;
-    }
-
-    /* is this a tag (title, description, ...) inside an item? */
-    list = g_markup_parse_context_get_element_stack (context);
-    if (!list->next || !streq ("item", list->next->data))
-    {
-        return;
-    }
-
-    /* gather whether this is title or description, don't go any further if it's
-     * anything else*/
-    if (streq ("title", list->data))
-    {
-        is_title = TRUE;
-    }
-    else if (!streq ("description", list->data))
-    {
-        return;
-    }
+    alpm_list_t   **lists = parse_news_data->lists;
 
     if (parse_news_data->only_updates)
     {
-        if (is_title)
-        {
-            /* make a copy of the title, and store it in list of all titles */
-            /* it will not be free-d here. this is done on window_destroy_cb */
-            s = strtrim (strdup (text));
-            lists = parse_news_data->lists;
-            lists[LIST_TITLES_ALL] = alpm_list_add (lists[LIST_TITLES_ALL], s);
-
-            /* is this the last item from last check? */
-            if (NULL != config->news_last && streq (config->news_last, s))
-            {
-                parse_news_data->is_last_reached = TRUE;
-                return;
-            }
+        /* make a copy of the title, and store it in list of all titles */
+        /* it will not be free-d here. this is done on window_destroy_cb */
+        s = strdup (item->title);
+        lists[LIST_TITLES_ALL] = alpm_list_add (lists[LIST_TITLES_ALL], s);
 
-            /* was this item already read? */
-            FOR_LIST (i, config->news_read)
-            {
-                if (streq (i->data, s))
-                {
-                    /* make a note to skip its description as well */
-                    skip_next_description = TRUE;
-                    return;
-                }
-            }
+        /* is this the last item from last check? */
+        if (NULL != config->news_last && streq (config->news_last, s))
+        {
+            return FALSE;
         }
-        else if (skip_next_description)
+
+        /* was this item already read? */
+        if (g_hash_table_contains (config->news_read, s))
         {
-            skip_next_description = FALSE;
-            return;
+            return TRUE;
         }
     }
 
-    if (is_title)
-    {
-        /* add a LF */
-        gtk_text_buffer_get_end_iter (buffer, &iter);
-        gtk_text_buffer_insert (buffer, &iter, "\n", -1);
+    /* add a LF */
+    gtk_text_buffer_get_end_iter (buffer, &iter);
+    gtk_text_buffer_insert (buffer, &iter, "\n", -1);
 
-        if (parse_news_data->only_updates && lists)
-        {
-            GtkTextChildAnchor *anchor;
-            GtkWidget *check, *label;
-
-            /* store title in list of shown titles */
-            lists[LIST_TITLES_SHOWN] = alpm_list_add (lists[LIST_TITLES_SHOWN], s);
-
-            /* add a widget to check if the news should be marked read */
-            anchor = gtk_text_buffer_create_child_anchor(buffer, &iter);
-            check = gtk_check_button_new ();
-            /* we set as data the title, same as in the lists above. it will be
-             * used on toggled callback to be added to/removed from
-             * lists[LIST_TITLES_READ] */
-            g_object_set_data (G_OBJECT (check), "title", s);
-            g_signal_connect (G_OBJECT (check), "toggled",
-                    G_CALLBACK (title_toggled_cb), lists);
-            gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (check), TRUE);
-            gtk_widget_show (check);
-            label = gtk_label_new (text);
-            gtk_label_set_attributes (GTK_LABEL (label),
-                    parse_news_data->attr_list);
-            gtk_container_add (GTK_CONTAINER (check), label);
-            gtk_widget_show (label);
-            gtk_text_view_add_child_at_anchor (parse_news_data->textview,
-                    check,
-                    anchor);
-        }
-        else
-        {
-            gtk_text_buffer_insert_with_tags_by_name (buffer, &iter,
-                    text, -1, "title", NULL);
-        }
-        gtk_text_buffer_insert (buffer, &iter, "\n", -1);
+    if (parse_news_data->only_updates)
+    {
+        GtkTextChildAnchor *anchor;
+        GtkWidget *check, *label;
+
+        /* store title in list of shown titles */
+        lists[LIST_TITLES_SHOWN] = alpm_list_add (lists[LIST_TITLES_SHOWN], s);
+
+        /* add a widget to check if the news should be marked read */
+        anchor = gtk_text_buffer_create_child_anchor(buffer, &iter);
+        check = gtk_check_button_new ();
+        /* we set as data the title, same as in the lists above. it will be
+         * used on toggled callback to be added to/removed from
+         * lists[LIST_TITLES_READ] */
+        g_object_set_data (G_OBJECT (check), "title", s);
+        g_signal_connect (G_OBJECT (check), "toggled",
+                G_CALLBACK (title_toggled_cb), lists);
+        gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (check), TRUE);
+        gtk_widget_show (check);
+        label = gtk_label_new (item->title);
+        gtk_label_set_attributes (GTK_LABEL (label),
+                parse_news_data->attr_list);
+        gtk_container_add (GTK_CONTAINER (check), label);
+        gtk_widget_show (label);
+        gtk_text_view_add_child_at_anchor (parse_news_data->textview,
+                check,
+                anchor);
     }
     else
     {
-        parse_to_buffer (buffer, text, text_len);
+        gtk_text_buffer_insert_with_tags_by_name (buffer, &iter,
+                item->title, -1, "title", NULL);
     }
-}
+    gtk_text_buffer_insert (buffer, &iter, "\n", -1);
 
-static void
-create_tags (GtkTextBuffer *buffer)
-{
-    /* create tags */
-    GdkRGBA color;
-
-    gdk_rgba_parse (&color, "rgb(0,119,187)");
-    gtk_text_buffer_create_tag (buffer, "title",
-            "size-points",      10.0,
-            "weight",           800,
-            "foreground-rgba",  &color,
-            NULL);
-
-    gtk_text_buffer_create_tag (buffer, "bold",
-            "weight",           800,
-            NULL);
-
-    gdk_rgba_parse (&color, "rgb(255,255,221)");
-    gtk_text_buffer_create_tag (buffer, "code",
-            "family",           "Monospace",
-            "background-rgba",  &color,
-            NULL);
-
-    gdk_rgba_parse (&color, "rgb(221,255,221)");
-    gtk_text_buffer_create_tag (buffer, "pre",
-            "family",           "Monospace",
-            "background-rgba",  &color,
-            NULL);
-
-    gtk_text_buffer_create_tag (buffer, "italic",
-            "style",            PANGO_STYLE_ITALIC,
-            NULL);
-
-    gtk_text_buffer_create_tag (buffer, "listitem",
-            "left-margin",      15,
-            NULL);
+    news_render_html (buffer, item->description, strlen (item->description));
+    return TRUE;
 }
 
 static void
@@ -842,8 +445,9 @@ btn_close_cb (GtkWidget *button _UNUSED_, GtkWidget *window)
 static void
 btn_mark_cb (GtkWidget *button _UNUSED_, GtkWidget *window)
 {
-    alpm_list_t **lists, *titles_all, *titles_shown, *titles_read, *i;
-    alpm_list_t *news_read = NULL;
+    alpm_list_t **lists, *titles_all, *i;
+    GHashTable *titles_shown, *titles_read;
+    GHashTable *news_read;
     char *news_last = NULL;
     gboolean is_last_set = FALSE;
     int nb_unread = 0;
@@ -853,22 +457,32 @@ btn_mark_cb (GtkWidget *button _UNUSED_, GtkWidget *window)
     lists = g_object_get_data (G_OBJECT (window), "lists");
     /* reverse this one, to start with the oldest news */
     titles_all = alpm_list_reverse (lists[LIST_TITLES_ALL]);
-    titles_shown = lists[LIST_TITLES_SHOWN];
-    titles_read = lists[LIST_TITLES_READ];
+    titles_shown = g_hash_table_new (g_direct_hash, g_direct_equal);
+    FOR_LIST (i, lists[LIST_TITLES_SHOWN])
+    {
+        g_hash_table_add (titles_shown, i->data);
+    }
+    titles_read = g_hash_table_new (g_direct_hash, g_direct_equal);
+    FOR_LIST (i, lists[LIST_TITLES_READ])
+    {
+        g_hash_table_add (titles_read, i->data);
+    }
+    /* only news still in the feed end up in there, so older ones get dropped */
+    news_read = g_hash_table_new_full (g_str_hash, g_str_equal, free, NULL);
 
     FOR_LIST (i, titles_all)
     {
-        void *shown = alpm_list_find_ptr (titles_shown, i->data);
+        gboolean shown = g_hash_table_contains (titles_shown, i->data);
 
         /* was this news not shown, or shown and mark read? */
-        if (!shown || (shown && alpm_list_find_ptr (titles_read, i->data)))
+        if (!shown || g_hash_table_contains (titles_read, i->data))
         {
             /* was last already set? */
             if (is_last_set)
             {
                 /* then we add it to read */
                 debug ("read:%s", (char*)i->data);
-                news_read = alpm_list_add (news_read, strdup (i->data));
+                g_hash_table_add (news_read, strdup (i->data));
             }
             else
             {
@@ -894,69 +508,56 @@ btn_mark_cb (GtkWidget *button _UNUSED_, GtkWidget *window)
     /* we only free this like so, because everything else (including the data
      * in titles) will be free-d when destroying the window */
     alpm_list_free (titles_all);
+    g_hash_table_destroy (titles_shown);
+    g_hash_table_destroy (titles_read);
 
     /* save */
-    FILE *fp;
-    char file[PATH_MAX];
+    GError *error = NULL;
     gboolean saved = FALSE;
 
-    snprintf (file, PATH_MAX - 1, "%s/kalu/news.conf", g_get_user_config_dir ());
-    if (ensure_path (file))
+    if (save_news_conf (news_last, news_read, &error))
     {
-        fp = fopen (file, "w");
-        if (fp != NULL)
+        /* update */
+        if (config->news_last)
         {
-            fputs ("Last=", fp);
-            fputs (news_last, fp);
-            fputs ("\n", fp);
-
-            FOR_LIST (i, news_read)
-            {
-                fputs ("Read=", fp);
-                fputs ((const char *) i->data, fp);
-                fputs ("\n", fp);
-            }
-            fclose (fp);
-
-            /* update */
-            if (config->news_last)
-            {
-                free (config->news_last);
-            }
-            config->news_last = news_last;
+            free (config->news_last);
+        }
+        config->news_last = news_last;
 
-            FREELIST (config->news_read);
-            config->news_read = news_read;
+        g_hash_table_destroy (config->news_read);
+        config->news_read = news_read;
 
-            /* we go and change the last_notifs. if nb_unread = 0 we can
-             * simply remove it, else we change it to ask to run the checks again
-             * to be up to date */
-            FOR_LIST (i, config->last_notifs)
+        /* we go and change the last_notifs. if nb_unread = 0 we can
+         * simply remove it, else we change it to ask to run the checks again
+         * to be up to date */
+        FOR_LIST (i, config->last_notifs)
+        {
+            notif_t *notif = i->data;
+            if (notif->type & CHECK_NEWS)
             {
-                notif_t *notif = i->data;
-                if (notif->type & CHECK_NEWS)
+                if (nb_unread == 0)
+                {
+                    config->last_notifs = alpm_list_remove_item (
+                            config->last_notifs,
+                            i);
+                    free_notif (notif);
+                }
+                else
                 {
-                    if (nb_unread == 0)
-                    {
-                        config->last_notifs = alpm_list_remove_item (
-                                config->last_notifs,
-                                i);
-                        free_notif (notif);
-                    }
-                    else
-                    {
-                        free (notif->data);
-                        notif->data = NULL;
-                        free (notif->text);
-                        notif->text = strdup (_("Read news have changed, "
-                                    "you need to run the checks again to be up-to-date."));
-                    }
-                    break;
+                    /* keep the summary, since titles won't be around */
+                    if (!notif->summary)
+                        expand_notif (notif->type, notif->packages->pkgs,
+                                notif->packages->nb, &notif->summary, NULL);
+                    FREE_PACKAGES (notif->packages);
+                    free (notif->text);
+                    notif->text = strdup (_("Read news have changed, "
+                                "you need to run the checks again to be up-to-date."));
                 }
+                break;
             }
-            set_kalpm_nb (CHECK_NEWS, nb_unread, TRUE);
-            saved = TRUE;
         }
+        set_kalpm_nb (CHECK_NEWS, nb_unread, TRUE);
+        saved = TRUE;
     }
 
     if (saved)
@@ -965,9 +566,12 @@ btn_mark_cb (GtkWidget *button _UNUSED_, GtkWidget *window)
     }
     else
     {
+        g_hash_table_destroy (news_read);
+        free (news_last);
         gtk_widget_show (window);
-        show_error (_("Unable to save changes to disk"), file,
+        show_error (_("Unable to save changes to disk"), error->message,
                 GTK_WINDOW (window));
+        g_clear_error (&error);
     }
 }
 
@@ -1185,7 +789,71 @@ query_tooltip_cb (GtkTextView *textview, gint wx, gint wy,
 }
 
 static void
-new_window (gboolean only_updates, GtkWidget **window, GtkWidget **textview)
+show_items (parse_news_data_t *data, alpm_list_t *items)
+{
+    alpm_list_t *i;
+
+    news_render_create_tags (data->buffer);
+
+    if (data->only_updates)
+    {
+        /* create a attribute list, for labels of check-titles */
+        PangoAttribute *attr;
+
+        data->attr_list = pango_attr_list_new ();
+        attr = pango_attr_weight_new (800);
+        pango_attr_list_insert (data->attr_list, attr);
+        attr = pango_attr_size_new (10 * PANGO_SCALE);
+        pango_attr_list_insert (data->attr_list, attr);
+        attr = pango_attr_foreground_new (0, 30583, 48059);
+        pango_attr_list_insert (data->attr_list, attr);
+    }
+
+    FOR_LIST (i, items)
+    {
+        if (!add_item (data, i->data))
+        {
+            break;
+        }
+    }
+
+    if (data->only_updates)
+    {
+        pango_attr_list_unref (data->attr_list);
+    }
+}
+
+static void
+search_changed_cb (GtkSearchEntry *entry, GtkTextView *textview)
+{
+    GError             *error = NULL;
+    parse_news_data_t   data;
+    alpm_list_t        *items;
+
+    items = news_archive_get_items (gtk_entry_get_text (GTK_ENTRY (entry)),
+            &error);
+    if (error)
+    {
+        debug ("unable to search news: %s", error->message);
+        g_clear_error (&error);
+        return;
+    }
+
+    zero (data);
+    data.textview = textview;
+    /* use a new buffer, so tags (e.g. links) from previous results go away */
+    data.buffer = gtk_text_buffer_new (NULL);
+    show_items (&data, items);
+    gtk_text_view_set_buffer (textview, data.buffer);
+    g_object_unref (data.buffer);
+    FREE_NEWS_ITEMS_LIST (items);
+}
+
+static void
+new_window (gboolean    only_updates,
+            gboolean    with_search,
+            GtkWidget **window,
+            GtkWidget **textview)
 {
     ++nb_windows;
 
@@ -1268,6 +936,18 @@ new_window (gboolean only_updates, GtkWidget **window, GtkWidget **textview)
         gtk_button_set_always_show_image ((GtkButton *) button, TRUE);
         gtk_widget_show (button);
     }
+    else if (with_search)
+    {
+        GtkWidget *entry;
+
+        /* Search (in all archived news) */
+        entry = gtk_search_entry_new ();
+        gtk_widget_set_tooltip_text (entry, _("Search news"));
+        gtk_box_pack_start (GTK_BOX (hbox), entry, FALSE, FALSE, 4);
+        g_signal_connect (G_OBJECT (entry), "search-changed",
+                G_CALLBACK (search_changed_cb), (gpointer) *textview);
+        gtk_widget_show (entry);
+    }
 
     /* Close */
     button = gtk_button_new_with_mnemonic (_("_Close"));
@@ -1280,29 +960,43 @@ new_window (gboolean only_updates, GtkWidget **window, GtkWidget **textview)
     gtk_widget_show (button);
 }
 
+static gboolean
+collect_item (news_item_t *item, alpm_list_t **items)
+{
+    *items = alpm_list_add (*items, item);
+    return TRUE;
+}
+
 gboolean
-news_show (gchar *xml_news, gboolean only_updates, GError **error)
+news_show (gboolean only_updates, GError **error)
 {
     GError             *local_err = NULL;
-    gboolean            is_xml_ours = FALSE;
     parse_news_data_t   data;
     GtkWidget          *window;
     GtkWidget          *textview;
+    alpm_list_t        *items;
 
-    /* if no XML was provided, download it */
-    if (xml_news == NULL)
+    /* news are shown from the archive, filled on checks */
+    items = news_archive_get_items (NULL, &local_err);
+    if (!items && !local_err)
     {
-        xml_news = curl_download (NEWS_RSS_URL, &local_err);
-        if (local_err != NULL)
+        /* nothing archived yet (e.g. first time), so download them */
+        if (download_items ((news_item_fn) collect_item, &items, &local_err)
+                && !news_archive_add (items, &local_err))
         {
-            g_propagate_error (error, local_err);
-            set_kalpm_busy (FALSE);
-            return FALSE;
+            debug ("unable to archive news: %s", local_err->message);
+            g_clear_error (&local_err);
         }
-        is_xml_ours = TRUE;
+    }
+    if (local_err != NULL)
+    {
+        FREE_NEWS_ITEMS_LIST (items);
+        g_propagate_error (error, local_err);
+        set_kalpm_busy (FALSE);
+        return FALSE;
     }
 
-    new_window (only_updates, &window, &textview);
+    new_window (only_updates, !only_updates, &window, &textview);
 
     zero (data);
     data.only_updates = only_updates;
@@ -1310,21 +1004,8 @@ news_show (gchar *xml_news, gboolean only_updates, GError **error)
     data.buffer = gtk_text_view_get_buffer (data.textview);
     data.lists = g_object_get_data (G_OBJECT (window), "lists");
 
-    if (!parse_xml (xml_news, FALSE, (gpointer) &data, &local_err))
-    {
-        if (is_xml_ours)
-        {
-            free (xml_news);
-        }
-        g_propagate_error (error, local_err);
-        gtk_widget_destroy (window);
-        set_kalpm_busy (FALSE);
-        return FALSE;
-    }
-    if (is_xml_ours)
-    {
-        free (xml_news);
-    }
+    show_items (&data, items);
+    FREE_NEWS_ITEMS_LIST (items);
 
     /* if we were only showing updates, but there are none to show (i.e. from
      * the menu "Show unread news") then just show a notif about it */
@@ -1352,7 +1033,7 @@ show_help (GError **error)
     GtkTextBuffer *buffer;
     gchar         *text, *t, *s;
 
-    new_window (FALSE, &window, &textview);
+    new_window (FALSE, FALSE, &window, &textview);
     gtk_window_set_title (GTK_WINDOW (window), _("Help - kalu"));
     gtk_window_set_default_size (GTK_WINDOW (window), 600, 420);
     buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (textview));
@@ -1371,8 +1052,8 @@ show_help (GError **error)
         text = s + 4;
     }
 
-    create_tags (buffer);
-    parse_to_buffer (buffer, text, (gsize) strlen (text));
+    news_render_create_tags (buffer);
+    news_render_html (buffer, text, (gsize) strlen (text));
     g_free (t);
     gtk_widget_show (window);
     return TRUE;
@@ -1387,7 +1068,7 @@ show_history (GError **error)
     GtkTextBuffer *buffer;
     gchar         *text, *s;
 
-    new_window (FALSE, &window, &textview);
+    new_window (FALSE, FALSE, &window, &textview);
     gtk_window_set_title (GTK_WINDOW (window), _("History - kalu"));
     gtk_window_set_default_size (GTK_WINDOW (window), 600, 420);
     buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (textview));
@@ -1436,8 +1117,8 @@ show_history (GError **error)
         }
     }
 
-    create_tags (buffer);
-    parse_to_buffer (buffer, text, (gsize) strlen (text));
+    news_render_create_tags (buffer);
+    news_render_html (buffer, text, (gsize) strlen (text));
     g_free (text);
     gtk_widget_show (window);
     return TRUE;
@@ -1464,13 +1145,13 @@ show_pacman_conflict ()
         "AUR yet, make sure to flag it as out-of-date.</p>")
         ;
 
-    new_window (FALSE, &window, &textview);
+    new_window (FALSE, FALSE, &window, &textview);
     gtk_window_set_title (GTK_WINDOW (window),
             _("Possible pacman/kalu conflict - kalu"));
     gtk_window_set_default_size (GTK_WINDOW (window), 600, 230);
     buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (textview));
-    create_tags (buffer);
-    parse_to_buffer (buffer, text, (gsize) strlen (text));
+    news_render_create_tags (buffer);
+    news_render_html (buffer, text, (gsize) strlen (text));
     gtk_widget_show (window);
 }
 
@@ -31,11 +31,10 @@
 
 gboolean
 news_has_updates (alpm_list_t **titles,
-                  gchar       **xml_news,
                   GError      **error);
 
 gboolean
-news_show (gchar *xml_news, gboolean only_updates, GError **error);
+news_show (gboolean only_updates, GError **error);
 
 gboolean
 show_help (GError **error);
@@ -824,6 +824,17 @@ btn_save_cb (GtkButton *button _UNUSED_, gpointer data _UNUSED_)
         add_to_conf ("NotifButtons = 0\n");
     }
 
+    /* shared sync DB cache (no GUI) */
+    if (new_config.shared_dbs_dir)
+    {
+        add_to_conf ("SharedDbCache = %s\n", new_config.shared_dbs_dir);
+    }
+    if (new_config.shared_dbs_max_age != 300)
+    {
+        add_to_conf ("SharedDbCacheMaxAge = %d\n",
+                new_config.shared_dbs_max_age / 60);
+    }
+
 #ifndef DISABLE_UPDATER
     /* colors (no GUI) */
     add_color (unimportant, "Unimportant", "gray");
@@ -836,6 +847,13 @@ btn_save_cb (GtkButton *button _UNUSED_, gpointer data _UNUSED_)
     {
         add_to_conf ("AutoShowLog = 1\n");
     }
+
+    /* resident kalu-dbus (no GUI) */
+    if (new_config.updater_resident > 0)
+    {
+        add_to_conf ("UpdaterResident = %d\n",
+                new_config.updater_resident / 60);
+    }
 #endif
 
     /* General */
@@ -1190,6 +1208,10 @@ btn_save_cb (GtkButton *button _UNUSED_, gpointer data _UNUSED_)
     FREELIST (config->aur_ignore);
     /* copy new ones over */
     memcpy (config, &new_config, sizeof (config_t));
+    /* templates might have changed */
+    compile_templates ();
+    /* so might have SyncDbsInTooltip */
+    invalidate_tooltips ();
 
     /* reset timeout for next auto-checks */
     reset_timeout ();
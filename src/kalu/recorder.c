@@ -0,0 +1,382 @@
+/**
+ * kalu - Copyright (C) 2012-2018 Olivier Brunel
+ *
+ * recorder.c
+ * Copyright (C) 2012-2018 Olivier Brunel <jjk@jjacky.com>
+ *
+ * This file is part of kalu.
+ *
+ * kalu is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * kalu is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * kalu. If not, see http://www.gnu.org/licenses/
+ */
+
+#include <config.h>
+
+/* C */
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+/* kalu */
+#include "kalu.h"
+#include "recorder.h"
+
+#define BOM     0x01020304
+
+struct _recorder_t
+{
+    FILE        *fp;
+    gchar       *file;
+    GHashTable  *ids;
+    guint16      next_id;
+    gint64       last;
+};
+
+typedef struct _signal_t
+{
+    gchar               *name;
+    GVariantType        *type;
+} signal_t;
+
+struct _replay_t
+{
+    GBytes      *bytes;
+    const guchar *data;
+    gsize        len;
+    gsize        pos;
+    gboolean     swap;
+    GPtrArray   *signals;
+};
+
+static gboolean
+rec_write (recorder_t *recorder, const void *buf, size_t len, GError **error)
+{
+    if (len > 0 && fwrite (buf, len, 1, recorder->fp) != 1)
+    {
+        g_set_error (error, KALU_ERROR, 1,
+                _("Unable to write to %s: %s\n"),
+                recorder->file, strerror (errno));
+        return FALSE;
+    }
+    return TRUE;
+}
+
+recorder_t *
+recorder_new (const gchar *file, GError **error)
+{
+    recorder_t *recorder;
+    guint32 u32;
+
+    recorder = new0 (recorder_t, 1);
+    recorder->fp = fopen (file, "wb");
+    if (!recorder->fp)
+    {
+        g_set_error (error, KALU_ERROR, 1,
+                _("Unable to open %s for writing: %s\n"),
+                file, strerror (errno));
+        free (recorder);
+        return NULL;
+    }
+    recorder->file = strdup (file);
+    recorder->ids = g_hash_table_new_full (g_str_hash, g_str_equal,
+            g_free, NULL);
+    recorder->last = g_get_monotonic_time ();
+
+    u32 = RECORDER_VERSION;
+    if (!rec_write (recorder, RECORDER_MAGIC, 4, error)
+            || !rec_write (recorder, &u32, sizeof (u32), error)
+            || (u32 = BOM, !rec_write (recorder, &u32, sizeof (u32), error)))
+    {
+        recorder_free (recorder);
+        return NULL;
+    }
+
+    return recorder;
+}
+
+gboolean
+recorder_add (recorder_t    *recorder,
+              const gchar   *signal_name,
+              GVariant      *parameters,
+              GError       **error)
+{
+    const gchar *type;
+    gchar *key;
+    gpointer ptr;
+    gboolean is_new;
+    guint16 id;
+    guint32 u32;
+    guint8 u8;
+    gint64 now;
+
+    type = g_variant_get_type_string (parameters);
+    key = g_strconcat (signal_name, " ", type, NULL);
+    is_new = !g_hash_table_lookup_extended (recorder->ids, key, NULL, &ptr);
+    if (is_new)
+    {
+        id = recorder->next_id++;
+        g_hash_table_insert (recorder->ids, key, GUINT_TO_POINTER (id));
+    }
+    else
+    {
+        id = (guint16) GPOINTER_TO_UINT (ptr);
+        g_free (key);
+    }
+
+    now = g_get_monotonic_time ();
+    u32 = (guint32) MIN (now - recorder->last, G_MAXUINT32);
+    recorder->last = now;
+
+    if (!rec_write (recorder, &u32, sizeof (u32), error)
+            || !rec_write (recorder, &id, sizeof (id), error))
+        return FALSE;
+
+    if (is_new)
+    {
+        u8 = (guint8) strlen (signal_name);
+        if (!rec_write (recorder, &u8, sizeof (u8), error)
+                || !rec_write (recorder, signal_name, u8, error))
+            return FALSE;
+        u8 = (guint8) strlen (type);
+        if (!rec_write (recorder, &u8, sizeof (u8), error)
+                || !rec_write (recorder, type, u8, error))
+            return FALSE;
+    }
+
+    u32 = (guint32) g_variant_get_size (parameters);
+    if (!rec_write (recorder, &u32, sizeof (u32), error)
+            || !rec_write (recorder, g_variant_get_data (parameters), u32, error))
+        return FALSE;
+
+    return TRUE;
+}
+
+void
+recorder_free (recorder_t *recorder)
+{
+    if (recorder->fp && fclose (recorder->fp) != 0)
+        debug ("recorder: failed to close %s: %s",
+                recorder->file, strerror (errno));
+    if (recorder->ids)
+        g_hash_table_unref (recorder->ids);
+    free (recorder->file);
+    free (recorder);
+}
+
+static void
+free_signal (signal_t *signal)
+{
+    g_free (signal->name);
+    g_variant_type_free (signal->type);
+    free (signal);
+}
+
+static gboolean
+rep_read (replay_t *replay, void *buf, gsize len, GError **error)
+{
+    if (replay->len - replay->pos < len)
+    {
+        g_set_error (error, KALU_ERROR, 1,
+                _("Recording is truncated or corrupted\n"));
+        return FALSE;
+    }
+    memcpy (buf, replay->data + replay->pos, len);
+    replay->pos += len;
+    return TRUE;
+}
+
+static gboolean
+rep_read_u32 (replay_t *replay, guint32 *u32, GError **error)
+{
+    if (!rep_read (replay, u32, sizeof (*u32), error))
+        return FALSE;
+    if (replay->swap)
+        *u32 = GUINT32_SWAP_LE_BE (*u32);
+    return TRUE;
+}
+
+static gchar *
+rep_read_str (replay_t *replay, GError **error)
+{
+    gchar *s;
+    guint8 len;
+
+    if (!rep_read (replay, &len, sizeof (len), error))
+        return NULL;
+    s = g_malloc (len + 1);
+    if (!rep_read (replay, s, len, error))
+    {
+        g_free (s);
+        return NULL;
+    }
+    s[len] = '\0';
+    return s;
+}
+
+replay_t *
+replay_new (const gchar *file, GError **error)
+{
+    GError *local_err = NULL;
+    replay_t *replay;
+    gchar *data;
+    gsize len;
+    gchar magic[4];
+    guint32 u32;
+    guint32 bom;
+
+    if (!g_file_get_contents (file, &data, &len, &local_err))
+    {
+        g_set_error (error, KALU_ERROR, 1,
+                _("Unable to read %s: %s\n"),
+                file, local_err->message);
+        g_clear_error (&local_err);
+        return NULL;
+    }
+
+    replay = new0 (replay_t, 1);
+    replay->bytes = g_bytes_new_take (data, len);
+    replay->data = (const guchar *) data;
+    replay->len = len;
+    replay->signals = g_ptr_array_new_with_free_func (
+            (GDestroyNotify) free_signal);
+
+    if (!rep_read (replay, magic, sizeof (magic), NULL)
+            || memcmp (magic, RECORDER_MAGIC, sizeof (magic)) != 0)
+    {
+        g_set_error (error, KALU_ERROR, 1,
+                _("%s is not a kalu recording\n"), file);
+        replay_free (replay);
+        return NULL;
+    }
+    if (!rep_read (replay, &u32, sizeof (u32), error)
+            || !rep_read (replay, &bom, sizeof (bom), error))
+    {
+        replay_free (replay);
+        return NULL;
+    }
+    /* recording made on a host of different endianness */
+    if (bom == GUINT32_SWAP_LE_BE (BOM))
+    {
+        replay->swap = TRUE;
+        u32 = GUINT32_SWAP_LE_BE (u32);
+    }
+    else if (bom != BOM)
+    {
+        g_set_error (error, KALU_ERROR, 1,
+                _("%s is not a kalu recording\n"), file);
+        replay_free (replay);
+        return NULL;
+    }
+    if (u32 != RECORDER_VERSION)
+    {
+        g_set_error (error, KALU_ERROR, 1,
+                _("Unsupported recording version: %u\n"), u32);
+        replay_free (replay);
+        return NULL;
+    }
+
+    return replay;
+}
+
+/* returns FALSE with error unset once the end of the recording is reached;
+ * parameters returned are owned by the caller */
+gboolean
+replay_next (replay_t       *replay,
+             guint32        *delay,
+             const gchar   **signal_name,
+             GVariant      **parameters,
+             GError        **error)
+{
+    signal_t *signal;
+    GBytes *bytes;
+    GVariant *v;
+    guint16 id;
+    guint32 size;
+
+    if (replay->pos >= replay->len)
+        return FALSE;
+
+    if (!rep_read_u32 (replay, delay, error)
+            || !rep_read (replay, &id, sizeof (id), error))
+        return FALSE;
+    if (replay->swap)
+        id = GUINT16_SWAP_LE_BE (id);
+
+    if (id == replay->signals->len)
+    {
+        gchar *type;
+
+        signal = new0 (signal_t, 1);
+        signal->name = rep_read_str (replay, error);
+        if (!signal->name)
+        {
+            free (signal);
+            return FALSE;
+        }
+        type = rep_read_str (replay, error);
+        if (!type || !g_variant_type_string_is_valid (type))
+        {
+            if (type)
+                g_set_error (error, KALU_ERROR, 1,
+                        _("Invalid type in recording: %s\n"), type);
+            g_free (type);
+            g_free (signal->name);
+            free (signal);
+            return FALSE;
+        }
+        signal->type = g_variant_type_new (type);
+        g_free (type);
+        g_ptr_array_add (replay->signals, signal);
+    }
+    else if (id > replay->signals->len)
+    {
+        g_set_error (error, KALU_ERROR, 1,
+                _("Recording is truncated or corrupted\n"));
+        return FALSE;
+    }
+    signal = replay->signals->pdata[id];
+
+    if (!rep_read_u32 (replay, &size, error))
+        return FALSE;
+    if (replay->len - replay->pos < size)
+    {
+        g_set_error (error, KALU_ERROR, 1,
+                _("Recording is truncated or corrupted\n"));
+        return FALSE;
+    }
+    bytes = g_bytes_new_from_bytes (replay->bytes, replay->pos, size);
+    replay->pos += size;
+
+    v = g_variant_ref_sink (g_variant_new_from_bytes (signal->type, bytes, FALSE));
+    g_bytes_unref (bytes);
+    if (replay->swap)
+    {
+        GVariant *swapped = g_variant_byteswap (v);
+        g_variant_unref (v);
+        v = swapped;
+    }
+
+    *signal_name = signal->name;
+    *parameters = v;
+    return TRUE;
+}
+
+void
+replay_free (replay_t *replay)
+{
+    if (replay->signals)
+        g_ptr_array_unref (replay->signals);
+    if (replay->bytes)
+        g_bytes_unref (replay->bytes);
+    free (replay);
+}
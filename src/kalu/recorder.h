@@ -0,0 +1,67 @@
+/**
+ * kalu - Copyright (C) 2012-2018 Olivier Brunel
+ *
+ * recorder.h
+ * Copyright (C) 2012-2018 Olivier Brunel <jjk@jjacky.com>
+ *
+ * This file is part of kalu.
+ *
+ * kalu is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * kalu is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * kalu. If not, see http://www.gnu.org/licenses/
+ */
+
+#ifndef _KALU_RECORDER_H
+#define _KALU_RECORDER_H
+
+/* glib */
+#include <glib-2.0/glib.h>
+
+#define RECORDER_MAGIC          "KREC"
+#define RECORDER_VERSION        1
+
+/* file layout (all integers in the byte order of the recording host):
+ *
+ * header:  char magic[4], guint32 version, guint32 byte order mark
+ * record:  guint32 delay (usec since previous record), guint16 signal id
+ *          if the id is seen for the first time:
+ *              guint8 len + signal name, guint8 len + type string
+ *          guint32 size + serialized GVariant
+ */
+
+typedef struct _recorder_t  recorder_t;
+typedef struct _replay_t    replay_t;
+
+recorder_t *
+recorder_new (const gchar *file, GError **error);
+
+gboolean
+recorder_add (recorder_t *recorder, const gchar *signal_name,
+              GVariant *parameters, GError **error);
+
+void
+recorder_free (recorder_t *recorder);
+
+replay_t *
+replay_new (const gchar *file, GError **error);
+
+gboolean
+replay_next (replay_t       *replay,
+             guint32        *delay,
+             const gchar   **signal_name,
+             GVariant      **parameters,
+             GError        **error);
+
+void
+replay_free (replay_t *replay);
+
+#endif /* _KALU_RECORDER_H */
@@ -38,6 +38,7 @@
 #include "util-gtk.h"
 #include "util.h"
 #include "kalu-updater.h"
+#include "log-view.h"
 #include "conf.h"
 #include "gui.h" /* show_notif() */
 #include "kalu-alpm.h"  /* simulation */
@@ -103,13 +104,6 @@ enum {
     NB_COL
 };
 
-typedef struct _add_db_t {
-    pacman_config_t *pac_conf;
-    double pctg;
-    double inc;
-    alpm_list_t *i;
-} add_db_t;
-
 typedef struct _sync_dbs_t {
     gint total;
     gint processed;
@@ -120,6 +114,25 @@ typedef struct _pkg_iter_t {
     GtkTreeIter *iter;
 } pkg_iter_t;
 
+/* a package download in flight; there can be several at once when
+ * ParallelDownloads is used */
+typedef struct _download_t {
+    GtkTreeIter *iter;
+    guint        xfered;    /* bytes of current transfer not in step_done */
+    gboolean     done;
+} download_t;
+
+/* progress of a row, as received but not yet written into the store */
+typedef struct _row_progress_t {
+    GtkTreeIter iter;
+    gboolean    is_inst;
+    double      pctg;
+    guint       cur_xfrd;
+    guint       cur_dl;
+    guint       tot_dl;
+    guint       size;
+} row_progress_t;
+
 typedef enum {
     LOGTYPE_UNIMPORTANT = 0,
     LOGTYPE_NORMAL,
@@ -156,11 +169,12 @@ typedef struct _updater_t {
     GtkWidget *lbl_action;
     GtkWidget *pbar_action;
     GtkListStore *store;
+    GHashTable *rows;
     GtkWidget *list;
     GtkWidget *paned;
     GtkWidget *expander;
-    GtkWidget *text_view;
-    GtkTextBuffer *buffer;
+    log_view_t *log;
+    GtkWidget *log_entry;
     GtkWidget *btn_sysupgrade;
     GtkWidget *btn_close;
     GtkWidget *btn_rerun;
@@ -186,6 +200,20 @@ typedef struct _updater_t {
     guint total_inst;
     guint total_dl;
 
+    /* downloads in flight (filename -> download_t), and the sum of their
+     * transferred bytes not yet accounted in step_done */
+    GHashTable *downloads;
+    guint dl_inflight;
+    /* to compute the aggregate throughput */
+    gint64 dl_rate_time;
+    guint dl_rate_bytes;
+
+    /* progress is coalesced & only flushed to the widgets once per frame */
+    GHashTable *progress;
+    double pending_action;
+    double pending_main;
+    guint tick_id;
+
     KaluUpdater *kupdater;
     gboolean downloadonly;
 
@@ -196,14 +224,16 @@ typedef struct _updater_t {
 
 static updater_t *updater = NULL;
 
+/* signals of kalu_updater get recorded to/replayed from those files */
+static gchar *record_file = NULL;
+static gchar *replay_file = NULL;
+static gboolean replay_max_speed = FALSE;
+
 static void
 add_log (logtype_t type, const gchar *fmt, ...)
 {
-    GtkTextMark *mark;
-    GtkTextIter  iter;
     gchar        buf[1024];
     gchar       *buffer = buf;
-    const char  *tag;
     va_list      args;
     int          len;
 
@@ -218,40 +248,13 @@ add_log (logtype_t type, const gchar *fmt, ...)
         va_end (args);
     }
 
-    switch (type)
-    {
-        case LOGTYPE_ERROR:
-            tag = "error";
-            break;
-        case LOGTYPE_WARNING:
-            tag = "warning";
-            break;
-        case LOGTYPE_INFO:
-            tag = "info";
-            break;
-        case LOGTYPE_UNIMPORTANT:
-            tag = "unimportant";
-            break;
-        case LOGTYPE_NORMAL:
-        default:
-            tag = "normal";
-            break;
-    }
-
     if (type == LOGTYPE_ERROR || type == LOGTYPE_WARNING
             || type == LOGTYPE_INFO)
     {
         gtk_expander_set_expanded (GTK_EXPANDER (updater->expander), TRUE);
     }
 
-    mark = gtk_text_buffer_get_mark (updater->buffer, "end-mark");
-    gtk_text_buffer_get_iter_at_mark (updater->buffer, &iter, mark);
-    gtk_text_buffer_insert_with_tags_by_name (updater->buffer, &iter,
-            buffer, -1, tag, NULL);
-    /* scrolling to the end using gtk_text_view_scroll_to_iter doesn't work;
-     * using a mark like so seems to work better... */
-    gtk_text_view_scroll_mark_onscreen (GTK_TEXT_VIEW (updater->text_view),
-            mark);
+    log_view_append (updater->log, type, buffer);
     if (buffer != buf)
     {
         free (buffer);
@@ -300,31 +303,6 @@ _show_error (const gchar *msg, const gchar *fmt, ...)
     }
 }
 
-static gboolean
-text_view_draw_cb (GtkWidget *widget _UNUSED_, gpointer *cr _UNUSED_,
-                   gpointer data _UNUSED_)
-{
-    static gboolean is_first = TRUE;
-
-    /* this is so that the first time the text view is shown, we make sure
-     * to scroll to the bottom of the log.
-     * add_log() does that, but as long as it's not visible, it doesn't actually
-     * matter (and using map, map-event, etc seemed to always fail, i guess
-     * because they run too soon/before whatever needs to be done for this
-     * to work was done. so, here we go, in draw... */
-
-    if (is_first)
-    {
-        GtkTextMark *mark;
-        mark = gtk_text_buffer_get_mark (updater->buffer, "end-mark");
-        gtk_text_view_scroll_mark_onscreen (GTK_TEXT_VIEW (updater->text_view),
-                mark);
-        is_first = FALSE;
-    }
-
-    return FALSE;
-}
-
 static void
 rend_net_size (GtkTreeViewColumn *column, GtkCellRenderer *renderer,
            GtkTreeModel *store, GtkTreeIter *iter)
@@ -406,32 +384,173 @@ rend_pbar_pb (GtkTreeViewColumn *column _UNUSED_, GtkCellRenderer *renderer,
     }
 }
 
+/* returns the row of pkg from the index, or NULL. The iter belongs to the
+ * index, and remains valid until the store is cleared */
 static GtkTreeIter *
 get_iter_for_pkg (const gchar *pkg)
 {
-    GtkTreeIter  *iter;
-    GtkTreeModel *model;
-    const gchar  *name;
+    return g_hash_table_lookup (updater->rows, pkg);
+}
 
-    iter = new0 (GtkTreeIter, 1);
-    model = GTK_TREE_MODEL (updater->store);
+static void
+clear_rows (void)
+{
+    g_hash_table_remove_all (updater->rows);
+    gtk_list_store_clear (updater->store);
+}
 
-    gtk_tree_model_get_iter_first (model, iter);
-    do
+static void
+flush_progress (void)
+{
+    GHashTableIter hti;
+    row_progress_t *rp;
+
+    if (updater->tick_id > 0)
     {
-        gtk_tree_model_get (model, iter,
-                UCOL_PACKAGE,   &name,
-                -1);
+        gtk_widget_remove_tick_callback (updater->window, updater->tick_id);
+        updater->tick_id = 0;
+    }
 
-        if (g_strcmp0 (pkg, name) == 0)
+    g_hash_table_iter_init (&hti, updater->progress);
+    while (g_hash_table_iter_next (&hti, NULL, (gpointer *) &rp))
+    {
+        if (rp->is_inst)
+        {
+            gtk_list_store_set (updater->store, &rp->iter,
+                    UCOL_PCTG,           rp->pctg,
+                    UCOL_INST_IS_ACTIVE, TRUE,
+                    -1);
+        }
+        else
         {
-            return iter;
+            gtk_list_store_set (updater->store, &rp->iter,
+                    UCOL_PCTG,          rp->pctg,
+                    UCOL_CUR_XFRD_SIZE, rp->cur_xfrd,
+                    UCOL_CUR_DL_SIZE,   rp->cur_dl,
+                    UCOL_TOT_DL_SIZE,   rp->tot_dl,
+                    -1);
         }
+    }
+    g_hash_table_remove_all (updater->progress);
+
+    if (updater->pending_action >= 0.0)
+    {
+        gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (updater->pbar_action),
+                updater->pending_action);
+        updater->pending_action = -1.0;
+    }
+    if (updater->pending_main >= 0.0)
+    {
+        gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (updater->pbar_main),
+                updater->pending_main);
+        updater->pending_main = -1.0;
+    }
+}
 
-    } while (gtk_tree_model_iter_next (model, iter));
+static gboolean
+progress_tick_cb (GtkWidget     *widget _UNUSED_,
+                  GdkFrameClock *clock _UNUSED_,
+                  gpointer       data _UNUSED_)
+{
+    gint64 start;
 
-    free (iter);
-    return NULL;
+    /* we're removed by returning G_SOURCE_REMOVE */
+    updater->tick_id = 0;
+    start = g_get_monotonic_time ();
+    flush_progress ();
+    /* so a replay's report covers what coalescing moved out of the handlers */
+    if (updater->kupdater)
+        kalu_updater_replay_account (updater->kupdater, "(frame flush)",
+                g_get_monotonic_time () - start);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+queue_progress_flush (void)
+{
+    if (updater->tick_id == 0)
+        updater->tick_id = gtk_widget_add_tick_callback (updater->window,
+                progress_tick_cb, NULL, NULL);
+}
+
+/* removes filename from the downloads in flight, accounting what it
+ * transferred into step_done. Returns its row, or NULL */
+static GtkTreeIter *
+end_download (const gchar *filename)
+{
+    download_t  *dl;
+    GtkTreeIter *iter;
+
+    dl = g_hash_table_lookup (updater->downloads, filename);
+    if (dl == NULL)
+        return NULL;
+
+    if (!dl->done)
+    {
+        updater->step_done += dl->xfered;
+        updater->dl_inflight -= dl->xfered;
+    }
+    iter = dl->iter;
+    g_hash_table_remove (updater->downloads, filename);
+    return iter;
+}
+
+/* shows the aggregate throughput of all downloads, refreshed once a second */
+static void
+update_dl_rate (void)
+{
+    gint64 now;
+    gint64 elapsed;
+    guint bytes;
+    double size;
+    const char *unit;
+    char buf[255], buf_size[23];
+
+    now = g_get_monotonic_time ();
+    elapsed = now - updater->dl_rate_time;
+    if (elapsed < G_USEC_PER_SEC)
+        return;
+
+    bytes = updater->step_done + updater->dl_inflight;
+    size = humanize_size ((off_t) ((double) (bytes - updater->dl_rate_bytes)
+                * G_USEC_PER_SEC / (double) elapsed), '\0', &unit);
+    snprint_size (buf_size, 23, size, unit);
+    snprintf (buf, 255, _("Downloading packages... (%s/s)"), buf_size);
+    gtk_label_set_text (GTK_LABEL (updater->lbl_action), buf);
+
+    updater->dl_rate_time = now;
+    updater->dl_rate_bytes = bytes;
+}
+
+/* returns the pending progress for pkg (or file), starting off from what's in
+ * the store if there's nothing pending yet. A flush is queued for next frame */
+static row_progress_t *
+get_row_progress (const gchar *pkg, GtkTreeIter *iter, gboolean is_inst)
+{
+    row_progress_t *rp;
+
+    rp = g_hash_table_lookup (updater->progress, pkg);
+    if (!rp)
+    {
+        GtkTreeModel *model = GTK_TREE_MODEL (updater->store);
+
+        rp = new0 (row_progress_t, 1);
+        rp->iter = *iter;
+        rp->is_inst = is_inst;
+        gtk_tree_model_get (model, iter,
+                UCOL_PCTG,          &rp->pctg,
+                UCOL_CUR_XFRD_SIZE, &rp->cur_xfrd,
+                UCOL_CUR_DL_SIZE,   &rp->cur_dl,
+                UCOL_TOT_DL_SIZE,   &rp->tot_dl,
+                UCOL_NEW_SIZE,      &rp->size,
+                -1);
+        if (rp->size == 0)
+            gtk_tree_model_get (model, iter, UCOL_OLD_SIZE, &rp->size, -1);
+        g_hash_table_insert (updater->progress, strdup (pkg), rp);
+    }
+
+    queue_progress_flush ();
+    return rp;
 }
 
 static void
@@ -473,6 +592,7 @@ on_event (KaluUpdater *kupdater _UNUSED_, event_t event)
     const gchar *msg = NULL;
     int upd_action = updater->step == STEP_NONE;
 
+    flush_progress ();
     switch (event)
     {
         case EVENT_RETRIEVING_PKGS:
@@ -483,6 +603,8 @@ on_event (KaluUpdater *kupdater _UNUSED_, event_t event)
             if (updater->step == STEP_DOWNLOADING)
             {
                 updater->pctg_done += updater->pctg_download;
+                g_hash_table_remove_all (updater->downloads);
+                updater->dl_inflight = 0;
             }
             break;
         case EVENT_CHECKING_DEPS:
@@ -541,6 +663,7 @@ on_event_hookrun (KaluUpdater *kupdater _UNUSED_, event_type_t type, int total,
 {
     double pctg;
 
+    flush_progress ();
     if (type == EVENT_TYPE_START)
     {
         pctg = ((double) position - 1.0) / total;
@@ -562,6 +685,7 @@ finish_pkg_install (const char *pkg, const char *version _UNUSED_)
     pkg_iter_t *pkg_iter = updater->step_data;
     guint size = 0;
 
+    flush_progress ();
     if (g_strcmp0 (pkg, pkg_iter->filename) != 0)
     {
         /* locate pkg in tree */
@@ -608,7 +732,6 @@ finish_pkg_install (const char *pkg, const char *version _UNUSED_)
     /* free */
     free (pkg_iter->filename);
     pkg_iter->filename = NULL;
-    free (pkg_iter->iter);
     pkg_iter->iter = NULL;
 }
 
@@ -695,6 +818,7 @@ static void
 on_event_pkgdownload_start (KaluUpdater *kupdater _UNUSED_, const gchar *filename)
 
 {
+    flush_progress ();
     if (updater->step == STEP_USER_CONFIRMED)
     {
         /* adding "Downloading packages" to the log is done on corresponding event */
@@ -706,7 +830,10 @@ on_event_pkgdownload_start (KaluUpdater *kupdater _UNUSED_, const gchar *filenam
         gtk_widget_show (updater->pbar_action);
         updater->step = STEP_DOWNLOADING;
         updater->step_done = 0;
-        updater->step_data = new0 (pkg_iter_t, 1);
+        g_hash_table_remove_all (updater->downloads);
+        updater->dl_inflight = 0;
+        updater->dl_rate_time = g_get_monotonic_time ();
+        updater->dl_rate_bytes = 0;
     }
     else if (G_UNLIKELY (updater->step != STEP_DOWNLOADING))
     {
@@ -715,13 +842,14 @@ on_event_pkgdownload_start (KaluUpdater *kupdater _UNUSED_, const gchar *filenam
     }
 
     /* first, we need to find the package we're dealing with */
-    pkg_iter_t *pkg_iter = updater->step_data;
+    download_t *dl;
+    GtkTreeIter *iter;
     gchar *pkg, *s;
     int max;
     int i;
 
-    free (pkg_iter->filename);
-    pkg_iter->filename = NULL;
+    /* restarted download? */
+    end_download (filename);
 
     /* we want the package name only: the third dash from the last is the one
      * between pkgname and pkgver, since filenames follow:
@@ -746,21 +874,23 @@ on_event_pkgdownload_start (KaluUpdater *kupdater _UNUSED_, const gchar *filenam
     }
 
     /* locate pkg in tree */
-    pkg_iter->iter = get_iter_for_pkg (pkg);
-    if (pkg_iter->iter == NULL)
+    iter = get_iter_for_pkg (pkg);
+    if (iter == NULL)
     {
-        free (pkg);
         debug ("on_download: unable to find iter for %s", pkg);
+        free (pkg);
         return;
     }
     free (pkg);
-    pkg_iter->filename = strdup (filename);
+    dl = new0 (download_t, 1);
+    dl->iter = iter;
+    g_hash_table_insert (updater->downloads, strdup (filename), dl);
 
     /* make sure it's visible */
     gtk_tree_view_scroll_to_cell (GTK_TREE_VIEW (updater->list),
             gtk_tree_model_get_path (
                 GTK_TREE_MODEL (updater->store),
-                pkg_iter->iter),
+                iter),
             NULL,
             FALSE,
             0,
@@ -772,11 +902,11 @@ on_event_pkgdownload_start (KaluUpdater *kupdater _UNUSED_, const gchar *filenam
         /* get download size as default/initial value. Most of the time, it'll
          * stay the same, but in case of multiple deltas it might change once
          * the download is initiated */
-        gtk_tree_model_get (GTK_TREE_MODEL (updater->store), pkg_iter->iter,
+        gtk_tree_model_get (GTK_TREE_MODEL (updater->store), iter,
             UCOL_DL_SIZE,       &size,
             -1);
         /* pkg progress */
-        gtk_list_store_set (updater->store, pkg_iter->iter,
+        gtk_list_store_set (updater->store, iter,
                 UCOL_PCTG,          0.0,
                 UCOL_CUR_DL_SIZE,   size,
                 UCOL_CUR_XFRD_SIZE, 0,
@@ -787,8 +917,7 @@ on_event_pkgdownload_start (KaluUpdater *kupdater _UNUSED_, const gchar *filenam
 }
 
 static void
-on_event_pkgdownload_done (KaluUpdater *kupdater _UNUSED_,
-                           const gchar *file _UNUSED_)
+on_event_pkgdownload_done (KaluUpdater *kupdater _UNUSED_, const gchar *file)
 
 {
     if (G_UNLIKELY (updater->step != STEP_DOWNLOADING))
@@ -796,12 +925,20 @@ on_event_pkgdownload_done (KaluUpdater *kupdater _UNUSED_,
         debug ("on_pkgdownload_done: invalid step: %d", updater->step);
         return;
     }
+    flush_progress ();
 
-    pkg_iter_t *pkg_iter = updater->step_data;
+    GtkTreeIter *iter;
     guint dl_size, cur_size, tot_size;
     gboolean dl_done;
 
-    gtk_tree_model_get (GTK_TREE_MODEL (updater->store), pkg_iter->iter,
+    iter = end_download (file);
+    if (G_UNLIKELY (iter == NULL))
+    {
+        debug ("on_pkgdownload_done: unknown download: %s", file);
+        return;
+    }
+
+    gtk_tree_model_get (GTK_TREE_MODEL (updater->store), iter,
             UCOL_DL_SIZE,       &dl_size,
             UCOL_CUR_XFRD_SIZE, &cur_size,
             UCOL_TOT_DL_SIZE,   &tot_size,
@@ -809,7 +946,7 @@ on_event_pkgdownload_done (KaluUpdater *kupdater _UNUSED_,
     dl_done = (cur_size + tot_size == dl_size);
 
     /* pkg progress */
-    gtk_list_store_set (updater->store, pkg_iter->iter,
+    gtk_list_store_set (updater->store, iter,
             UCOL_DL_IS_ACTIVE,      FALSE,
             UCOL_DL_IS_DONE,        TRUE,
             UCOL_CUR_DL_SIZE,       0,
@@ -817,17 +954,10 @@ on_event_pkgdownload_done (KaluUpdater *kupdater _UNUSED_,
             UCOL_TOT_DL_SIZE,       cur_size + tot_size,
             (dl_done) ? UCOL_DL_IS_DONE_COLOR : -1,  config->color_info,
             -1);
-
-    /* free */
-    free (pkg_iter->filename);
-    pkg_iter->filename = NULL;
-    free (pkg_iter->iter);
-    pkg_iter->iter = NULL;
 }
 
 static void
-on_event_pkgdownload_failed (KaluUpdater *kupdater _UNUSED_,
-                             const gchar *file _UNUSED_)
+on_event_pkgdownload_failed (KaluUpdater *kupdater _UNUSED_, const gchar *file)
 
 {
     if (G_UNLIKELY (updater->step != STEP_DOWNLOADING))
@@ -835,17 +965,25 @@ on_event_pkgdownload_failed (KaluUpdater *kupdater _UNUSED_,
         debug ("on_pkgdownload_failed: invalid step: %d", updater->step);
         return;
     }
+    flush_progress ();
 
-    pkg_iter_t *pkg_iter = updater->step_data;
+    GtkTreeIter *iter;
     guint cur_size, tot_size;
 
-    gtk_tree_model_get (GTK_TREE_MODEL (updater->store), pkg_iter->iter,
+    iter = end_download (file);
+    if (G_UNLIKELY (iter == NULL))
+    {
+        debug ("on_pkgdownload_failed: unknown download: %s", file);
+        return;
+    }
+
+    gtk_tree_model_get (GTK_TREE_MODEL (updater->store), iter,
             UCOL_CUR_XFRD_SIZE, &cur_size,
             UCOL_TOT_DL_SIZE,   &tot_size,
             -1);
 
     /* pkg progress */
-    gtk_list_store_set (updater->store, pkg_iter->iter,
+    gtk_list_store_set (updater->store, iter,
             UCOL_DL_IS_ACTIVE,      FALSE,
             UCOL_DL_IS_DONE,        TRUE,
             UCOL_CUR_DL_SIZE,       0,
@@ -853,12 +991,6 @@ on_event_pkgdownload_failed (KaluUpdater *kupdater _UNUSED_,
             UCOL_TOT_DL_SIZE,       cur_size + tot_size,
             UCOL_DL_IS_DONE_COLOR,  config->color_error,
             -1);
-
-    /* free */
-    free (pkg_iter->filename);
-    pkg_iter->filename = NULL;
-    free (pkg_iter->iter);
-    pkg_iter->iter = NULL;
 }
 
 static void
@@ -975,6 +1107,7 @@ on_progress (KaluUpdater *kupdater _UNUSED_, event_t event, const gchar *pkg,
 
     if (updater->step != step)
     {
+        flush_progress ();
         if (NULL != updater->step_data)
         {
             free (updater->step_data);
@@ -997,9 +1130,9 @@ on_progress (KaluUpdater *kupdater _UNUSED_, event_t event, const gchar *pkg,
     {
         /* special case, since we need to update single progress in the Treeview */
 
-        double      pctg        = (double) percent / 100;
-        pkg_iter_t *pkg_iter    = updater->step_data;
-        guint       size = 0;
+        double          pctg        = (double) percent / 100;
+        pkg_iter_t     *pkg_iter    = updater->step_data;
+        row_progress_t *rp;
 
         if (g_strcmp0 (pkg, pkg_iter->filename) != 0)
         {
@@ -1027,50 +1160,33 @@ on_progress (KaluUpdater *kupdater _UNUSED_, event_t event, const gchar *pkg,
         }
 
         /* pkg progress */
-        gtk_list_store_set (updater->store, pkg_iter->iter,
-                UCOL_PCTG,           pctg,
-                UCOL_INST_IS_ACTIVE, TRUE,
-                -1);
-
-        /* get pkg size */
-        gtk_tree_model_get (GTK_TREE_MODEL (updater->store), pkg_iter->iter,
-                UCOL_NEW_SIZE,  &size,
-                -1);
-        if (size == 0)
-        {
-            gtk_tree_model_get (GTK_TREE_MODEL (updater->store), pkg_iter->iter,
-                    UCOL_OLD_SIZE,  &size,
-                    -1);
-        }
+        rp = get_row_progress (pkg, pkg_iter->iter, TRUE);
+        rp->pctg = pctg;
 
         if (updater->total_inst > 0)
         {
             /* upgrading progress */
             guint done;
 
-            done = (guint) (size * pctg);
+            done = (guint) (rp->size * pctg);
             pctg = (double) (updater->step_done + done) / updater->total_inst;
-
-            gtk_progress_bar_set_fraction (
-                    GTK_PROGRESS_BAR (updater->pbar_action), pctg);
+            updater->pending_action = pctg;
 
             /* global progress */
-            pctg = updater->pctg_done + (pctg * updater->pctg_sysupgrade);
-            gtk_progress_bar_set_fraction (
-                    GTK_PROGRESS_BAR (updater->pbar_main), pctg);
+            updater->pending_main = updater->pctg_done
+                + (pctg * updater->pctg_sysupgrade);
         }
     }
     else
     {
         /* simpler stuff: progress in the pbar_action */
         double pctg = (double) percent / 100;
-        gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (updater->pbar_action),
-                pctg);
+        updater->pending_action = pctg;
         /* global progress */
         pctg *= pctg_step;
         pctg += updater->pctg_done;
-        gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (updater->pbar_main),
-                pctg);
+        updater->pending_main = pctg;
+        queue_progress_flush ();
         if (percent == 100)
         {
             updater->pctg_done += pctg_step;
@@ -1448,6 +1564,7 @@ on_download (KaluUpdater *kupdater _UNUSED_, const gchar *filename,
                 /* are we done? */
                 if (xfered > 0 && xfered == total)
                 {
+                    flush_progress ();
                     gtk_widget_hide (updater->lbl_action);
                     gtk_widget_hide (updater->pbar_action);
                 }
@@ -1455,15 +1572,14 @@ on_download (KaluUpdater *kupdater _UNUSED_, const gchar *filename,
                 {
                     /* pctg of this download */
                     pctg = (double) xfered / total;
-                    gtk_progress_bar_set_fraction (
-                            GTK_PROGRESS_BAR (updater->pbar_action), pctg);
+                    updater->pending_action = pctg;
                     /* reduce pctg to value of one db */
                     pctg *= 1.0 / sync_dbs->total;
                     /* add already processed dbs */
                     pctg += (double) sync_dbs->processed / sync_dbs->total;
                     /* full sync-ing pctg */
-                    gtk_progress_bar_set_fraction (
-                            GTK_PROGRESS_BAR (updater->pbar_main), pctg);
+                    updater->pending_main = pctg;
+                    queue_progress_flush ();
 
                     if (!gtk_widget_get_visible (updater->lbl_action))
                     {
@@ -1481,13 +1597,14 @@ on_download (KaluUpdater *kupdater _UNUSED_, const gchar *filename,
         case STEP_DOWNLOADING:
             {
                 /* first, we need to find the package we're dealing with */
-                double      pctg     = (total > 0) ? (double) xfered / total : 0;
-                pkg_iter_t *pkg_iter = updater->step_data;
+                double          pctg = (total > 0) ? (double) xfered / total : 0;
+                download_t     *dl;
+                row_progress_t *rp;
 
-                if (G_UNLIKELY (g_strcmp0 (filename, pkg_iter->filename) != 0))
+                dl = g_hash_table_lookup (updater->downloads, filename);
+                if (G_UNLIKELY (dl == NULL))
                 {
-                    debug ("on_download: invalid iter, expected '%s', got '%s'",
-                            filename, pkg_iter->filename);
+                    debug ("on_download: unknown download: %s", filename);
                     return;
                 }
 
@@ -1512,53 +1629,52 @@ on_download (KaluUpdater *kupdater _UNUSED_, const gchar *filename,
                  * another mirror), and because we try to keep track of how much
                  * was downloaded so we can tell when the download is "fully"
                  * done (as in, all deltas), we need to keep track.
+                 *
+                 * Since several downloads can be in flight, step_done only
+                 * holds completed transfers, and dl_inflight the sum of what
+                 * was transferred so far by all the others.
                  */
+                rp = get_row_progress (filename, dl->iter, FALSE);
+                if (xfered < rp->cur_xfrd && total < rp->cur_dl)
+                {
+                    rp->tot_dl += rp->cur_xfrd;
+                    updater->step_done += dl->xfered;
+                    updater->dl_inflight -= dl->xfered;
+                    dl->xfered = 0;
+                }
+                rp->pctg = pctg;
+                rp->cur_xfrd = xfered;
+                rp->cur_dl = total;
+
+                if (!dl->done)
                 {
-                    guint old_xfered, old_total, tot_size;
-
-                    gtk_tree_model_get (GTK_TREE_MODEL (updater->store), pkg_iter->iter,
-                            UCOL_CUR_XFRD_SIZE, &old_xfered,
-                            UCOL_CUR_DL_SIZE,   &old_total,
-                            UCOL_TOT_DL_SIZE,   &tot_size,
-                            -1);
-                    if (xfered < old_xfered && total < old_total)
+                    updater->dl_inflight -= dl->xfered;
+                    /* are we done? */
+                    if (total > 0 && xfered == total)
                     {
-                        gtk_list_store_set (updater->store, pkg_iter->iter,
-                                UCOL_PCTG,          pctg,
-                                UCOL_CUR_XFRD_SIZE, xfered,
-                                UCOL_CUR_DL_SIZE,   total,
-                                UCOL_TOT_DL_SIZE,   tot_size + old_xfered,
-                                -1);
-                        updater->step_done += old_xfered;
+                        updater->step_done += total;
+                        dl->xfered = 0;
+                        dl->done = TRUE;
                     }
                     else
                     {
-                        gtk_list_store_set (updater->store, pkg_iter->iter,
-                                UCOL_PCTG,          pctg,
-                                UCOL_CUR_XFRD_SIZE, xfered,
-                                UCOL_CUR_DL_SIZE,   total,
-                                -1);
+                        updater->dl_inflight += xfered;
+                        dl->xfered = xfered;
                     }
                 }
 
                 if (updater->total_dl > 0)
                 {
                     /* download progress */
-                    pctg = (double) (updater->step_done + xfered) / updater->total_dl;
-                    gtk_progress_bar_set_fraction (
-                            GTK_PROGRESS_BAR (updater->pbar_action), pctg);
+                    pctg = (double) (updater->step_done + updater->dl_inflight)
+                        / updater->total_dl;
+                    updater->pending_action = pctg;
 
                     /* global progress */
-                    pctg = updater->pctg_done + (pctg * updater->pctg_download);
-                    gtk_progress_bar_set_fraction (
-                            GTK_PROGRESS_BAR (updater->pbar_main), pctg);
-                }
-
-                /* are we done? */
-                if (xfered == total)
-                {
-                    updater->step_done += total;
+                    updater->pending_main = updater->pctg_done
+                        + (pctg * updater->pctg_download);
                 }
+                update_dl_rate ();
             }
             break;
 
@@ -1603,6 +1719,7 @@ on_sync_db_start (KaluUpdater *kupdater _UNUSED_, const gchar *name)
     double pctg;
 
     add_log (LOGTYPE_NORMAL, _("Synchronizing database %s... "), name);
+    flush_progress ();
     pctg = (double) sync_db->processed / sync_db->total;
     gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (updater->pbar_main), pctg);
 }
@@ -1629,12 +1746,23 @@ on_sync_db_end (KaluUpdater *kupdater _UNUSED_, sync_db_results_t result)
         add_log (LOGTYPE_NORMAL, _("ok\n"));
     }
 
+    flush_progress ();
     if (sync_db->total > 0)
     {
         pctg = (double) ++(sync_db->processed) / sync_db->total;
         gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (updater->pbar_main),
                 pctg);
     }
+
+    /* through kalu-dbus, Setup moves on to get the packages list */
+    if (updater->kupdater && sync_db->processed == sync_db->total)
+    {
+        add_log (LOGTYPE_NORMAL, _("Databases synchronized\n"));
+        add_log (LOGTYPE_UNIMPORTANT, _("Getting packages list\n"));
+        gtk_label_set_text (GTK_LABEL (updater->lbl_main),
+                _("Getting packages list..."));
+        gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (updater->pbar_main), 0.0);
+    }
 }
 
 static void
@@ -1695,6 +1823,7 @@ dl_pkgs_done (void)
 {
     gchar buf[128], *b = buf;
 
+    flush_progress ();
 #define fmt "<big><b><span color=\"%s\">%s</span></b></big>"
     add_log (LOGTYPE_NORMAL, _("Downloading packages complete."));
     add_log (LOGTYPE_NORMAL, "\n");
@@ -1723,6 +1852,7 @@ updater_sysupgrade_cb (KaluUpdater *kupdater _UNUSED_, const gchar *errmsg)
     alpm_list_t *i;
     gchar buf[128], *b = buf;
 
+    flush_progress ();
     gtk_widget_set_sensitive (updater->btn_abort, FALSE);
     gtk_widget_set_sensitive (updater->btn_close, TRUE);
 
@@ -1949,11 +2079,12 @@ btn_sysupgrade_cb (GtkButton *button _UNUSED_, gpointer data _UNUSED_)
 
 static void
 updater_get_packages_cb (KaluUpdater *kupdater _UNUSED_, const gchar *errmsg,
-                         alpm_list_t *pkgs, gpointer data _UNUSED_)
+                         packages_t *pkgs, gpointer data _UNUSED_)
 {
-    alpm_list_t     *i;
+    guint            n;
     kalu_package_t  *k_pkg;
     GtkTreeIter      iter;
+    GtkTreeIter     *row;
 
     if (errmsg != NULL)
     {
@@ -1982,10 +2113,14 @@ updater_get_packages_cb (KaluUpdater *kupdater _UNUSED_, const gchar *errmsg,
     gint net_size = 0;
     updater->total_dl = 0; /* will be set through on_total_download */
     updater->total_inst = 0;
-    FOR_LIST (i, pkgs)
-    {
-        k_pkg = i->data;
-        gtk_list_store_append (updater->store, &iter);
+    for (n = 0; n < pkgs->nb; ++n)
+    {
+        k_pkg = &pkgs->pkgs[n];
+        row = new (GtkTreeIter, 1);
+        gtk_list_store_append (updater->store, row);
+        iter = *row;
+        /* iters of a GtkListStore persist, so we can keep them around */
+        g_hash_table_replace (updater->rows, strdup (k_pkg->name), row);
         gtk_list_store_set (updater->store, &iter,
                 UCOL_REPO,              k_pkg->repo,
                 UCOL_PACKAGE,           k_pkg->name,
@@ -2168,172 +2303,32 @@ updater_get_packages_cb (KaluUpdater *kupdater _UNUSED_, const gchar *errmsg,
 }
 
 static void
-updater_sync_dbs_cb (KaluUpdater *kupdater, const gchar *errmsg, gpointer data _UNUSED_)
+updater_setup_cb (KaluUpdater *kupdater, const gchar *errmsg,
+                  packages_t *pkgs, gpointer data _UNUSED_)
 {
-    GError *error = NULL;
-
-    if (errmsg != NULL)
+    flush_progress ();
+    gtk_widget_set_sensitive (updater->btn_abort, FALSE);
+    if (updater->step == STEP_SYNC_DBS)
     {
-        _show_error (_("Failed to synchronize databases"), "%s", errmsg);
         free (updater->step_data);
         updater->step_data = NULL;
         updater->step = STEP_NONE;
-        return;
-    }
-
-    gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (updater->pbar_main), 1);
-    add_log (LOGTYPE_NORMAL, _("Databases synchronized\n"));
-    reset_kalpm_synced_dbs ();
-
-    add_log (LOGTYPE_UNIMPORTANT, _("Getting packages list\n"));
-    gtk_label_set_text (GTK_LABEL (updater->lbl_main),
-            _("Getting packages list..."));
-    gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (updater->pbar_main), 0.0);
-    if (!kalu_updater_get_packages (kupdater,
-                NULL,
-                (KaluMethodCallback) updater_get_packages_cb,
-                NULL,
-                &error))
-    {
-        _show_error (_("Failed to get packages list"), "%s", error->message);
-        g_clear_error (&error);
-        return;
-    }
-}
-
-static void
-updater_add_db_cb (KaluUpdater *kupdater, const gchar *errmsg, add_db_t *add_db)
-{
-    GError *error = NULL;
-
-    /* did we just add a db? */
-    if (add_db->i != NULL)
-    {
-        if (errmsg != NULL)
+        if (!errmsg)
         {
-            add_log (LOGTYPE_ERROR, _(" failed\n"));
-            _show_error (_("Failed to register databases"), "%s", errmsg);
-            if (updater->downloadonly)
-                free_kupdater (TRUE);
-            else
-                free_pacman_config (add_db->pac_conf);
-            free (add_db);
-            return;
+            reset_kalpm_synced_dbs ();
+            invalidate_tooltips ();
         }
-        add_log (LOGTYPE_NORMAL, _(" ok\n"));
-        add_db->pctg += add_db->inc;
-        gtk_progress_bar_set_fraction (
-                GTK_PROGRESS_BAR (updater->pbar_main), add_db->pctg);
-        /* next */
-        add_db->i = alpm_list_next (add_db->i);
-    }
-    /* or is this the start? */
-    else
-    {
-        add_db->i = add_db->pac_conf->databases;
     }
 
-    if (add_db->i)
-    {
-        database_t *db_conf = add_db->i->data;
-        add_log (LOGTYPE_NORMAL, _("Register database %s... "), db_conf->name);
-        if (!kalu_updater_add_db (kupdater,
-                    db_conf->name,
-                    db_conf->siglevel,
-                    db_conf->servers,
-                    NULL,
-                    (KaluMethodCallback) updater_add_db_cb,
-                    (gpointer) add_db,
-                    &error))
-        {
-            add_log (LOGTYPE_ERROR, _(" failed\n"));
-            _show_error (_("Failed to register databases"), "%s",
-                    error->message);
-            g_clear_error (&error);
-            if (updater->downloadonly)
-                free_kupdater (TRUE);
-            else
-                free_pacman_config (add_db->pac_conf);
-            free (add_db);
-            return;
-        }
-    }
-    else
-    {
-        if (!updater->downloadonly)
-            free_pacman_config (add_db->pac_conf);
-        free (add_db);
-        gtk_progress_bar_set_fraction (
-                GTK_PROGRESS_BAR (updater->pbar_main), 1);
-        if (!updater->downloadonly)
-        {
-            /* we're good, so let's sync dbs */
-            updater->step_data = new0 (sync_dbs_t, 1);
-            updater->step = STEP_SYNC_DBS;
-            if (!kalu_updater_sync_dbs (kupdater,
-                        NULL,
-                        (KaluMethodCallback) updater_sync_dbs_cb,
-                        NULL,
-                        &error))
-            {
-                _show_error (_("Failed to synchronize databases"), "%s",
-                        error->message);
-                g_clear_error (&error);
-                free (updater->step_data);
-                updater->step_data = NULL;
-                updater->step = STEP_NONE;
-            }
-        }
-        else
-        {
-            /* downloadonly: we assume dbs to be synced already (from
-             * simulation), so we just ahead */
-            add_log (LOGTYPE_UNIMPORTANT, _("Getting packages list\n"));
-            gtk_label_set_text (GTK_LABEL (updater->lbl_main),
-                    _("Getting packages list..."));
-            gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (updater->pbar_main), 0.0);
-            if (!kalu_updater_get_packages (kupdater,
-                        NULL,
-                        (KaluMethodCallback) updater_get_packages_cb,
-                        NULL,
-                        &error))
-            {
-                _show_error (_("Failed to get packages list"), "%s", error->message);
-                g_clear_error (&error);
-                free_kupdater (TRUE);
-                return;
-            }
-            gtk_list_store_clear (updater->store);
-        }
-    }
-}
-
-static void
-updater_init_alpm_cb (KaluUpdater *kupdater, const gchar *errmsg,
-        pacman_config_t *pac_conf)
-{
     if (errmsg != NULL)
     {
-        add_log (LOGTYPE_UNIMPORTANT, _(" failed\n"));
-        _show_error (_("Failed to initialize ALPM library"), "%s", errmsg);
+        _show_error (_("Failed to prepare system upgrade"), "%s", errmsg);
         if (updater->downloadonly)
             free_kupdater (TRUE);
-        else
-            free_pacman_config (pac_conf);
         return;
     }
-    add_log (LOGTYPE_UNIMPORTANT, _(" ok\n"));
-    gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (updater->pbar_main), 0.42);
-
-    add_log (LOGTYPE_UNIMPORTANT, _("Registering databases\n"));
-    add_db_t *add_db;
-    add_db = new0 (add_db_t, 1);
-    add_db->pac_conf = pac_conf;
-    add_db->pctg = 0.42;
-    add_db->inc = 0.58 / (int) alpm_list_count (pac_conf->databases);
-    add_db->i = NULL;
 
-    updater_add_db_cb (kupdater, NULL, add_db);
+    updater_get_packages_cb (kupdater, NULL, pkgs, NULL);
 }
 
 static void
@@ -2356,29 +2351,27 @@ updater_method_cb (KaluUpdater *kupdater, const gchar *errmsg,
     gtk_progress_bar_set_fraction (
             GTK_PROGRESS_BAR (updater->pbar_main), 0.23);
 
+    /* init alpm, register dbs, sync them unless downloadonly (we assume dbs
+     * to be synced already, from simulation) and get the packages list, all
+     * in one call */
     add_log (LOGTYPE_UNIMPORTANT, _("Initializing ALPM library..."));
     gtk_label_set_text (GTK_LABEL (updater->lbl_main),
             _("Initializing ALPM library..."));
-    if (!kalu_updater_init_alpm (kupdater,
-                pac_conf->rootdir,
+    if (!updater->downloadonly)
+    {
+        updater->step_data = new0 (sync_dbs_t, 1);
+        updater->step = STEP_SYNC_DBS;
+    }
+    if (!kalu_updater_setup (kupdater,
+                pac_conf,
                 (!updater->downloadonly)
                 ? pac_conf->dbpath : (gchar *) kalu_alpm_get_dbpath (),
                 (!updater->downloadonly) ? pac_conf->logfile : (gchar *) "/dev/null",
-                pac_conf->gpgdir,
-                pac_conf->hookdirs,
-                pac_conf->cachedirs,
-                pac_conf->siglevel,
-                pac_conf->arch,
-                pac_conf->checkspace,
-                pac_conf->usesyslog,
-                pac_conf->usedelta,
-                pac_conf->ignorepkgs,
-                pac_conf->ignoregroups,
-                pac_conf->noupgrades,
-                pac_conf->noextracts,
+                (!updater->downloadonly)
+                ? SETUP_SYNC_DBS | SETUP_GET_PACKAGES : SETUP_GET_PACKAGES,
+                NULL,
+                (KaluMethodCallback) updater_setup_cb,
                 NULL,
-                (KaluMethodCallback) updater_init_alpm_cb,
-                (gpointer) pac_conf,
                 &error))
     {
         add_log (LOGTYPE_UNIMPORTANT, _(" failed\n"));
@@ -2388,18 +2381,29 @@ updater_method_cb (KaluUpdater *kupdater, const gchar *errmsg,
         if (updater->downloadonly)
             free_kupdater (TRUE);
         else
+        {
+            free (updater->step_data);
+            updater->step_data = NULL;
+            updater->step = STEP_NONE;
             free_pacman_config (pac_conf);
+        }
+        return;
     }
+    add_log (LOGTYPE_UNIMPORTANT, _(" ok\n"));
+    /* kalu-dbus does the work in a worker thread, so it can be aborted */
+    gtk_widget_set_sensitive (updater->btn_abort, TRUE);
+
+    /* everything was sent over */
+    if (!updater->downloadonly)
+        free_pacman_config (pac_conf);
+    else
+        clear_rows ();
 }
 
 static void
-updater_new_cb (GObject *source _UNUSED_, GAsyncResult *res,
+got_kupdater (KaluUpdater *kalu_updater, GError *error,
         pacman_config_t *pac_conf)
 {
-    GError *error = NULL;
-    KaluUpdater *kalu_updater;
-
-    kalu_updater = kalu_updater_new_finish (res, &error);
     if (kalu_updater == NULL)
     {
         add_log (LOGTYPE_UNIMPORTANT, _(" failed\n"));
@@ -2412,6 +2416,14 @@ updater_new_cb (GObject *source _UNUSED_, GAsyncResult *res,
     }
     add_log (LOGTYPE_UNIMPORTANT, _(" ok \n"));
     updater->kupdater = kalu_updater;
+
+    if (record_file && !kalu_updater_record (kalu_updater, record_file, &error))
+    {
+        add_log (LOGTYPE_NORMAL, _("Unable to record signals: %s\n"),
+                error->message);
+        g_clear_error (&error);
+    }
+
     gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (updater->pbar_main), 0.15);
 
     g_signal_connect (kalu_updater,
@@ -2536,7 +2548,8 @@ updater_new_cb (GObject *source _UNUSED_, GAsyncResult *res,
             NULL);
 
     add_log (LOGTYPE_UNIMPORTANT, _("Initializing kalu_updater..."));
-    if (!kalu_updater_init_upd (kalu_updater, updater->downloadonly, NULL,
+    if (!kalu_updater_init_upd (kalu_updater, updater->downloadonly,
+                KUPDATER_PROGRESS_RATE, (guint) config->updater_resident, NULL,
                 (KaluMethodCallback) updater_method_cb,
                 (gpointer) pac_conf,
                 &error))
@@ -2551,6 +2564,37 @@ updater_new_cb (GObject *source _UNUSED_, GAsyncResult *res,
     }
 }
 
+static void
+updater_new_cb (GObject *source _UNUSED_, GAsyncResult *res,
+        pacman_config_t *pac_conf)
+{
+    GError *error = NULL;
+    KaluUpdater *kalu_updater;
+
+    kalu_updater = kalu_updater_new_finish (res, &error);
+    got_kupdater (kalu_updater, error, pac_conf);
+}
+
+static void
+create_kupdater (pacman_config_t *pac_conf)
+{
+    add_log (LOGTYPE_UNIMPORTANT, _("Creating kalu_updater..."));
+    if (replay_file)
+    {
+        GError *error = NULL;
+        KaluUpdater *kalu_updater;
+
+        kalu_updater = kalu_updater_new_replay (replay_file, replay_max_speed,
+                &error);
+        got_kupdater (kalu_updater, error, pac_conf);
+        return;
+    }
+
+    kalu_updater_new (NULL,
+            (GAsyncReadyCallback) updater_new_cb,
+            (gpointer) pac_conf);
+}
+
 static void
 format_size (guint size, gchar *buf, gboolean is_signed)
 {
@@ -2691,10 +2735,16 @@ window_destroy_cb (GtkWidget *window _UNUSED_, gpointer data _UNUSED_)
         g_array_free (updater->pacfile, TRUE);
     }
 
+    g_hash_table_unref (updater->progress);
+    g_hash_table_unref (updater->rows);
+    g_hash_table_unref (updater->downloads);
     free (updater);
     updater = NULL;
 
-    set_kalpm_busy (FALSE);
+    if (replay_file)
+        gtk_main_quit ();
+    else
+        set_kalpm_busy (FALSE);
 }
 
 static void
@@ -2706,6 +2756,46 @@ paned_position_cb (GObject *o, GParamSpec *pspec _UNUSED_, gpointer data _UNUSED
         updater->pos_collapsed = gtk_paned_get_position (GTK_PANED (o));
 }
 
+static void
+log_search (GtkEntry *entry, gboolean backwards)
+{
+    if (!log_view_search (updater->log, gtk_entry_get_text (entry), backwards))
+        gtk_widget_error_bell (GTK_WIDGET (entry));
+}
+
+static void
+log_search_activate_cb (GtkEntry *entry, gpointer data _UNUSED_)
+{
+    log_search (entry, FALSE);
+}
+
+static gboolean
+log_search_key_press_cb (GtkEntry *entry, GdkEventKey *event,
+                         gpointer data _UNUSED_)
+{
+    if ((event->keyval == GDK_KEY_Return || event->keyval == GDK_KEY_KP_Enter)
+            && (event->state & GDK_SHIFT_MASK))
+    {
+        log_search (entry, TRUE);
+        return TRUE;
+    }
+    return FALSE;
+}
+
+static void
+log_search_btn_cb (GtkButton *button _UNUSED_, gpointer backwards)
+{
+    log_search (GTK_ENTRY (updater->log_entry), GPOINTER_TO_INT (backwards));
+}
+
+static void
+log_level_changed_cb (GtkComboBox *combo, gpointer data _UNUSED_)
+{
+    /* entries are in the same order as logtype_t */
+    log_view_set_min_level (updater->log,
+            (guint) gtk_combo_box_get_active (combo));
+}
+
 static void
 expander_expanded_cb (GObject *o, GParamSpec *pspec _UNUSED_, gpointer sw)
 {
@@ -2733,24 +2823,21 @@ btn_download_cb (GtkButton *button _UNUSED_, gpointer data)
     gtk_widget_show (updater->pbar_main);
     gtk_widget_hide (updater->lbl_action);
     /* create kalu_updater */
-    add_log (LOGTYPE_UNIMPORTANT, _("Creating kalu_updater..."));
-    kalu_updater_new (NULL,
-            (GAsyncReadyCallback) updater_new_cb,
-            data);
+    create_kupdater ((pacman_config_t *) data);
 }
 
 static void
 btn_rerun_cb (GtkButton *button _UNUSED_, gpointer data _UNUSED_)
 {
     GError *err = NULL;
-    alpm_list_t *packages = NULL;
+    packages_t *packages = NULL;
 
     add_log (LOGTYPE_NORMAL, _("\nRerun simulation...\n"));
-    gtk_list_store_clear (updater->store);
+    clear_rows ();
     kalu_alpm_has_updates (&packages, &err);
     updater_get_packages_cb (NULL, (err) ? err->message : NULL, packages, NULL);
     g_clear_error (&err);
-    FREE_PACKAGE_LIST (packages);
+    FREE_PACKAGES (packages);
 }
 
 static void
@@ -2900,6 +2987,14 @@ updater_run (const gchar *conffile, alpm_list_t *cmdline_post)
     updater->pos_expanded = -1;
     updater->pos_collapsed = -1;
     updater->downloadonly = run_simulation;
+    updater->progress = g_hash_table_new_full (g_str_hash, g_str_equal,
+            (GDestroyNotify) free, (GDestroyNotify) free);
+    updater->pending_action = -1.0;
+    updater->pending_main = -1.0;
+    updater->rows = g_hash_table_new_full (g_str_hash, g_str_equal,
+            (GDestroyNotify) free, (GDestroyNotify) free);
+    updater->downloads = g_hash_table_new_full (g_str_hash, g_str_equal,
+            (GDestroyNotify) free, (GDestroyNotify) free);
 
     /* the window */
     GtkWidget *window;
@@ -3140,42 +3235,74 @@ updater_run (const gchar *conffile, alpm_list_t *cmdline_post)
     gtk_box_pack_start (GTK_BOX (box), expander, FALSE, FALSE, 0);
     gtk_widget_show (expander);
 
-    /* text view */
-    GtkWidget *text_view;
-    text_view = gtk_text_view_new ();
-    updater->text_view = text_view;
-    gtk_text_view_set_editable (GTK_TEXT_VIEW (text_view), FALSE);
-    g_signal_connect (G_OBJECT (text_view), "draw",
-            G_CALLBACK (text_view_draw_cb), NULL);
-
-    /* buffer */
-    updater->buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (text_view));
-    gtk_text_buffer_create_tag (updater->buffer, "normal", NULL);
-    gtk_text_buffer_create_tag (updater->buffer, "unimportant",
-            "foreground",   config->color_unimportant,
-            NULL);
-    gtk_text_buffer_create_tag (updater->buffer, "info",
-            "foreground",   config->color_info,
-            NULL);
-    gtk_text_buffer_create_tag (updater->buffer, "warning",
-            "foreground",   config->color_warning,
-            NULL);
-    gtk_text_buffer_create_tag (updater->buffer, "error",
-            "foreground",   config->color_error,
-            NULL);
-    /* create mark at the end, where we'll insert stuff/scroll to */
-    GtkTextIter iter;
-    gtk_text_buffer_get_end_iter (updater->buffer, &iter);
-    gtk_text_buffer_create_mark (updater->buffer, "end-mark", &iter, FALSE);
-
-    /* scrolledwindow for text view */
-    scrolled_window = gtk_scrolled_window_new (
-            gtk_scrollable_get_hadjustment (GTK_SCROLLABLE (text_view)),
-            gtk_scrollable_get_vadjustment (GTK_SCROLLABLE (text_view)));
-    gtk_box_pack_start (GTK_BOX (box), scrolled_window, TRUE, TRUE, 0);
-
-    gtk_container_add (GTK_CONTAINER (scrolled_window), text_view);
-    gtk_widget_show (text_view);
+    /* box for log, with its search bar */
+    GtkWidget *log_box;
+    log_box = gtk_box_new (GTK_ORIENTATION_VERTICAL, 0);
+    gtk_box_pack_start (GTK_BOX (box), log_box, TRUE, TRUE, 0);
+
+    GtkWidget *search_box;
+    search_box = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 0);
+    gtk_box_pack_start (GTK_BOX (log_box), search_box, FALSE, FALSE, 2);
+    gtk_widget_show (search_box);
+
+    GtkWidget *log_entry;
+    log_entry = gtk_search_entry_new ();
+    updater->log_entry = log_entry;
+    gtk_widget_set_tooltip_text (log_entry,
+            _("Enter to find the next match, Shift+Enter the previous one"));
+    g_signal_connect (G_OBJECT (log_entry), "activate",
+            G_CALLBACK (log_search_activate_cb), NULL);
+    g_signal_connect (G_OBJECT (log_entry), "key-press-event",
+            G_CALLBACK (log_search_key_press_cb), NULL);
+    gtk_box_pack_start (GTK_BOX (search_box), log_entry, TRUE, TRUE, 0);
+    gtk_widget_show (log_entry);
+
+    GtkWidget *log_btn;
+    log_btn = gtk_button_new_from_icon_name ("go-up", GTK_ICON_SIZE_MENU);
+    gtk_widget_set_tooltip_text (log_btn, _("Find previous"));
+    g_signal_connect (G_OBJECT (log_btn), "clicked",
+            G_CALLBACK (log_search_btn_cb), GINT_TO_POINTER (TRUE));
+    gtk_box_pack_start (GTK_BOX (search_box), log_btn, FALSE, FALSE, 0);
+    gtk_widget_show (log_btn);
+
+    log_btn = gtk_button_new_from_icon_name ("go-down", GTK_ICON_SIZE_MENU);
+    gtk_widget_set_tooltip_text (log_btn, _("Find next"));
+    g_signal_connect (G_OBJECT (log_btn), "clicked",
+            G_CALLBACK (log_search_btn_cb), GINT_TO_POINTER (FALSE));
+    gtk_box_pack_start (GTK_BOX (search_box), log_btn, FALSE, FALSE, 0);
+    gtk_widget_show (log_btn);
+
+    /* same order as logtype_t */
+    GtkWidget *log_level;
+    log_level = gtk_combo_box_text_new ();
+    gtk_combo_box_text_append_text (GTK_COMBO_BOX_TEXT (log_level),
+            _("All messages"));
+    gtk_combo_box_text_append_text (GTK_COMBO_BOX_TEXT (log_level),
+            _("Hide unimportant"));
+    gtk_combo_box_text_append_text (GTK_COMBO_BOX_TEXT (log_level),
+            _("Information and above"));
+    gtk_combo_box_text_append_text (GTK_COMBO_BOX_TEXT (log_level),
+            _("Warnings and errors"));
+    gtk_combo_box_text_append_text (GTK_COMBO_BOX_TEXT (log_level),
+            _("Errors only"));
+    gtk_combo_box_set_active (GTK_COMBO_BOX (log_level), 0);
+    g_signal_connect (G_OBJECT (log_level), "changed",
+            G_CALLBACK (log_level_changed_cb), NULL);
+    gtk_box_pack_start (GTK_BOX (search_box), log_level, FALSE, FALSE, 2);
+    gtk_widget_show (log_level);
+
+    /* log: only what's visible gets drawn, so it can grow big */
+    const gchar *log_colors[] = {
+        config->color_unimportant,  /* LOGTYPE_UNIMPORTANT */
+        NULL,                       /* LOGTYPE_NORMAL */
+        config->color_info,         /* LOGTYPE_INFO */
+        config->color_warning,      /* LOGTYPE_WARNING */
+        config->color_error         /* LOGTYPE_ERROR */
+    };
+    updater->log = log_view_new (log_colors, G_N_ELEMENTS (log_colors));
+    gtk_box_pack_start (GTK_BOX (log_box),
+            log_view_get_widget (updater->log), TRUE, TRUE, 0);
+    gtk_widget_show (log_view_get_widget (updater->log));
 
     /* button box */
     GtkWidget *hbox;
@@ -3259,7 +3386,7 @@ updater_run (const gchar *conffile, alpm_list_t *cmdline_post)
     g_signal_connect (G_OBJECT (paned), "notify::position",
             G_CALLBACK (paned_position_cb), NULL);
     g_signal_connect (G_OBJECT (expander), "notify::expanded",
-            G_CALLBACK (expander_expanded_cb), scrolled_window);
+            G_CALLBACK (expander_expanded_cb), log_box);
 
     if (config->auto_show_log)
         gtk_expander_set_expanded (GTK_EXPANDER (updater->expander), TRUE);
@@ -3270,11 +3397,10 @@ updater_run (const gchar *conffile, alpm_list_t *cmdline_post)
     {
         /* parse pacman.conf */
         GError *error = NULL;
-        gchar *section = NULL;
 
         pacman_config_t *pac_conf = NULL;
         add_log (LOGTYPE_UNIMPORTANT, _("Parsing %s ..."), conffile);
-        if (!parse_pacman_conf (conffile, &section, 0, 0, &pac_conf, &error))
+        if (!load_pacman_conf (conffile, &pac_conf, &error))
         {
             add_log (LOGTYPE_UNIMPORTANT, _(" failed\n"));
             _show_error (_("Unable to parse pacman.conf"), "%s: %s",
@@ -3295,10 +3421,7 @@ updater_run (const gchar *conffile, alpm_list_t *cmdline_post)
         }
 
         /* create kalu_updater */
-        add_log (LOGTYPE_UNIMPORTANT, _("Creating kalu_updater..."));
-        kalu_updater_new (NULL,
-                (GAsyncReadyCallback) updater_new_cb,
-                (gpointer) pac_conf);
+        create_kupdater (pac_conf);
     }
     else
     {
@@ -3315,7 +3438,7 @@ updater_run (const gchar *conffile, alpm_list_t *cmdline_post)
             .pac_conf = NULL
         };
         sync_dbs_t sync_dbs = { 0, 0 };
-        alpm_list_t *packages = NULL;
+        packages_t *packages = NULL;
 
         /* make sure the window is visible, etc */
         while (gtk_events_pending ())
@@ -3359,12 +3482,31 @@ updater_run (const gchar *conffile, alpm_list_t *cmdline_post)
             return;
         }
         updater->step_data = NULL;
+        invalidate_tooltips ();
         gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (updater->pbar_main), 1);
         add_log (LOGTYPE_NORMAL, _("Databases synchronized\n"));
 
         kalu_alpm_has_updates (&packages, &err);
         updater_get_packages_cb (NULL, (err) ? err->message : NULL, packages, NULL);
         g_clear_error (&err);
-        FREE_PACKAGE_LIST (packages);
+        FREE_PACKAGES (packages);
     }
 }
+
+void
+updater_set_record (const gchar *file)
+{
+    free (record_file);
+    record_file = (file) ? strdup (file) : NULL;
+}
+
+/* runs the updater with signals from the recording instead of kalu-dbus; the
+ * window closing ends gtk_main() */
+void
+updater_replay (const gchar *file, gboolean max_speed)
+{
+    free (replay_file);
+    replay_file = strdup (file);
+    replay_max_speed = max_speed;
+    updater_run (config->pacmanconf, NULL);
+}
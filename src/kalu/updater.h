@@ -33,4 +33,10 @@
 void
 updater_run (const gchar *conffile, alpm_list_t *cmdline_post);
 
+void
+updater_set_record (const gchar *file);
+
+void
+updater_replay (const gchar *file, gboolean max_speed);
+
 #endif /* _KALU_UPDATER_H */
@@ -229,11 +229,10 @@ notify_error (const gchar *summary, const gchar *text)
 {
     notif_t *notif;
 
-    notif = new (notif_t, 1);
+    notif = new0 (notif_t, 1);
     notif->type = 0;
     notif->summary = strdup (summary);
     notif->text = (text) ? strdup (text) : NULL;
-    notif->data = NULL;
 
     /* add the notif to the last of last notifications, so we can re-show it later */
     debug ("adding new notif (%s) to last_notifs", notif->summary);
@@ -410,109 +410,238 @@ snprint_size (char *buf, int buflen, double size, const char *unit)
     snprintf (buf, (size_t) buflen, fmt, size, unit);
 }
 
-void
-parse_tpl (
-        const char       *tpl,
-        char            **text,
-        unsigned int     *len,
-        unsigned int     *alloc,
-        replacement_t   **_replacements,
-        gboolean          escaping
-        )
+static const char *tpl_var_names[_NB_TPL_VARS] = {
+    NULL, /* TPL_VAR_LITERAL */
+    "REPO",
+    "PKG",
+    "OLD",
+    "NEW",
+    "DL",
+    "INS",
+    "NET",
+    "DESC",
+    "NEWS",
+    "NB"
+};
+static const gboolean tpl_var_escaping[_NB_TPL_VARS] = {
+    FALSE, /* TPL_VAR_LITERAL */
+    TRUE,  /* REPO */
+    TRUE,  /* PKG */
+    FALSE, /* OLD */
+    FALSE, /* NEW */
+    FALSE, /* DL */
+    FALSE, /* INS */
+    FALSE, /* NET */
+    TRUE,  /* DESC */
+    TRUE,  /* NEWS */
+    FALSE  /* NB */
+};
+#define TPL_ESC_CHARS   "&'\"<>"
+
+/* compile template tpl into segments of literal text & variables. vars is the
+ * list of supported variables, terminated by TPL_VAR_LITERAL; as names are
+ * matched in that order, the first one prefix of the text after a '$' wins */
+compiled_tpl_t *
+compile_tpl (const char *tpl, const tpl_var_t *vars)
 {
-    replacement_t *r, **replacements;
-    const char *t;
-    char *s;
-    char *b;
-    size_t l;
-    char found;
+    compiled_tpl_t  *ctpl;
+    const tpl_var_t *v;
+    const char      *t;
+    const char      *lit;
+    unsigned int     alloc = 1;
+    size_t           l = 0;
 
     if (!tpl)
+        return NULL;
+
+    ctpl = new0 (compiled_tpl_t, 1);
+    ctpl->source = strdup (tpl);
+    /* each placeholder adds (at most) one variable and one literal */
+    for (t = tpl; (t = strchr (t, '$')); ++t)
+        alloc += 2;
+    ctpl->segments = new (tpl_segment_t, alloc);
+
+    for (t = lit = ctpl->source; *t; )
+    {
+        if (*t != '$')
+        {
+            ++t;
+            continue;
+        }
+
+        for (v = vars; *v != TPL_VAR_LITERAL; ++v)
+        {
+            l = strlen (tpl_var_names[*v]);
+            if (streqn (t + 1, tpl_var_names[*v], l))
+                break;
+        }
+        /* not a placeholder, or nothing known/supported, i.e. just a '$' */
+        if (*v == TPL_VAR_LITERAL)
+        {
+            ++t;
+            continue;
+        }
+
+        if (t > lit)
+        {
+            ctpl->segments[ctpl->nb].var = TPL_VAR_LITERAL;
+            ctpl->segments[ctpl->nb].text = lit;
+            ctpl->segments[ctpl->nb].len = (size_t) (t - lit);
+            ++ctpl->nb;
+        }
+        ctpl->segments[ctpl->nb].var = *v;
+        ctpl->segments[ctpl->nb].text = NULL;
+        ctpl->segments[ctpl->nb].len = l;
+        ++ctpl->nb;
+        ctpl->used |= TPL_VAR_BIT (*v);
+
+        t += l + 1;
+        lit = t;
+    }
+    if (t > lit)
+    {
+        ctpl->segments[ctpl->nb].var = TPL_VAR_LITERAL;
+        ctpl->segments[ctpl->nb].text = lit;
+        ctpl->segments[ctpl->nb].len = (size_t) (t - lit);
+        ++ctpl->nb;
+    }
+
+    return ctpl;
+}
+
+void
+free_compiled_tpl (compiled_tpl_t *ctpl)
+{
+    if (!ctpl)
         return;
+    free (ctpl->source);
+    free (ctpl->segments);
+    free (ctpl);
+}
+
+static inline const char *
+get_entity (char c)
+{
+    switch (c)
+    {
+        case '&':
+            return "&amp;";
+        case '\'':
+            return "&apos;";
+        case '"':
+            return "&quot;";
+        case '<':
+            return "&lt;";
+        default: /* '>' */
+            return "&gt;";
+    }
+}
+
+static size_t
+escaped_len (const char *s)
+{
+    size_t len = 0;
+    size_t l;
 
-    for (t = tpl, s = *text + *len; *t; ++t)
+    for (;;)
     {
-        found = 0;
+        l = strcspn (s, TPL_ESC_CHARS);
+        len += l;
+        s += l;
+        if (*s == '\0')
+            return len;
+        len += strlen (get_entity (*s));
+        ++s;
+    }
+}
+
+/* returns the length of the expanded template (w/out NUL) so the buffer can be
+ * allocated once. values are indexed by tpl_var_t; a NULL value leaves the
+ * placeholder as is */
+size_t
+tpl_expand_len (const compiled_tpl_t *ctpl, const char **values, gboolean escaping)
+{
+    const tpl_segment_t *seg;
+    size_t len = 0;
+    unsigned int n;
+
+    if (!ctpl)
+        return 0;
+
+    for (n = 0, seg = ctpl->segments; n < ctpl->nb; ++n, ++seg)
+    {
+        const char *value;
+
+        if (seg->var == TPL_VAR_LITERAL)
+            len += seg->len;
+        else if (!(value = values[seg->var]))
+            len += seg->len + 1;
+        else if (escaping && tpl_var_escaping[seg->var])
+            len += escaped_len (value);
+        else
+            len += strlen (value);
+    }
+
+    return len;
+}
+
+/* writes the expanded template into dest, which must have been sized using
+ * tpl_expand_len(). No NUL is added; returns a pointer past the written text */
+char *
+tpl_expand (const compiled_tpl_t *ctpl, const char **values, gboolean escaping,
+            char *dest)
+{
+    const tpl_segment_t *seg;
+    unsigned int n;
+    size_t l;
+
+    if (!ctpl)
+        return dest;
 
-        /* placeholder? */
-        if (*t == '$')
+    for (n = 0, seg = ctpl->segments; n < ctpl->nb; ++n, ++seg)
+    {
+        const char *value;
+
+        if (seg->var == TPL_VAR_LITERAL)
+        {
+            memcpy (dest, seg->text, seg->len);
+            dest += seg->len;
+        }
+        else if (!(value = values[seg->var]))
         {
-            replacements = _replacements;
-            for (r = *replacements; r; ++replacements, r = *replacements)
+            *dest++ = '$';
+            memcpy (dest, tpl_var_names[seg->var], seg->len);
+            dest += seg->len;
+        }
+        else if (escaping && tpl_var_escaping[seg->var])
+        {
+            /* copy runs of chars not needing escaping at once */
+            for (;;)
             {
-                if (r->name == NULL || r->value == NULL)
-                {
-                    continue;
-                }
+                const char *e;
 
-                l = strlen (r->name);
-                if (strncmp (t + 1, r->name, l) == 0)
-                {
-                    for (b = r->value; *b; ++b)
-                    {
-                        const gchar *esc[] =
-                        {
-                            "&",  "&amp;",
-                            "'",  "&apos;",
-                            "\"", "&quot;",
-                            "<",  "&lt;",
-                            ">",  "&gt;",
-                            NULL
-                        };
-                        gchar *_s;
-                        unsigned int _l, i;
-
-                        _s = b;
-                        _l = 1;
-                        if (escaping && r->need_escaping)
-                        {
-                            const gchar **e;
-
-                            for (e = esc; *e; e += 2)
-                            {
-                                if (*_s == *e[0])
-                                {
-                                    _s = (gchar *) e[1];
-                                    _l = (unsigned int) strlen (_s);
-                                    break;
-                                }
-                            }
-                        }
-
-                        /* enough memory? */
-                        if (*len + _l >= *alloc)
-                        {
-                            *alloc += 1024;
-                            *text = renew (gchar, *alloc + 1, *text);
-                            s = *text + *len;
-                        }
-
-                        for (i = 0; i < _l; ++i, ++*len)
-                            *s++ = *_s++;
-                    }
-                    t += l;
-                    found = 1;
+                l = strcspn (value, TPL_ESC_CHARS);
+                memcpy (dest, value, l);
+                dest += l;
+                value += l;
+                if (*value == '\0')
                     break;
-                }
+                e = get_entity (*value);
+                l = strlen (e);
+                memcpy (dest, e, l);
+                dest += l;
+                ++value;
             }
         }
-        /* not a placeholder, or nothing known/supported, i.e. just a '$' */
-        if (found == 0)
-        {
-            /* copy character */
-            *s++ = *t;
-            ++*len;
-        }
-        /* out of memory? */
-        if (*len >= *alloc)
+        else
         {
-            *alloc += 1024;
-            *text = renew (gchar, *alloc + 1, *text);
-            s = *text + *len;
+            l = strlen (value);
+            memcpy (dest, value, l);
+            dest += l;
         }
     }
 
-    *s = '\0';
+    return dest;
 }
 
 int
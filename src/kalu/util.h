@@ -33,11 +33,36 @@
 #include "kalu.h"
 #include "kalu-alpm.h"
 
-typedef struct _replacement_t {
-    const char *name;
-    char *value;
-    gboolean need_escaping;
-} replacement_t;
+/* variables supported in templates */
+typedef enum {
+    TPL_VAR_LITERAL = 0, /* not a variable, i.e. literal text */
+    TPL_VAR_REPO,
+    TPL_VAR_PKG,
+    TPL_VAR_OLD,
+    TPL_VAR_NEW,
+    TPL_VAR_DL,
+    TPL_VAR_INS,
+    TPL_VAR_NET,
+    TPL_VAR_DESC,
+    TPL_VAR_NEWS,
+    TPL_VAR_NB,
+    _NB_TPL_VARS
+} tpl_var_t;
+
+#define TPL_VAR_BIT(var)        (1U << (var))
+
+typedef struct _tpl_segment_t {
+    tpl_var_t    var;
+    const char  *text; /* for TPL_VAR_LITERAL only */
+    size_t       len;
+} tpl_segment_t;
+
+typedef struct _compiled_tpl_t {
+    char            *source;
+    tpl_segment_t   *segments;
+    unsigned int     nb;
+    unsigned int     used; /* TPL_VAR_BIT of variables used */
+} compiled_tpl_t;
 
 gboolean
 ensure_path (char *path);
@@ -66,9 +91,18 @@ rmrf (const char *path);
 void
 snprint_size (char *buf, int buflen, double size, const char *unit);
 
+compiled_tpl_t *
+compile_tpl (const char *tpl, const tpl_var_t *vars);
+
 void
-parse_tpl (const char *tpl, char **text, unsigned int *len, unsigned int *alloc,
-           replacement_t **replacements, gboolean escaping);
+free_compiled_tpl (compiled_tpl_t *ctpl);
+
+size_t
+tpl_expand_len (const compiled_tpl_t *ctpl, const char **values, gboolean escaping);
+
+char *
+tpl_expand (const compiled_tpl_t *ctpl, const char **values, gboolean escaping,
+            char *dest);
 
 int
 watched_package_cmp (watched_package_t *w_pkg1, watched_package_t *w_pkg2);
@@ -34,6 +34,7 @@
 /* kalu */
 #include "kalu.h"
 #include "watched.h"
+#include "conf.h"
 #include "util.h"
 #include "util-gtk.h"
 #include "gui.h" /* show_notif() */
@@ -199,40 +200,18 @@ btn_close_cb (GtkButton *button _UNUSED_, w_type_t type)
 static gboolean
 save_watched (gboolean is_aur, alpm_list_t *new_watched)
 {
-    FILE *fp;
-    char file[PATH_MAX];
-    alpm_list_t *i;
-    gboolean success = FALSE;
-
-    if (is_aur)
-    {
-        snprintf (file, PATH_MAX - 1, "%s/kalu/watched-aur.conf", g_get_user_config_dir ());
-    }
-    else
-    {
-        snprintf (file, PATH_MAX - 1, "%s/kalu/watched.conf", g_get_user_config_dir ());
-    }
+    GError *error = NULL;
 
-    if (ensure_path (file))
+    if (!save_watched_conf ((is_aur) ? CONF_FILE_WATCHED_AUR : CONF_FILE_WATCHED,
+                new_watched, &error))
     {
-        fp = fopen (file, "w");
-        if (fp != NULL)
-        {
-            FOR_LIST (i, new_watched)
-            {
-                watched_package_t *w_pkg = i->data;
-                fputs (w_pkg->name, fp);
-                fputs ("=", fp);
-                fputs (w_pkg->version, fp);
-                fputs ("\n", fp);
-            }
-
-            fclose (fp);
-            success = TRUE;
-        }
+        debug ("unable to save watched%s packages: %s",
+                (is_aur) ? " AUR" : "", error->message);
+        g_clear_error (&error);
+        return FALSE;
     }
 
-    return success;
+    return TRUE;
 }
 
 static int
@@ -431,7 +410,11 @@ btn_mark_cb (GtkButton *button _UNUSED_, gboolean is_aur)
                 }
                 else
                 {
-                    FREE_PACKAGE_LIST (notif->data);
+                    /* keep the summary, since packages won't be around */
+                    if (!notif->summary)
+                        expand_notif (notif->type, notif->packages->pkgs,
+                                notif->packages->nb, &notif->summary, NULL);
+                    FREE_PACKAGES (notif->packages);
                     free (notif->text);
                     notif->text = strdup (
                             (is_aur)
@@ -1035,7 +1018,7 @@ watched_new_window (w_type_t type)
 }
 
 void
-watched_update (alpm_list_t *packages, gboolean is_aur)
+watched_update (const packages_t *packages, gboolean is_aur)
 {
     GtkWidget *window, *tree;
     w_type_t type;
@@ -1063,11 +1046,11 @@ watched_update (alpm_list_t *packages, gboolean is_aur)
     /* fill it up */
     GtkListStore *store;
     GtkTreeIter iter;
-    alpm_list_t *i;
+    guint n;
     store = GTK_LIST_STORE (gtk_tree_view_get_model (GTK_TREE_VIEW (tree)));
-    FOR_LIST (i, packages)
+    for (n = 0; n < packages->nb; ++n)
     {
-        kalu_package_t *pkg = i->data;
+        const kalu_package_t *pkg = &packages->pkgs[n];
         gboolean can_upd = !streq (pkg->new_version, "-");
 
         gtk_list_store_append (store, &iter);